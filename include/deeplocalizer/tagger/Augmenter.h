@@ -0,0 +1,58 @@
+#ifndef DEEP_LOCALIZER_AUGMENTER_H
+#define DEEP_LOCALIZER_AUGMENTER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "DatasetWriter.h"
+#include "Image.h"
+
+namespace deeplocalizer {
+
+struct AugmentationOptions {
+    // number of rotated and translated samples per tag. 0 disables the
+    // augmentation and only the tags themselves are used.
+    size_t sample_rate = 0;
+    double ratio_true_to_false = RATIO_TRUE_TO_FALSE_SAMPLES_DEFAULT;
+    double ratio_around_to_uniform = RATIO_AROUND_TO_UNIFORM_DEFAULT;
+    bool rotate = true;
+    uint64_t seed = 0;
+    // width and height of the square samples, centered on the tags
+    int patch_size = PATCH_SIZE_DEFAULT;
+};
+
+// Generates the augmented samples of a whole image in two steps. `plan`
+// draws the position, rotation and label of every sample and `apply` warps
+// all of them out of the image. Positive samples are tags moved by up to
+// MAX_TRANSLATION. Negative samples are the rejected tags, patches between
+// MIN_AROUND_WRONG and MAX_AROUND_WRONG away from a tag and patches at
+// uniformly random positions, that are not close to a tag.
+// The samples only depend on the seed and the filename of the image.
+class Augmenter {
+public:
+    // The patch pixel p is taken from the image at `patch_to_image * (p, 1)`.
+    struct Sample {
+        cv::Matx23d patch_to_image;
+        int label;
+    };
+
+    explicit Augmenter(const AugmentationOptions & opt = {});
+
+    std::vector<Sample> plan(const cv::Size & image_size, const ImageDesc & desc) const;
+    // All patches share one buffer, so there is one allocation per image.
+    // Samples without rotation are copied out of the image instead of warped.
+    static std::vector<TrainDatum> apply(const cv::Mat & image, const std::vector<Sample> & samples,
+                                         int patch_size = PATCH_SIZE_DEFAULT);
+    std::vector<TrainDatum> samples(const cv::Mat & image, const ImageDesc & desc) const;
+
+    const AugmentationOptions & options() const {
+        return _opt;
+    }
+private:
+    AugmentationOptions _opt;
+};
+}
+
+#endif //DEEP_LOCALIZER_AUGMENTER_H
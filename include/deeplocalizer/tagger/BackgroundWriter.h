@@ -0,0 +1,46 @@
+#ifndef DEEP_LOCALIZER_BACKGROUNDWRITER_H
+#define DEEP_LOCALIZER_BACKGROUNDWRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace deeplocalizer {
+
+// Runs write jobs on a separate thread. Jobs are keyed, usually by the path
+// they write to. A job that is scheduled while another one with the same key
+// is still waiting replaces the waiting one, so only the latest state is
+// written. Jobs run in the order their keys were first scheduled.
+class BackgroundWriter {
+public:
+    using job_t = std::function<void()>;
+
+    BackgroundWriter();
+    BackgroundWriter(const BackgroundWriter &) = delete;
+    BackgroundWriter & operator=(const BackgroundWriter &) = delete;
+    // Runs all remaining jobs.
+    ~BackgroundWriter();
+
+    void schedule(const std::string & key, job_t job);
+    // Blocks until all jobs scheduled so far are done.
+    void flush();
+    size_t pending() const;
+private:
+    std::deque<std::string> _order;
+    std::unordered_map<std::string, job_t> _jobs;
+    bool _busy = false;
+    bool _stop = false;
+    mutable std::mutex _mutex;
+    std::condition_variable _work;
+    std::condition_variable _idle;
+    std::thread _worker;
+
+    void workerLoop();
+};
+}
+
+#endif //DEEP_LOCALIZER_BACKGROUNDWRITER_H
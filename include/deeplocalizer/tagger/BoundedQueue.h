@@ -0,0 +1,100 @@
+#ifndef DEEP_LOCALIZER_BOUNDEDQUEUE_H
+#define DEEP_LOCALIZER_BOUNDEDQUEUE_H
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include <boost/optional/optional.hpp>
+
+namespace deeplocalizer {
+
+// A blocking FIFO queue with a fixed capacity to link pipeline stages.
+// `push` blocks while the queue is full, `pop` blocks while it is empty.
+// After `close` no new items are accepted and `pop` returns none once the
+// remaining items are consumed.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _capacity(std::max<size_t>(capacity, 1)) {}
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue & operator=(const BoundedQueue &) = delete;
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_full.wait(lock, [this]() { return _closed || _items.size() < _capacity; });
+        if (_closed) {
+            return false;
+        }
+        _items.push_back(std::move(item));
+        lock.unlock();
+        _not_empty.notify_one();
+        return true;
+    }
+
+    boost::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_empty.wait(lock, [this]() { return _closed || !_items.empty(); });
+        if (_items.empty()) {
+            return boost::optional<T>();
+        }
+        boost::optional<T> item(std::move(_items.front()));
+        _items.pop_front();
+        lock.unlock();
+        _not_full.notify_one();
+        return item;
+    }
+
+    // Like push and pop, but never block.
+    bool tryPush(T item) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_closed || _items.size() >= _capacity) {
+            return false;
+        }
+        _items.push_back(std::move(item));
+        lock.unlock();
+        _not_empty.notify_one();
+        return true;
+    }
+
+    boost::optional<T> tryPop() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_items.empty()) {
+            return boost::optional<T>();
+        }
+        boost::optional<T> item(std::move(_items.front()));
+        _items.pop_front();
+        lock.unlock();
+        _not_full.notify_one();
+        return item;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _not_full.notify_all();
+        _not_empty.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.size();
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+private:
+    const size_t _capacity;
+    std::deque<T> _items;
+    bool _closed = false;
+    mutable std::mutex _mutex;
+    std::condition_variable _not_full;
+    std::condition_variable _not_empty;
+};
+}
+
+#endif //DEEP_LOCALIZER_BOUNDEDQUEUE_H
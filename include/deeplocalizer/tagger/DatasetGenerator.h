@@ -0,0 +1,36 @@
+#ifndef DEEP_LOCALIZER_DATASETGENERATOR_H
+#define DEEP_LOCALIZER_DATASETGENERATOR_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "Augmenter.h"
+#include "DatasetWriter.h"
+#include "Image.h"
+
+namespace deeplocalizer {
+
+// Extracts the training samples of a tagged image. Tags are positive
+// samples, rejected proposals and bees without a tag are negative samples.
+// Excluded tags are skipped. With a sample rate, the samples are augmented,
+// see Augmenter.
+class DatasetGenerator {
+public:
+    static constexpr double TEST_RATIO_DEFAULT = 0.15;
+
+    explicit DatasetGenerator(double test_ratio = TEST_RATIO_DEFAULT,
+                              const AugmentationOptions & augmentation = {});
+
+    // All samples of an image go to the same phase. The phase only depends
+    // on the filename, so it stays the same across runs.
+    Phase phase(const std::string & filename) const;
+    std::vector<TrainDatum> samples(const cv::Mat & image, const ImageDesc & desc) const;
+private:
+    double _test_ratio;
+    Augmenter _augmenter;
+};
+}
+
+#endif //DEEP_LOCALIZER_DATASETGENERATOR_H
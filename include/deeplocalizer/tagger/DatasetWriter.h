@@ -0,0 +1,122 @@
+#ifndef DEEP_LOCALIZER_DATASETWRITER_H
+#define DEEP_LOCALIZER_DATASETWRITER_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <opencv2/core/core.hpp>
+
+namespace deeplocalizer {
+
+enum class Phase {
+    Train,
+    Test
+};
+
+std::string phase_to_str(Phase phase);
+
+enum class DatasetFormat {
+    Images,
+    LMDB,
+    HDF5
+};
+
+DatasetFormat str_to_dataset_format(const std::string & str);
+// LMDB and HDF5 are only available if the libraries were found at build time.
+bool isAvailable(DatasetFormat format);
+
+// One training sample: a grayscale patch of TAG_SIZE and its label.
+// The patch may be a view into the whole image.
+struct TrainDatum {
+    cv::Mat patch;
+    int label;
+};
+
+struct DatasetWriterOptions {
+    // a new file is started as soon as the current one exceeds this size
+    size_t max_file_bytes = 1024*1024*1024;
+    // deflate level of the HDF5 datasets
+    int compression = 4;
+    // number of samples per HDF5 chunk
+    size_t chunk_size = 256;
+};
+
+// Writes training samples in batches. Nothing but the current batch is held
+// in memory, so a dataset can be larger than the RAM.
+// Every writer creates `train.txt` and `test.txt` in its output directory,
+// in the format the matching Caffe data layer expects: one `<image> <label>`
+// per line for images and the paths of the databases or HDF5 files otherwise.
+// The methods must be called from a single thread.
+class DatasetWriter {
+public:
+    virtual ~DatasetWriter() = default;
+    virtual void write(const std::vector<TrainDatum> & batch, Phase phase) = 0;
+    virtual void close() = 0;
+
+    static std::unique_ptr<DatasetWriter> create(DatasetFormat format,
+                                                 const boost::filesystem::path & output_dir,
+                                                 const DatasetWriterOptions & opt = {});
+};
+
+class ImageDatasetWriter : public DatasetWriter {
+public:
+    static const size_t FILES_PER_DIRECTORY = 10000;
+
+    explicit ImageDatasetWriter(const boost::filesystem::path & output_dir);
+    ~ImageDatasetWriter();
+    void write(const std::vector<TrainDatum> & batch, Phase phase) override;
+    void close() override;
+private:
+    boost::filesystem::path _output_dir;
+    std::ofstream _lists[2];
+    size_t _counts[2] = {0, 0};
+};
+
+#ifdef DEEPLOCALIZER_USE_LMDB
+class LMDBDatasetWriter : public DatasetWriter {
+public:
+    LMDBDatasetWriter(const boost::filesystem::path & output_dir,
+                      const DatasetWriterOptions & opt);
+    ~LMDBDatasetWriter();
+    void write(const std::vector<TrainDatum> & batch, Phase phase) override;
+    void close() override;
+
+    // A caffe::Datum protobuf message, encoded by hand to not depend on caffe.
+    static std::string encodeDatum(const cv::Mat & patch, int label);
+private:
+    struct Database;
+    boost::filesystem::path _output_dir;
+    DatasetWriterOptions _opt;
+    std::ofstream _lists[2];
+    std::unique_ptr<Database> _dbs[2];
+    size_t _nb_files[2] = {0, 0};
+
+    Database & database(Phase phase, size_t next_bytes);
+};
+#endif
+
+#ifdef DEEPLOCALIZER_USE_HDF5
+class HDF5DatasetWriter : public DatasetWriter {
+public:
+    HDF5DatasetWriter(const boost::filesystem::path & output_dir,
+                      const DatasetWriterOptions & opt);
+    ~HDF5DatasetWriter();
+    void write(const std::vector<TrainDatum> & batch, Phase phase) override;
+    void close() override;
+private:
+    struct File;
+    boost::filesystem::path _output_dir;
+    DatasetWriterOptions _opt;
+    std::ofstream _lists[2];
+    std::unique_ptr<File> _files[2];
+    size_t _nb_files[2] = {0, 0};
+
+    File & file(Phase phase, const cv::Mat & patch, size_t next_bytes);
+};
+#endif
+}
+
+#endif //DEEP_LOCALIZER_DATASETWRITER_H
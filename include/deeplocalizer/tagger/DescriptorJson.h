@@ -0,0 +1,29 @@
+#ifndef DEEP_LOCALIZER_DESCRIPTORJSON_H
+#define DEEP_LOCALIZER_DESCRIPTORJSON_H
+
+#include <ostream>
+#include <string>
+
+#include "Image.h"
+
+namespace deeplocalizer {
+
+// Reads and writes the json files of image descriptions without building a
+// nlohmann::json document. The schema is the one of ImageDesc::to_json:
+//     {"filename":"...","tags":[{"tagtype":"istag","x":10,"y":20}, ...]}
+// The output is compact. The reader skips unknown keys and throws a
+// std::string for anything that is not valid json.
+namespace descriptor_json {
+
+void write(std::ostream & os, const ImageDesc & desc);
+std::string dump(const ImageDesc & desc);
+// Writes to a temporary file first and renames it, like safe_serialization.
+void save(const std::string & path, const ImageDesc & desc);
+
+ImageDesc parse(const char * begin, const char * end);
+ImageDesc parse(const std::string & text);
+ImageDesc load(const std::string & path);
+}
+}
+
+#endif //DEEP_LOCALIZER_DESCRIPTORJSON_H
@@ -0,0 +1,103 @@
+#ifndef DEEP_LOCALIZER_DESCRIPTORSTORE_H
+#define DEEP_LOCALIZER_DESCRIPTORSTORE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "Image.h"
+
+namespace deeplocalizer {
+
+// Binary layout of a descriptor store. All integers are little endian.
+// The file starts with the header, followed by the arrays of images and
+// tags and finally all filenames without separators.
+namespace store {
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t nb_images;
+    uint64_t nb_tags;
+    uint64_t images_offset;
+    uint64_t tags_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct ImageEntry {
+    uint64_t filename_offset;
+    uint32_t filename_size;
+    uint32_t nb_tags;
+    uint64_t first_tag;
+};
+
+// same information as Tag::to_json: the center and the type of a tag
+struct PackedTag {
+    int32_t x;
+    int32_t y;
+    uint8_t type;
+    uint8_t padding[3];
+
+    static PackedTag fromTag(const Tag & tag);
+    Tag toTag() const;
+};
+
+static_assert(sizeof(Header) == 64, "unexpected padding in store::Header");
+static_assert(sizeof(ImageEntry) == 24, "unexpected padding in store::ImageEntry");
+static_assert(sizeof(PackedTag) == 12, "unexpected padding in store::PackedTag");
+}
+
+// A read-only, memory-mapped collection of image descriptions. One file holds
+// the filenames and tags of a whole dataset. Opening it only maps the file,
+// so filenames and tags can be accessed directly without any parsing.
+class DescriptorStore {
+public:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+    explicit DescriptorStore(const std::string & path);
+
+    size_t size() const {
+        return _header->nb_images;
+    }
+    size_t nbTags() const {
+        return _header->nb_tags;
+    }
+    boost::string_ref filename(size_t idx) const;
+    const store::PackedTag * tagsBegin(size_t idx) const;
+    const store::PackedTag * tagsEnd(size_t idx) const;
+    size_t nbTags(size_t idx) const;
+
+    ImageDesc imageDesc(size_t idx) const;
+    std::vector<ImageDescPtr> toImageDescs() const;
+    // Writes a json descriptor `<filename>.<extension>` next to every image.
+    void exportJson(const std::string & extension) const;
+
+    static void write(const std::string & path, const std::vector<ImageDescPtr> & descs);
+    static void write(const std::string & path, const std::vector<ImageDesc> & descs);
+    // Reads the json descriptors of all images in `pathfile` and writes them to a store.
+    static void fromPathFile(const std::string & pathfile, const std::string & extension,
+                             const std::string & path);
+private:
+    boost::interprocess::file_mapping _file;
+    boost::interprocess::mapped_region _region;
+    const char * _data;
+    const store::Header * _header;
+    const store::ImageEntry * _images;
+    const store::PackedTag * _tags;
+    const char * _strings;
+
+    const store::ImageEntry & entry(size_t idx) const;
+};
+
+using DescriptorStorePtr = std::shared_ptr<DescriptorStore>;
+}
+
+#endif //DEEP_LOCALIZER_DESCRIPTORSTORE_H
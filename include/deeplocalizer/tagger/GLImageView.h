@@ -0,0 +1,120 @@
+#ifndef DEEP_LOCALIZER_GLIMAGEVIEW_H
+#define DEEP_LOCALIZER_GLIMAGEVIEW_H
+
+#include <memory>
+#include <vector>
+
+#include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLWidget>
+#include <QScrollBar>
+#include <QWidget>
+
+#include <boost/optional/optional.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "ImageView.h"
+#include "Tag.h"
+#include "TagGrid.h"
+
+namespace deeplocalizer {
+
+class GLImageView;
+
+// Draws the image of a GLImageView as one texture and its tags as
+// instanced quads. Zooming and panning only change a uniform.
+class GLImageCanvas : public QOpenGLWidget, protected QOpenGLExtraFunctions {
+    Q_OBJECT
+public:
+    explicit GLImageCanvas(GLImageView * view);
+    ~GLImageCanvas();
+
+    // The texture and the tag buffer are uploaded on the next paint.
+    void imageChanged();
+    void tagsChanged();
+protected:
+    void initializeGL() override;
+    void resizeGL(int w, int h) override;
+    void paintGL() override;
+    void mousePressEvent(QMouseEvent * event) override;
+    void wheelEvent(QWheelEvent * event) override;
+private:
+    GLImageView * _view;
+    std::unique_ptr<QOpenGLTexture> _texture;
+    QOpenGLShaderProgram _image_program;
+    QOpenGLShaderProgram _tag_program;
+    QOpenGLVertexArrayObject _image_vao;
+    QOpenGLVertexArrayObject _tag_vao;
+    QOpenGLBuffer _quad_buffer;
+    QOpenGLBuffer _tag_buffer;
+    int _nb_tags = 0;
+    bool _image_dirty = false;
+    bool _tags_dirty = false;
+
+    void uploadImage();
+    void uploadTags();
+};
+
+// An OpenGL alternative to WholeImageWidget with the same behaviour. The
+// image is uploaded to the GPU once per image, the scroll bars and the zoom
+// factor are applied as a transformation in the shaders.
+class GLImageView : public QWidget, public ImageView {
+    Q_OBJECT
+public:
+    static constexpr double MIN_SCALE = 0.15;
+    static constexpr double MAX_SCALE = 3;
+
+    explicit GLImageView(QWidget * parent = nullptr);
+
+    void setTags(cv::Mat mat, std::vector<Tag> * tags) override;
+    void reindexTags() override;
+    double getZoomFactor() const override {
+        return _scale;
+    }
+    void setZoomFactor(double factor) override;
+    QScrollBar * horizontalScrollBar() const override {
+        return _horz;
+    }
+    QScrollBar * verticalScrollBar() const override {
+        return _vert;
+    }
+
+    const cv::Mat & mat() const {
+        return _mat;
+    }
+    const std::vector<Tag> * tags() const {
+        return _tags;
+    }
+    // Transformation from image coordinates to canvas pixels.
+    double scale() const {
+        return _scale;
+    }
+    QPointF offset() const;
+    QPointF toImage(const QPoint & canvas_pos) const;
+public slots:
+    void zoomIn() override;
+    void zoomOut() override;
+    void zoom(double factor, QPoint canvas_pos);
+signals:
+    void changed();
+private:
+    friend class GLImageCanvas;
+
+    GLImageCanvas * _canvas;
+    QScrollBar * _horz;
+    QScrollBar * _vert;
+    cv::Mat _mat;
+    std::vector<Tag> * _tags = nullptr;
+    TagGrid _tag_grid;
+    double _scale = 0.8;
+
+    void updateScrollBars();
+    void mousePressed(QMouseEvent * event);
+    boost::optional<Tag> createTag(int x, int y) const;
+};
+}
+
+#endif //DEEP_LOCALIZER_GLIMAGEVIEW_H
@@ -17,12 +17,14 @@ class ImageDesc {
 public:
     std::string filename;
     ImageDesc();
-    ImageDesc(const std::string filename);
-    ImageDesc(const std::string filename, std::vector<Tag> _tags);
+    ImageDesc(std::string filename);
+    // Pass the tags with std::move to not copy them.
+    ImageDesc(std::string filename, std::vector<Tag> tags);
     QPixmap visualise_tags();
     void addTag(Tag&& tag);
-    void addTag(Tag tag);
-    void setTags(std::vector<Tag> && tag);
+    void addTag(const Tag & tag);
+    void setTags(std::vector<Tag> && tags);
+    void setTags(const std::vector<Tag> & tags);
     const std::vector<Tag> & getTags() const;
     std::vector<Tag> & getTags();
     bool operator==(const ImageDesc & other) const;
@@ -37,13 +39,19 @@ public:
 
     static std::vector<ImageDesc> fromPathFile(const std::string &path,
                                                const std::string & image_desc_extension = "desc");
-    static std::vector<ImageDesc> fromPaths(const std::vector<std::string> paths,
+    static std::vector<ImageDesc> fromPaths(const std::vector<std::string> & paths,
                                             const std::string & image_desc_extension = "desc");
 
-    static std::vector<std::shared_ptr<ImageDesc>> fromPathsPtr(const std::vector<std::string> paths,
+    static std::vector<std::shared_ptr<ImageDesc>> fromPathsPtr(const std::vector<std::string> & paths,
                                                              const std::string & image_desc_extension);
     static std::vector<std::shared_ptr<ImageDesc>> fromPathFilePtr(
             const std::string &path, const std::string & image_desc_extension = "desc");
+    // Returns the lines of the pathfile without checking that the images exist.
+    static std::vector<std::string> readPathFile(const std::string &path);
+    // Description of the image at `path`. Loaded from `<path>.<image_desc_extension>`
+    // if it exists, otherwise without tags.
+    static std::shared_ptr<ImageDesc> loadForImage(const std::string &path,
+                                                   const std::string & image_desc_extension);
 
 private:
     std::string _save_extension = ".desc";
@@ -52,10 +60,27 @@ private:
 };
 using ImageDescPtr = std::shared_ptr<ImageDesc>;
 
+struct DecodeOptions {
+    // 1, 2, 4 or 8. JPEGs are scaled down while decoding, which is much
+    // faster than decoding the full image and resizing it.
+    int reduction = 1;
+    // Decode JPEGs with libjpeg-turbo, if it was found at build time.
+    bool use_turbojpeg = true;
+};
+
 class Image {
 public:
     explicit Image();
     explicit Image(const ImageDesc & descr);
+    Image(const ImageDesc & descr, const DecodeOptions & opt);
+    Image(std::string filename, cv::Mat mat);
+
+    // The grayscale image encoded in `data`, e.g. a file read with readFile.
+    // Returns an empty matrix if the data cannot be decoded.
+    static cv::Mat decode(const uchar * data, size_t size, const DecodeOptions & opt = {});
+    static cv::Mat decode(const std::vector<uchar> & buffer, const DecodeOptions & opt = {});
+    static std::vector<uchar> readFile(const std::string & path);
+    static bool hasTurboJPEG();
 
     inline cv::Mat getCvMat() const {
         return _mat;
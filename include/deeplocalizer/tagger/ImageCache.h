@@ -0,0 +1,72 @@
+#ifndef DEEP_LOCALIZER_IMAGECACHE_H
+#define DEEP_LOCALIZER_IMAGECACHE_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Image.h"
+
+namespace deeplocalizer {
+
+// A LRU cache of decoded images, keyed by filename. A worker thread decodes
+// the images passed to `prefetch` in the background. The cache holds at most
+// `maxBytes` of pixel data; the least recently used images are evicted first.
+// All methods are thread-safe.
+class ImageCache {
+public:
+    static const size_t DEFAULT_MAX_BYTES = 512 * 1024 * 1024;
+
+    explicit ImageCache(size_t max_bytes = DEFAULT_MAX_BYTES);
+    ImageCache(const ImageCache &) = delete;
+    ImageCache & operator=(const ImageCache &) = delete;
+    ~ImageCache();
+
+    // Returns the cached image. If the worker is currently decoding it, waits
+    // for the worker. Otherwise the image is decoded on the calling thread.
+    // Rethrows the error if the worker failed to decode the image.
+    ImagePtr get(const std::string & filename);
+    // Returns the cached image or nullptr. Never decodes.
+    ImagePtr tryGet(const std::string & filename);
+    // Replaces the images that are still waiting to be decoded. The images
+    // are decoded in the given order.
+    void prefetch(std::vector<std::string> filenames);
+    void clear();
+
+    size_t size() const;
+    size_t bytes() const;
+    size_t maxBytes() const;
+    void setMaxBytes(size_t max_bytes);
+private:
+    using entry_t = std::pair<std::string, ImagePtr>;
+    // most recently used at the front
+    std::list<entry_t> _lru;
+    std::unordered_map<std::string, std::list<entry_t>::iterator> _index;
+    size_t _bytes = 0;
+    size_t _max_bytes;
+
+    std::deque<std::string> _pending;
+    std::string _in_flight;
+    // errors of the worker, until `get` reports them
+    std::unordered_map<std::string, std::exception_ptr> _errors;
+    bool _stop = false;
+    mutable std::mutex _mutex;
+    std::condition_variable _work;
+    std::condition_variable _decoded;
+    std::thread _worker;
+
+    void workerLoop();
+    ImagePtr lookup(const std::string & filename);
+    void insert(const std::string & filename, ImagePtr image);
+    void evict();
+    static size_t imageBytes(const Image & image);
+};
+}
+
+#endif //DEEP_LOCALIZER_IMAGECACHE_H
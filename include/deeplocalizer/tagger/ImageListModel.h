@@ -0,0 +1,52 @@
+#ifndef DEEP_LOCALIZER_IMAGELISTMODEL_H
+#define DEEP_LOCALIZER_IMAGELISTMODEL_H
+
+#include <string>
+#include <unordered_map>
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QImage>
+#include <QPixmap>
+
+#include "ManuallyTagger.h"
+#include "ThumbnailCache.h"
+
+namespace deeplocalizer {
+
+// The images of a ManuallyTagger for the sidebar. Rows are built when the
+// view asks for them, from the done flags the tagger already keeps, so the
+// model costs nothing per image. Call `imageChanged` after the done state of
+// an image changed.
+// If a ThumbnailCache is set, the rows are decorated with its thumbnails.
+// Missing ones are requested once a row is shown.
+class ImageListModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+    static const int MAX_PIXMAPS = 512;
+
+    explicit ImageListModel(const ManuallyTagger & tagger, QObject * parent = nullptr);
+    ~ImageListModel();
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
+
+    // Ownership stays with the caller. The cache must outlive the model.
+    void setThumbnailCache(ThumbnailCache * cache);
+public slots:
+    void imageChanged(unsigned long idx);
+    void allChanged();
+signals:
+    void thumbnailLoaded(QString filename, QImage thumbnail);
+private slots:
+    void insertThumbnail(QString filename, QImage thumbnail);
+private:
+    const ManuallyTagger & _tagger;
+    ThumbnailCache * _thumbnails = nullptr;
+    mutable QCache<int, QPixmap> _pixmaps;
+    // rows of the requested thumbnails
+    mutable std::unordered_map<std::string, int> _requested;
+};
+}
+
+#endif //DEEP_LOCALIZER_IMAGELISTMODEL_H
@@ -0,0 +1,64 @@
+#ifndef DEEP_LOCALIZER_IMAGETILECACHE_H
+#define DEEP_LOCALIZER_IMAGETILECACHE_H
+
+#include <list>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <QPainter>
+#include <QPixmap>
+#include <QRect>
+
+#include <opencv2/core/core.hpp>
+
+namespace deeplocalizer {
+
+// Renders a grayscale image at arbitrary zoom levels from pre-scaled tiles.
+// The tiles of one zoom level are computed from the level of a mipmap
+// pyramid that is closest to, but at least as large as, the zoomed image.
+// A tile is converted to a QPixmap once and then kept in a LRU cache, so
+// repainting only blits the tiles that intersect the exposed region.
+class ImageTileCache {
+public:
+    static const int TILE_SIZE = 256;
+    static const size_t DEFAULT_MAX_TILES = 512;
+
+    explicit ImageTileCache(size_t max_tiles = DEFAULT_MAX_TILES);
+
+    void setImage(const cv::Mat & mat);
+    void clear();
+    // Draws the tiles that intersect `exposed`, given in widget coordinates
+    // of the image zoomed by `scale`.
+    void draw(QPainter & painter, const QRect & exposed, double scale);
+    // Size of the image zoomed by `scale`.
+    QSize scaledSize(double scale) const;
+
+    size_t nbLevels() const {
+        return _pyramid.size();
+    }
+    const cv::Mat & level(size_t idx) const {
+        return _pyramid.at(idx);
+    }
+    size_t nbCachedTiles() const {
+        return _lru.size();
+    }
+    // Index of the pyramid level that is used to render at `scale`.
+    size_t levelForScale(double scale) const;
+    // Computes the pixels of a tile without caching them.
+    cv::Mat renderTile(double scale, int tile_x, int tile_y) const;
+private:
+    // zoom factor, tile column, tile row
+    using key_t = std::tuple<double, int, int>;
+    using entry_t = std::pair<key_t, QPixmap>;
+
+    std::vector<cv::Mat> _pyramid;
+    std::list<entry_t> _lru;
+    std::map<key_t, std::list<entry_t>::iterator> _index;
+    size_t _max_tiles;
+
+    const QPixmap & tile(double scale, int tile_x, int tile_y);
+};
+}
+
+#endif //DEEP_LOCALIZER_IMAGETILECACHE_H
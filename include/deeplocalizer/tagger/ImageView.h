@@ -0,0 +1,32 @@
+#ifndef DEEP_LOCALIZER_IMAGEVIEW_H
+#define DEEP_LOCALIZER_IMAGEVIEW_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+class QScrollBar;
+
+namespace deeplocalizer {
+
+class Tag;
+
+// The parts of an image view that ManuallyTaggerWindow uses. Implemented by
+// the QPainter based WholeImageWidget and the OpenGL based GLImageView.
+class ImageView {
+public:
+    virtual ~ImageView() = default;
+
+    virtual void setTags(cv::Mat mat, std::vector<Tag> * tags) = 0;
+    // Must be called after the tags passed to setTags were changed from outside.
+    virtual void reindexTags() = 0;
+    virtual double getZoomFactor() const = 0;
+    virtual void setZoomFactor(double factor) = 0;
+    virtual void zoomIn() = 0;
+    virtual void zoomOut() = 0;
+    virtual QScrollBar * horizontalScrollBar() const = 0;
+    virtual QScrollBar * verticalScrollBar() const = 0;
+};
+}
+
+#endif //DEEP_LOCALIZER_IMAGEVIEW_H
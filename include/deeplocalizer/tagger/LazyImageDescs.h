@@ -0,0 +1,42 @@
+#ifndef DEEP_LOCALIZER_LAZYIMAGEDESCS_H
+#define DEEP_LOCALIZER_LAZYIMAGEDESCS_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+
+namespace deeplocalizer {
+
+// A collection of image descriptions that are only parsed when they are
+// accessed the first time. Creating it from a pathfile only reads the
+// pathfile, so the startup time does not depend on the size of the
+// descriptor files. All methods are thread-safe.
+class LazyImageDescs {
+public:
+    LazyImageDescs(std::vector<std::string> paths, std::string image_desc_extension);
+    static LazyImageDescs fromPathFile(const std::string & pathfile,
+                                       const std::string & image_desc_extension);
+
+    size_t size() const {
+        return _paths.size();
+    }
+    const std::string & path(size_t idx) const {
+        return _paths.at(idx);
+    }
+    ImageDescPtr at(size_t idx) const;
+    // Loads the descriptions in [begin, end) in parallel.
+    void prefetch(size_t begin, size_t end) const;
+    // Loads all remaining descriptions in parallel.
+    std::vector<ImageDescPtr> loadAll() const;
+private:
+    std::vector<std::string> _paths;
+    std::string _extension;
+    mutable std::vector<ImageDescPtr> _descs;
+    mutable std::unique_ptr<std::once_flag[]> _loaded;
+};
+}
+
+#endif //DEEP_LOCALIZER_LAZYIMAGEDESCS_H
@@ -18,6 +18,9 @@
 
 #include "Tag.h"
 #include "Image.h"
+#include "ImageCache.h"
+#include "BackgroundWriter.h"
+#include "ProgressFile.h"
 
 
 namespace deeplocalizer {
@@ -28,7 +31,12 @@ class ManuallyTagger : public QObject {
     Q_OBJECT
 
 public slots:
+    // Writes the descriptions and the progress on a background thread. The
+    // progress file is only rewritten every COMPACT_EVERY done images,
+    // otherwise the changes are kept in the journal.
     void save(bool all_desc=false) const;
+    // Writes the progress synchronously. Paths ending with .bin use the
+    // compact binary format, see ProgressFile.h.
     void save(const std::string & path) const;
     void loadNextImage();
     void loadLastImage();
@@ -36,6 +44,10 @@ public slots:
     void loadCurrentImage();
     void doneTagging();
     void doneTagging(unsigned long idx);
+    // Marks images as done whose *.tagger.json file was created by someone
+    // else, e.g. another session on the same images. The Refresh action of
+    // the window calls it.
+    void refreshDoneState();
 signals:
     void loadedImage(unsigned long idx, ImageDescPtr desc, ImagePtr img);
     void outOfRange(unsigned long idx);
@@ -45,6 +57,9 @@ signals:
 public:
     static const std::string IMAGE_DESC_EXT;
     static const std::string DEFAULT_SAVE_PATH;
+    static const std::string COMPACT_SAVE_PATH;
+    static const size_t DEFAULT_PREFETCH_DEPTH = 2;
+    static const uint64_t COMPACT_EVERY = 100;
 
     explicit ManuallyTagger();
     explicit ManuallyTagger(const std::vector<ImageDesc> & descriptions,
@@ -67,19 +82,39 @@ public:
     const std::vector<ImageDescPtr> &getImageDescs() const {
         return _image_descs;
     }
+    // Either the *.tagger.json file existed in `init` or it was tagged since.
+    // Does not touch the filesystem, see refreshDoneState.
     bool isDone(unsigned long idx) const {
-        // either *.tagger.desc file exists or it is marked as done
-        return (idx < _image_descs.size() &&
-                boost::filesystem::exists(_image_descs.at(idx)->savePath())) ||
-                (idx < _done_tagging.size() && _done_tagging.at(idx));
+        return idx < _done_tagging.size() && _done_tagging[idx];
     }
     bool isDone(const ImageDesc & desc) const {
         return boost::filesystem::exists(desc.savePath());
     }
 
+    // Number of next and previous images that are decoded in the background.
+    size_t prefetchDepth() const {
+        return _prefetch_depth;
+    }
+    void setPrefetchDepth(size_t depth) {
+        _prefetch_depth = depth;
+    }
+    ImageCache & imageCache() {
+        return *_image_cache;
+    }
+    // Blocks until all scheduled writes are done.
+    void flush() const {
+        _writer->flush();
+    }
+
     unsigned long getIdx() const {
         return _image_idx;
     }
+    // The images are entries of this descriptor store. The binary progress
+    // file then refers to images by their index in the store.
+    void setDescriptorStore(const std::string & path);
+
+    Progress toProgress() const;
+    static std::unique_ptr<ManuallyTagger> fromProgress(const Progress & progress);
     nlohmann::json to_json() const;
     static std::unique_ptr<ManuallyTagger> from_json(const nlohmann::json &);
 
@@ -89,11 +124,27 @@ private:
     unsigned long _n_done = 0;
     bool _loaded_from_serialization = false;
     std::vector<std::string> _image_paths;
+    std::string _store_path;
+    std::vector<uint32_t> _store_indices;
 
     std::string _save_path = DEFAULT_SAVE_PATH;
     ImagePtr _image;
     ImageDescPtr _desc;
     unsigned long _image_idx = 0;
+    size_t _prefetch_depth = DEFAULT_PREFETCH_DEPTH;
+    std::unique_ptr<ImageCache> _image_cache = std::make_unique<ImageCache>();
+
+    // sequence number of the last journal entry and of the last one in the progress file
+    uint64_t _journal_seq = 0;
+    mutable uint64_t _compacted_seq = 0;
+    mutable bool _progress_written = false;
+    std::unique_ptr<BackgroundWriter> _writer = std::make_unique<BackgroundWriter>();
+
+    void prefetchAround(unsigned long idx);
+    void scheduleSave(const ImageDesc & desc) const;
+    // Sets `current` to the image that was shown last, if the journal has one.
+    void replayJournal(const std::string & journal_path, uint64_t progress_seq,
+                       std::string & current);
 };
 }
 
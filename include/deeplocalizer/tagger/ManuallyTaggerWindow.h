@@ -3,11 +3,13 @@
 
 #include <QMainWindow>
 #include <QProgressBar>
-#include <QStringListModel>
 
 #include "ui_ManuallyTaggerWindow.h"
 #include "ManuallyTagger.h"
 #include "WholeImageWidget.h"
+#include "GLImageView.h"
+#include "ImageListModel.h"
+#include "ThumbnailCache.h"
 
 namespace deeplocalizer {
 
@@ -17,9 +19,14 @@ class ManuallyTaggerWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    explicit ManuallyTaggerWindow(std::vector<ImageDescPtr> && _image_desc);
-    explicit ManuallyTaggerWindow(std::unique_ptr<ManuallyTagger> tagger);
+    explicit ManuallyTaggerWindow(std::vector<ImageDescPtr> && _image_desc,
+                                  bool use_opengl = false);
+    explicit ManuallyTaggerWindow(std::unique_ptr<ManuallyTagger> tagger,
+                                  bool use_opengl = false);
     ~ManuallyTaggerWindow();
+    // Shows thumbnails from this cache directory in the image list. The
+    // missing thumbnails are created in the background.
+    void setThumbnailDir(const std::string & dir);
 public slots:
     void next();
     void back();
@@ -40,24 +47,28 @@ private:
     Ui::ManuallyTaggerWindow *ui;
 
     QGridLayout * _grid_layout;
-    WholeImageWidget * _whole_image;
+    // either _whole_image or _gl_image is set
+    ImageView * _image_view;
+    WholeImageWidget * _whole_image = nullptr;
+    GLImageView * _gl_image = nullptr;
     QProgressBar * _progres_bar;
-    QStringListModel *_image_list_model;
+    ImageListModel *_image_list_model;
 
     std::unique_ptr<ManuallyTagger> _tagger;
+    // outlives the list model, which the destructor of the window deletes first
+    std::unique_ptr<ThumbnailCache> _thumbnails;
     ImageDescPtr  _desc;
     ImagePtr  _image;
     QTimer * _save_timer;
     bool _changed = false;
 
 
-    void init();
+    void init(bool use_opengl);
     void showImage();
     void setupConnections();
     void setupActions();
     void setupUi();
     void eraseNegativeTags();
-    QStringList fileStringList();
 };
 }
 #endif // MANUELLTAGWINDOW_H
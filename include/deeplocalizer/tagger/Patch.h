@@ -0,0 +1,83 @@
+#ifndef DEEP_LOCALIZER_PATCH_H
+#define DEEP_LOCALIZER_PATCH_H
+
+#include <cstring>
+
+#include <opencv2/core/core.hpp>
+
+#include "deeplocalizer_tagger.h"
+
+namespace deeplocalizer {
+
+// Kernels that copy square 8 bit patches out of an image and convert them
+// to floats. With the size N known at compile time, every row is a memcpy
+// of fixed size and the conversion loop is unrolled and vectorized by the
+// compiler. PatchKernel<0> is the generic kernel that takes the size at run
+// time. dispatchPatchSize picks the kernel once per patch, so the patch size
+// is an option of the tools and not a constant.
+static const int SPECIALIZED_PATCH_SIZES[] = {64, 100, 128};
+
+template<int N>
+struct PatchKernel {
+    static void copy(const uchar * src, size_t src_step, uchar * dst, size_t dst_step, int = N) {
+        for(int y = 0; y < N; y++) {
+            std::memcpy(dst + y*dst_step, src + y*src_step, N);
+        }
+    }
+    // Writes N*N floats to `dst`, the same values as cv::Mat::convertTo.
+    static void pack(const uchar * src, size_t src_step, float * dst, float scale, int = N) {
+        for(int y = 0; y < N; y++) {
+            const uchar * row = src + y*src_step;
+            float * out = dst + y*N;
+            for(int x = 0; x < N; x++) {
+                out[x] = row[x] * scale;
+            }
+        }
+    }
+};
+
+template<>
+struct PatchKernel<0> {
+    static void copy(const uchar * src, size_t src_step, uchar * dst, size_t dst_step, int size) {
+        for(int y = 0; y < size; y++) {
+            std::memcpy(dst + y*dst_step, src + y*src_step, size);
+        }
+    }
+    static void pack(const uchar * src, size_t src_step, float * dst, float scale, int size) {
+        for(int y = 0; y < size; y++) {
+            const uchar * row = src + y*src_step;
+            float * out = dst + y*size;
+            for(int x = 0; x < size; x++) {
+                out[x] = row[x] * scale;
+            }
+        }
+    }
+};
+
+// Calls `fn` with the kernel for `size`, e.g.
+// `dispatchPatchSize(size, [&](auto kernel) { decltype(kernel)::copy(..., size); })`.
+template<typename Fn>
+void dispatchPatchSize(int size, Fn && fn) {
+    switch(size) {
+        case 64:  fn(PatchKernel<64>());  break;
+        case 100: fn(PatchKernel<100>()); break;
+        case 128: fn(PatchKernel<128>()); break;
+        default:  fn(PatchKernel<0>());   break;
+    }
+}
+
+bool isSpecializedPatchSize(int size);
+// Throws unless `size` is positive and even, so a patch is centered on its tag.
+void checkPatchSize(int size);
+
+// Copies the square patch of `dst.rows` pixels at `top_left` of `src` into
+// `dst`. The patch must lie inside `src`. Uses the kernels for single
+// channel 8 bit images and cv::Mat::copyTo for all other types.
+void copyPatch(const cv::Mat & src, cv::Point top_left, cv::Mat & dst);
+// Writes `src` as floats multiplied by `scale` to `dst`, row after row.
+// Square single channel 8 bit patches use the kernels, all others
+// cv::Mat::convertTo.
+void packPatch(const cv::Mat & src, float * dst, float scale);
+}
+
+#endif //DEEP_LOCALIZER_PATCH_H
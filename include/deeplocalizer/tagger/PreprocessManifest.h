@@ -0,0 +1,70 @@
+#ifndef DEEP_LOCALIZER_PREPROCESSMANIFEST_H
+#define DEEP_LOCALIZER_PREPROCESSMANIFEST_H
+
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+#include <boost/optional/optional.hpp>
+#include <json.hpp>
+
+namespace deeplocalizer {
+
+struct ManifestEntry {
+    std::string input;
+    uintmax_t size;
+    std::time_t mtime;
+    std::string fingerprint;
+    std::string output;
+
+    nlohmann::json to_json() const;
+    static ManifestEntry from_json(const nlohmann::json & j);
+};
+
+// Records which input images bb_preprocess has already written to an output
+// directory. Every finished image is appended as one JSON line, so a run
+// that dies midway can be resumed. An entry is up to date if size and
+// modification time of the input, the options fingerprint and the existence
+// of the output still match.
+class PreprocessManifest {
+public:
+    static const std::string DEFAULT_FILENAME;
+
+    explicit PreprocessManifest(const boost::filesystem::path & path);
+
+    // Returns the output path if `input` was already processed with `fingerprint`.
+    boost::optional<std::string> upToDate(const std::string & input,
+                                          const std::string & fingerprint) const;
+    // Appends an entry for the processed `input`. Thread-safe.
+    void record(const std::string & input, const std::string & fingerprint,
+                const std::string & output);
+    // Adds the entries of `other`, e.g. the manifest of a shard, as if they
+    // were recorded here.
+    void merge(const PreprocessManifest & other);
+    // Rewrites the manifest with only the latest entry of every input.
+    void compact();
+    // The output path of `input`, regardless of whether it is up to date.
+    boost::optional<std::string> output(const std::string & input) const;
+
+    size_t size() const {
+        return _entries.size();
+    }
+    const boost::filesystem::path & path() const {
+        return _path;
+    }
+    static boost::optional<ManifestEntry> stat(const std::string & input);
+private:
+    boost::filesystem::path _path;
+    std::unordered_map<std::string, ManifestEntry> _entries;
+    std::ofstream _journal;
+    mutable std::mutex _mutex;
+
+    void load();
+};
+}
+
+#endif //DEEP_LOCALIZER_PREPROCESSMANIFEST_H
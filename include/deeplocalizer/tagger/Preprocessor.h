@@ -0,0 +1,193 @@
+#ifndef DEEP_LOCALIZER_PREPROCESSOR_H
+#define DEEP_LOCALIZER_PREPROCESSOR_H
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "deeplocalizer_tagger.h"
+
+namespace deeplocalizer {
+
+enum ImageFormat {
+    PNG,
+    JPEG
+};
+
+std::string format_to_str(ImageFormat format);
+
+// opencv default values
+static const int DEFAULT_JPEG_COMPRESSION = 95;
+static const int DEFAULT_PNG_COMPRESSION = 3;
+
+// One output of bb_preprocess: the steps applied to the image, its encoding
+// and the directory it is written to.
+struct OutputVariant {
+    boost::filesystem::path output_dir;
+    bool use_hist_eq = false;
+    bool use_thresholding = false;
+    bool use_binary_image = false;
+    bool add_border = true;
+    // the border is half a patch wide, so patches around tags at the edge fit
+    int patch_size = PATCH_SIZE_DEFAULT;
+    ImageFormat format = ImageFormat::JPEG;
+    int compression = DEFAULT_JPEG_COMPRESSION;
+
+    std::pair<int, int> opencv_compression() const;
+    std::string extension() const;
+    // identifies all options that change the written images
+    std::string fingerprint() const;
+
+    // Parses a comma separated list of `key=value`, e.g.
+    // `dir=out/png,clahe=1,format=png`. The keys are dir, border, patch, clahe,
+    // threshold, binary, format and compression. Omitted keys are taken
+    // from `base`, except the compression, which falls back to the default
+    // of a changed format.
+    static OutputVariant parse(const std::string & spec, const OutputVariant & base);
+};
+
+struct PreprocessOptions {
+    boost::filesystem::path output_dir;
+    bool use_hist_eq;
+    bool use_thresholding;
+    bool use_binary_image;
+    bool add_border;
+    ImageFormat format;
+    int compression;
+    size_t nb_threads;
+    size_t nb_io_threads;
+    size_t queue_depth;
+    bool force;
+    // the border is half a patch wide
+    int patch_size = PATCH_SIZE_DEFAULT;
+    // written from the same decoded image as the main output
+    std::vector<OutputVariant> extra_variants = {};
+
+    // the main output that the fields above describe
+    OutputVariant variant() const;
+    // the main output followed by the extra variants
+    std::vector<OutputVariant> variants() const;
+    std::pair<int, int> opencv_compression() const;
+    std::string extension() const;
+    // identifies all options that change the written images, of all variants
+    std::string fingerprint() const;
+    void print() const;
+};
+
+boost::filesystem::path add_extension(const boost::filesystem::path & filename,
+                                      const OutputVariant & variant);
+boost::filesystem::path add_extension(const boost::filesystem::path & filename,
+                                      const PreprocessOptions & opt);
+
+// Applies the border, CLAHE and thresholding steps of `PreprocessOptions`.
+// A Preprocessor is meant to live as long as its worker thread. It keeps the
+// CLAHE object and all intermediate buffers, so once the frame size is fixed
+// processing an image does not allocate anymore.
+// A Preprocessor must not be shared between threads.
+class Preprocessor {
+public:
+    explicit Preprocessor(const OutputVariant & variant);
+    explicit Preprocessor(const PreprocessOptions & opt);
+
+    // Writes the processed `src` to `dst`. If `dst` already has the right size,
+    // its buffer is reused, so it must not be used by another thread meanwhile.
+    // `src` and `dst` must not share their data.
+    // If no step is enabled, `dst` refers to the data of `src`.
+    void process(const cv::Mat & src, cv::Mat & dst);
+    // Replaces `mat` with the processed image. The result is written to a
+    // buffer of the Preprocessor, that is reused by the next call unless
+    // the previous result is still referenced.
+    void process(cv::Mat & mat);
+
+    void makeBorder(const cv::Mat & src, cv::Mat & dst) const;
+    void localHistogramEq(const cv::Mat & src, cv::Mat & dst);
+    // Without `use_binary_image` the thresholded image is blended with the
+    // original: 0.7 * src + 0.3 * threshold(src). The frame is processed in
+    // strips of THRESHOLD_STRIP_ROWS rows: the gaussian mean of a strip is
+    // computed into a small buffer, then one vectorized pass thresholds and
+    // blends the strip while its mean is still in the cache. The result is
+    // bit-identical to cv::adaptiveThreshold followed by cv::addWeighted.
+    void adaptiveTresholding(const cv::Mat & src, cv::Mat & dst);
+
+    static const double THRESHOLD_MAX_VALUE;
+    static const int THRESHOLD_BLOCK_SIZE;
+    static const double THRESHOLD_WEIGHT_ORIGINAL;
+    static const double THRESHOLD_WEIGHT_THRESHOLD;
+    static const int CLAHE_CLIP_LIMIT;
+    static const int THRESHOLD_STRIP_ROWS;
+private:
+    bool _add_border;
+    int _border;
+    bool _use_hist_eq;
+    bool _use_thresholding;
+    bool _use_binary_image;
+
+    cv::Ptr<cv::CLAHE> _clahe;
+    cv::Mat _bordered;
+    cv::Mat _clahe_out;
+    // the output of process(cv::Mat &)
+    cv::Mat _result;
+    // the gaussian mean is computed in float, like cv::adaptiveThreshold,
+    // one strip of rows at a time
+    cv::Mat _src_float;
+    cv::Mat _strip_mean;
+    // blended value for every pixel value, first below then above the mean
+    std::array<uchar, 512> _blend_lut;
+    // if the vector kernel reproduces `_blend_lut` on this machine
+    bool _vector_kernel;
+
+    void initBlendLut();
+    void thresholdAndBlend(const cv::Mat & src, cv::Mat & dst);
+    void thresholdAndBlendRow(const uchar * src, const float * mean, uchar * dst, int cols) const;
+};
+
+// Computes several variants of an image at once. The steps border, CLAHE
+// and thresholding always run in this order, so variants that start with
+// the same steps share them: e.g. the border is computed once for a
+// bordered and a bordered plus CLAHE variant, and variants that only differ
+// in their encoding get the same matrix.
+// Like a Preprocessor, it keeps its buffers and must not be shared between
+// threads.
+class VariantPreprocessor {
+public:
+    explicit VariantPreprocessor(const std::vector<OutputVariant> & variants);
+
+    // `outputs[i]` is set to the image of the i-th variant. Its buffer is
+    // reused if it has the right size, see Preprocessor::process. Variants
+    // without any step refer to the data of `src`.
+    void process(const cv::Mat & src, std::vector<cv::Mat> & outputs);
+
+    size_t nbVariants() const {
+        return _variant_nodes.size();
+    }
+    // number of distinct steps that run per image
+    size_t nbSteps() const {
+        return _nodes.size();
+    }
+    // If the image of a variant is shared with another variant or the input,
+    // its buffer must not be handed back to `process` while still in use.
+    bool sharesOutput(size_t variant) const;
+private:
+    // one step applied to the result of its parent, -1 is the input image
+    struct Node {
+        int parent;
+        std::string key;
+        Preprocessor step;
+        // the first variant that outputs this node, -1 for intermediate steps
+        int output;
+        cv::Mat buffer;
+    };
+    std::vector<Node> _nodes;
+    // the node whose result is the variant, -1 for the input image
+    std::vector<int> _variant_nodes;
+
+    int addStep(int parent, const std::string & key, const OutputVariant & step);
+};
+}
+
+#endif //DEEP_LOCALIZER_PREPROCESSOR_H
@@ -0,0 +1,60 @@
+#ifndef DEEP_LOCALIZER_PROGRESSFILE_H
+#define DEEP_LOCALIZER_PROGRESSFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+namespace deeplocalizer {
+
+// The state of a ManuallyTagger that is written to the progress file.
+struct Progress {
+    std::vector<std::string> image_paths;
+    std::vector<bool> done_tagging;
+    unsigned long image_idx = 0;
+    uint64_t journal_seq = 0;
+    // If set, the images are entries of this descriptor store and the binary
+    // format only stores their indices instead of the paths.
+    std::string store_path;
+    std::vector<uint32_t> store_indices;
+
+    nlohmann::json to_json() const;
+    static Progress from_json(const nlohmann::json & j);
+};
+
+// A compact binary alternative to the json progress file. It starts with a
+// fixed header, followed by either the paths of all images separated by
+// '\n' or the path of a descriptor store with one uint32 index per image.
+// The done flags are packed into uint64 words at the end.
+namespace progress_file {
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t nb_images;
+    uint64_t image_idx;
+    uint64_t journal_seq;
+    uint64_t table_size;
+};
+static_assert(sizeof(Header) == 48, "unexpected padding in progress_file::Header");
+
+extern const char MAGIC[8];
+const uint32_t VERSION = 1;
+const uint32_t FLAG_STORE = 1;
+const std::string BINARY_EXTENSION = ".bin";
+
+// Progress files ending with BINARY_EXTENSION are written in the binary format.
+bool isBinaryPath(const std::string & path);
+bool isBinaryFile(const std::string & path);
+void write(const std::string & path, const Progress & progress);
+// Reads both the binary and the json format.
+Progress read(const std::string & path);
+// Progress file of shard `shard` of `nb_shards` next to `path`.
+std::string shardPath(const std::string & path, size_t shard, size_t nb_shards);
+}
+}
+
+#endif //DEEP_LOCALIZER_PROGRESSFILE_H
@@ -0,0 +1,39 @@
+#ifndef DEEP_LOCALIZER_PROGRESSJOURNAL_H
+#define DEEP_LOCALIZER_PROGRESSJOURNAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+namespace deeplocalizer {
+
+// The changes of the tagging progress since the progress file was last
+// written. Every line of the journal is one json entry. The progress file
+// stores the sequence number of the last entry it contains, so a journal
+// that was not compacted after writing the progress file is harmless.
+namespace journal {
+
+struct Entry {
+    uint64_t seq;
+    // the image that was marked as done
+    std::string done;
+    // the image that was shown. A path, because the order of the images
+    // changes when a session is resumed.
+    std::string current;
+
+    nlohmann::json to_json() const;
+    static Entry from_json(const nlohmann::json & j);
+};
+
+std::string pathFor(const std::string & progress_path);
+// Broken lines, e.g. from a crash while appending, are skipped.
+std::vector<Entry> read(const std::string & path);
+void append(const std::string & path, const Entry & entry);
+// Drops all entries with a sequence number up to `seq`.
+void compact(const std::string & path, uint64_t seq);
+}
+}
+
+#endif //DEEP_LOCALIZER_PROGRESSJOURNAL_H
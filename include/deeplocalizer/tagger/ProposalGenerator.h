@@ -0,0 +1,104 @@
+#ifndef DEEP_LOCALIZER_PROPOSALGENERATOR_H
+#define DEEP_LOCALIZER_PROPOSALGENERATOR_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/opencv_modules.hpp>
+
+#include "Tag.h"
+
+namespace deeplocalizer {
+
+// The `input_dim` or `input_shape` of a caffe deploy prototxt.
+struct NetInputShape {
+    int batch_size = 0;
+    int channels = 0;
+    int height = 0;
+    int width = 0;
+};
+
+NetInputShape parseInputShape(const std::string & deploy_path);
+
+struct ScoredWindow {
+    cv::Rect box;
+    float score;
+};
+
+// Tag boxes whose centers lie on a grid with `stride` spacing.
+std::vector<cv::Rect> candidateWindows(cv::Size image_size, int stride);
+
+// Greedily keeps the windows with the highest scores that are at least
+// `min_distance` away from every window kept before.
+std::vector<Tag> nonMaximumSuppression(std::vector<ScoredWindow> windows,
+                                       float threshold, int min_distance);
+
+// Border that grows a tag box to the input size of a net.
+unsigned int borderForInput(const NetInputShape & shape);
+
+// Rewrites the InnerProduct layers of a deploy prototxt to Convolution
+// layers, with the kernel size given in `kernels` for each layer name.
+// With the same weights, the net then slides over a whole image.
+std::string fullyConvolutionalPrototxt(const std::string & deploy,
+                                       const std::map<std::string, cv::Size> & kernels);
+
+// Tags at the local maxima of a tag probability map. Cell (y, x) of the map
+// is the window centered at `offset + stride*(x, y)` in the image.
+std::vector<Tag> peaksToTags(const cv::Mat & heat_map, int stride, cv::Point2i offset,
+                             float threshold, int min_distance);
+
+#ifdef HAVE_OPENCV_DNN
+// A caffe net that scores tag candidates. The net is loaded once and
+// classifies whole blobs of N x 1 x height x width patches.
+// Not thread safe, every forward thread needs its own classifier.
+class TagClassifier {
+public:
+    TagClassifier(const std::string & deploy_path, const std::string & weights_path,
+                  bool use_gpu = false);
+    ~TagClassifier();
+
+    const NetInputShape & inputShape() const {
+        return _shape;
+    }
+    // Probability of class 1, the tag class, for the first `n` patches of `blob`.
+    std::vector<float> classify(const cv::Mat & blob, size_t n);
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+    NetInputShape _shape;
+};
+
+// Runs a net converted with fullyConvolutionalPrototxt over a whole image.
+// One forward pass yields the tag probability of a window every `stride()`
+// pixels. Not thread safe.
+class FullyConvolutionalLocalizer {
+public:
+    FullyConvolutionalLocalizer(const std::string & deploy_path, const std::string & weights_path,
+                                bool use_gpu = false);
+    ~FullyConvolutionalLocalizer();
+
+    cv::Mat heatMap(const cv::Mat & image);
+    std::vector<Tag> localize(const cv::Mat & image, float threshold, int min_distance);
+
+    int stride() const {
+        return _stride;
+    }
+    // center of the window of the first cell of the heat map
+    cv::Point2i offset() const {
+        return _offset;
+    }
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+    NetInputShape _shape;
+    unsigned int _border;
+    int _stride;
+    cv::Point2i _offset;
+};
+#endif
+}
+
+#endif //DEEP_LOCALIZER_PROPOSALGENERATOR_H
@@ -0,0 +1,41 @@
+#ifndef DEEP_LOCALIZER_SHARDS_H
+#define DEEP_LOCALIZER_SHARDS_H
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace deeplocalizer {
+
+// Splitting a run over several processes or nodes. An image belongs to the
+// shard shardOf(path, N), so the assignment of an image never changes when
+// other images are added to the pathfile. Every shard writes its own files,
+// named by shardPath, which a merge step combines afterwards.
+
+// The paths of shard `shard` of `nb_shards`, in their original order.
+std::vector<std::string> selectShard(const std::vector<std::string> & paths,
+                                     size_t shard, size_t nb_shards);
+
+// `dir/name.ext` -> `dir/name.shard-<shard>-of-<nb_shards>.ext`
+std::string shardPath(const std::string & path, size_t shard, size_t nb_shards);
+
+// `dir` -> `dir/shard-<shard>-of-<nb_shards>`
+boost::filesystem::path shardDir(const boost::filesystem::path & dir,
+                                 size_t shard, size_t nb_shards);
+
+// Concatenates the lines of the shard files of `path` in shard order and
+// writes them to `path`. If `order` is not empty, the lines are sorted by
+// their position in `order` instead. Lines that are not in `order` follow
+// at the end. Throws if the file of a shard is missing, i.e. the shard did
+// not finish. Returns the number of lines written.
+size_t mergeShardFiles(const std::string & path, size_t nb_shards,
+                       const std::vector<std::string> & order = {});
+
+// Same as mergeShardFiles, but reads from `shardDir(dir, i, nb_shards) / name`
+// and writes to `dir / name`.
+size_t mergeShardDirs(const boost::filesystem::path & dir, const std::string & name,
+                      size_t nb_shards);
+}
+
+#endif //DEEP_LOCALIZER_SHARDS_H
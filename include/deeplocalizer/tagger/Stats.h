@@ -0,0 +1,118 @@
+#ifndef DEEP_LOCALIZER_STATS_H
+#define DEEP_LOCALIZER_STATS_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <json.hpp>
+
+namespace deeplocalizer {
+
+// Performance counters of the batch tools and the tagger.
+// Every thread accumulates into its own slots, which only it writes, so
+// recording a sample takes no lock and touches no shared cache line. A
+// snapshot sums the slots of all threads, including the ones that exited.
+namespace stats {
+
+enum class Metric {
+    Read,       // reading image files into memory
+    Decode,     // decoding images
+    Filter,     // border, CLAHE and thresholding of bb_preprocess
+    Encode,     // encoding images
+    Write,      // writing images and datasets
+    JsonLoad,   // loading image descriptions
+    JsonSave,   // saving image descriptions
+    Samples,    // extracting training samples
+    Forward,    // forward passes of the proposal net
+    COUNT
+};
+
+const size_t NB_METRICS = static_cast<size_t>(Metric::COUNT);
+
+std::string metric_to_str(Metric metric);
+
+struct Value {
+    uint64_t count = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t bytes = 0;
+};
+
+struct Snapshot {
+    std::array<Value, NB_METRICS> values;
+    // seconds since the counters started or were reset
+    double elapsed = 0;
+    size_t nb_threads = 0;
+
+    const Value & operator[](Metric metric) const {
+        return values[static_cast<size_t>(metric)];
+    }
+    nlohmann::json to_json() const;
+    // Prometheus text exposition format, one counter family per field.
+    std::string to_prometheus() const;
+};
+
+void record(Metric metric, uint64_t nanoseconds, uint64_t bytes = 0);
+Snapshot snapshot();
+// Sets all counters to zero. Samples recorded concurrently may be lost.
+void reset();
+
+// Writes a snapshot to `path`, in the Prometheus format if the path ends
+// with `.prom` and as json otherwise. The file is replaced atomically, so a
+// node exporter can pick it up at any time.
+void writeFile(const std::string & path);
+
+// Records the time from its construction to its destruction.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Metric metric, uint64_t bytes = 0) :
+        _metric(metric), _bytes(bytes), _start(std::chrono::steady_clock::now()) {}
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer & operator=(const ScopedTimer &) = delete;
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        record(_metric, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()), _bytes);
+    }
+    // for sizes that are only known at the end, e.g. of a decoded image
+    void setBytes(uint64_t bytes) {
+        _bytes = bytes;
+    }
+private:
+    Metric _metric;
+    uint64_t _bytes;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Calls writeFile every `interval` on a background thread and once more
+// when it is destroyed.
+class PeriodicWriter {
+public:
+    PeriodicWriter(std::string path, std::chrono::milliseconds interval);
+    PeriodicWriter(const PeriodicWriter &) = delete;
+    PeriodicWriter & operator=(const PeriodicWriter &) = delete;
+    ~PeriodicWriter();
+private:
+    std::string _path;
+    std::chrono::milliseconds _interval;
+    bool _stop = false;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::thread _worker;
+
+    void workerLoop();
+};
+
+// For the `--metrics FILE` and `--metrics-interval SECONDS` options of the
+// tools. An interval of 0 only writes the file at the end.
+std::unique_ptr<PeriodicWriter> startPeriodicWriter(const std::string & path,
+                                                    double interval_seconds);
+}
+}
+
+#endif //DEEP_LOCALIZER_STATS_H
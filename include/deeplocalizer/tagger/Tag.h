@@ -26,6 +26,10 @@ enum TagType {
     BeeWithoutTag,
 };
 
+// The names of the tag types in the json descriptions, e.g. "istag".
+std::string tagtype_to_string(TagType tagType);
+TagType tagtype_from_string(const std::string & str);
+
 class Tag {
 public:
     Tag();
@@ -77,6 +81,13 @@ private:
     static unsigned long generateId();
     static std::atomic_long id_counter;
 };
+
+// Batch versions of Tag::getSubimage, see getSubimageViews and packSubimages.
+std::vector<cv::Mat> getSubimageViews(const cv::Mat & orginal, const std::vector<Tag> & tags,
+                                      unsigned int border=0);
+void packSubimages(const cv::Mat & orginal, const std::vector<Tag> & tags,
+                   cv::Mat & blob, cv::Size patch_size,
+                   unsigned int border=0, double scale=NET_INPUT_SCALE);
 }
 
 Q_DECLARE_METATYPE(deeplocalizer::Tag)
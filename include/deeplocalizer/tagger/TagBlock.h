@@ -0,0 +1,175 @@
+#ifndef DEEP_LOCALIZER_TAGBLOCK_H
+#define DEEP_LOCALIZER_TAGBLOCK_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "Image.h"
+
+namespace deeplocalizer {
+
+class DescriptorStore;
+
+// Tags of many images stored column by column: one array each for the x and
+// y coordinates of the centers, the types and the ids. Scans over a single
+// column touch only that column and are easy for the compiler to vectorize.
+// A tag takes 17 bytes instead of the 32 of a Tag.
+// The tags of image i are [imageBegin(i), imageEnd(i)).
+class TagBlock {
+public:
+    // Looks like a (const) Tag, but reads from the columns of the block.
+    class TagRef {
+    public:
+        TagRef(const TagBlock & block, size_t idx) : _block(&block), _idx(idx) {}
+
+        unsigned long id() const {
+            return _block->_ids[_idx];
+        }
+        TagType type() const {
+            return static_cast<TagType>(_block->_types[_idx]);
+        }
+        cv::Point2i center() const {
+            return cv::Point2i(_block->_xs[_idx], _block->_ys[_idx]);
+        }
+        cv::Rect getBoundingBox() const {
+            return tagBoxForCenter(center());
+        }
+        bool isTag() const {
+            return type() == IsTag;
+        }
+        bool isNoTag() const {
+            return type() == NoTag;
+        }
+        bool isExclude() const {
+            return type() == Exclude;
+        }
+        bool isBeeWithoutTag() const {
+            return type() == BeeWithoutTag;
+        }
+        Tag toTag() const;
+    private:
+        const TagBlock * _block;
+        size_t _idx;
+    };
+
+    // An input iterator, since dereferencing returns a TagRef by value.
+    class const_iterator : public std::iterator<std::input_iterator_tag, TagRef,
+                                                std::ptrdiff_t, void, TagRef> {
+    public:
+        const_iterator(const TagBlock & block, size_t idx) : _block(&block), _idx(idx) {}
+        TagRef operator*() const {
+            return TagRef(*_block, _idx);
+        }
+        const_iterator & operator++() {
+            _idx++;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            _idx++;
+            return old;
+        }
+        const_iterator operator+(std::ptrdiff_t n) const {
+            return const_iterator(*_block, _idx + n);
+        }
+        std::ptrdiff_t operator-(const const_iterator & other) const {
+            return static_cast<std::ptrdiff_t>(_idx) - static_cast<std::ptrdiff_t>(other._idx);
+        }
+        bool operator==(const const_iterator & other) const {
+            return _idx == other._idx && _block == other._block;
+        }
+        bool operator!=(const const_iterator & other) const {
+            return !(*this == other);
+        }
+    private:
+        const TagBlock * _block;
+        size_t _idx;
+    };
+
+    static const size_t NB_TYPES = 4;
+
+    TagBlock() = default;
+    explicit TagBlock(const std::vector<Tag> & tags);
+    // All tags of the store. The store does not keep ids, they are 0.
+    static TagBlock fromStore(const DescriptorStore & store);
+
+    void reserve(size_t nb_tags);
+    void clear();
+    // Appends to the last image.
+    void push_back(const Tag & tag);
+    // Appends the tags of one more image.
+    void appendImage(const std::vector<Tag> & tags);
+
+    size_t size() const {
+        return _xs.size();
+    }
+    bool empty() const {
+        return _xs.empty();
+    }
+    TagRef operator[](size_t idx) const {
+        return TagRef(*this, idx);
+    }
+    const_iterator begin() const {
+        return const_iterator(*this, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(*this, size());
+    }
+
+    const std::vector<int32_t> & xs() const {
+        return _xs;
+    }
+    const std::vector<int32_t> & ys() const {
+        return _ys;
+    }
+    const std::vector<uint8_t> & types() const {
+        return _types;
+    }
+    const std::vector<uint64_t> & ids() const {
+        return _ids;
+    }
+
+    size_t nbImages() const {
+        return _image_offsets.size() - 1;
+    }
+    size_t imageBegin(size_t image) const {
+        return _image_offsets.at(image);
+    }
+    size_t imageEnd(size_t image) const {
+        return _image_offsets.at(image + 1);
+    }
+
+    std::vector<Tag> toTags() const;
+    // Number of tags of every TagType, indexed by the enum value.
+    std::array<size_t, NB_TYPES> countByType() const;
+    // Indices of all tags of `type`.
+    std::vector<uint32_t> select(TagType type) const;
+    // Indices of all tags with a center inside `rect`.
+    std::vector<uint32_t> select(const cv::Rect & rect) const;
+    // A new block with the tags at `indices`, as one image.
+    TagBlock gather(const std::vector<uint32_t> & indices) const;
+    // `n` indices drawn uniformly without replacement from `indices`.
+    template<typename Rng>
+    static std::vector<uint32_t> sample(std::vector<uint32_t> indices, size_t n, Rng & rng) {
+        n = std::min(n, indices.size());
+        for(size_t i = 0; i < n; i++) {
+            std::uniform_int_distribution<size_t> dis(i, indices.size() - 1);
+            std::swap(indices[i], indices[dis(rng)]);
+        }
+        indices.resize(n);
+        return indices;
+    }
+private:
+    std::vector<int32_t> _xs;
+    std::vector<int32_t> _ys;
+    std::vector<uint8_t> _types;
+    std::vector<uint64_t> _ids;
+    std::vector<size_t> _image_offsets{0};
+};
+}
+
+#endif //DEEP_LOCALIZER_TAGBLOCK_H
@@ -0,0 +1,65 @@
+#ifndef DEEP_LOCALIZER_TAGGRID_H
+#define DEEP_LOCALIZER_TAGGRID_H
+
+#include <unordered_map>
+#include <vector>
+
+#include <boost/optional/optional.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "Tag.h"
+
+namespace deeplocalizer {
+
+// A uniform grid over the bounding boxes of tags. Every tag is stored in all
+// cells its bounding box overlaps. With cells of the size of a tag, finding
+// the tag under a point or the tags in a rectangle only looks at a few
+// cells, independent of the number of tags in the image.
+class TagGrid {
+public:
+    explicit TagGrid(int cell_size = TAG_WIDTH);
+
+    void clear();
+    // Inserts a copy of the tag. A tag with the same id is replaced.
+    void insert(const Tag & tag);
+    bool erase(unsigned long id);
+    template<typename Container>
+    void insert(const Container & tags) {
+        for(const auto & tag : tags) {
+            insert(tag);
+        }
+    }
+
+    // The first inserted tag whose bounding box contains the point.
+    boost::optional<Tag> at(int x, int y) const;
+    // Like `at`, but without a copy. The pointer is valid until the grid changes.
+    const Tag * find(int x, int y) const;
+    // All tags whose bounding box intersects `rect`, in the order they were inserted.
+    std::vector<const Tag *> query(const cv::Rect & rect) const;
+
+    size_t size() const {
+        return _entries.size();
+    }
+    int cellSize() const {
+        return _cell_size;
+    }
+private:
+    struct Entry {
+        Tag tag;
+        size_t seq;
+    };
+    using cell_key_t = long long;
+
+    int _cell_size;
+    size_t _next_seq = 0;
+    std::unordered_map<unsigned long, Entry> _entries;
+    std::unordered_map<cell_key_t, std::vector<unsigned long>> _cells;
+
+    int cellCoord(int x) const;
+    static cell_key_t cellKey(int cell_x, int cell_y);
+    template<typename Fn>
+    void forEachCell(const cv::Rect & rect, Fn fn) const;
+};
+}
+
+#endif //DEEP_LOCALIZER_TAGGRID_H
@@ -0,0 +1,79 @@
+#ifndef DEEP_LOCALIZER_THUMBNAILCACHE_H
+#define DEEP_LOCALIZER_THUMBNAILCACHE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <opencv2/core/core.hpp>
+
+namespace deeplocalizer {
+
+// Small previews of the images, stored as jpeg files in a cache directory.
+// The file of an image is named after the stable hash of its filename, so
+// the directory can be shared by several tagger sessions.
+// A worker thread creates the missing thumbnails. It serves `request`ed
+// thumbnails first, the most recent request first, and then the ones passed
+// to `generate`. Only the requested thumbnails are passed to the callback,
+// on the worker thread. The ones of `generate` are just written to the
+// cache directory. All methods are thread-safe.
+class ThumbnailCache {
+public:
+    using callback_t = std::function<void(const std::string & filename,
+                                          const cv::Mat & thumbnail)>;
+    static const int DEFAULT_MAX_SIDE = 96;
+
+    explicit ThumbnailCache(const boost::filesystem::path & dir,
+                            int max_side = DEFAULT_MAX_SIDE);
+    ThumbnailCache(const ThumbnailCache &) = delete;
+    ThumbnailCache & operator=(const ThumbnailCache &) = delete;
+    ~ThumbnailCache();
+
+    // Waits until a running callback returned, so after
+    // `setCallback(nullptr)` the old callback is not called anymore.
+    // Must not be called from another thread while that thread blocks the
+    // callback.
+    void setCallback(callback_t callback);
+    void request(const std::string & filename);
+    // Creates the missing thumbnails of `filenames` in the background.
+    // Replaces the images of earlier calls that are still waiting.
+    void generate(std::vector<std::string> filenames);
+    // Loads or creates the thumbnail on the calling thread. Returns an empty
+    // matrix if the image cannot be read.
+    cv::Mat get(const std::string & filename);
+
+    boost::filesystem::path path(const std::string & filename) const;
+    size_t pending() const;
+    int maxSide() const {
+        return _max_side;
+    }
+
+    // Downscales `image` such that its longer side is at most `max_side`.
+    static cv::Mat makeThumbnail(const cv::Mat & image, int max_side);
+private:
+    boost::filesystem::path _dir;
+    int _max_side;
+    callback_t _callback;
+    bool _in_callback = false;
+    std::condition_variable _callback_done;
+
+    std::deque<std::string> _requests;
+    std::unordered_set<std::string> _requested;
+    std::deque<std::string> _background;
+    bool _stop = false;
+    mutable std::mutex _mutex;
+    std::condition_variable _work;
+    std::thread _worker;
+
+    void workerLoop();
+    cv::Mat load(const std::string & filename, bool only_missing);
+};
+}
+
+#endif //DEEP_LOCALIZER_THUMBNAILCACHE_H
@@ -13,6 +13,9 @@
 #include <QtGui/qpainter.h>
 #include "Image.h"
 #include "qt_helper.h"
+#include "ImageTileCache.h"
+#include "TagGrid.h"
+#include "ImageView.h"
 
 namespace deeplocalizer {
 
@@ -21,7 +24,7 @@ class Tag;
 class ImageDesc;
 
 
-class WholeImageWidget : public QWidget {
+class WholeImageWidget : public QWidget, public ImageView {
 Q_OBJECT
 
 public:
@@ -29,18 +32,21 @@ public:
     WholeImageWidget(QScrollArea * parent, cv::Mat mat, std::vector<Tag> * tags);
     WholeImageWidget(QScrollArea * parent,
                      boost::optional<std::pair<cv::Mat, std::vector<Tag> *>> tags);
-    void setTags(cv::Mat mat, std::vector<Tag> * tags);
-    void setZoomFactor(double factor);
-    inline double getZoomFactor() {
+    void setTags(cv::Mat mat, std::vector<Tag> * tags) override;
+    void setZoomFactor(double factor) override;
+    inline double getZoomFactor() const override {
         return _scale;
     };
     virtual QSize sizeHint() const;
+    void reindexTags() override;
+    QScrollBar * horizontalScrollBar() const override;
+    QScrollBar * verticalScrollBar() const override;
 public slots:
     boost::optional<Tag> createTag(int x, int y);
     void tagProcessed(Tag tag);
     void zoom(double factor);
-    void zoomIn();
-    void zoomOut();
+    void zoomIn() override;
+    void zoomOut() override;
     void zoomInRelToMouse(QPoint mouse_pos);
 signals:
     void imageFinished();
@@ -48,22 +54,25 @@ signals:
 protected:
     void mousePressEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent * event);
-    virtual void paintEvent(QPaintEvent *);
+    virtual void paintEvent(QPaintEvent * event);
 private:
     QScrollArea *_parent;
     cv::Mat _mat;
-    QPixmap _pixmap;
+    ImageTileCache _tiles;
     QPainter _painter;
     double _scale = 0.8;
     std::vector<Tag> * _tags;
     std::list<Tag> _newly_added_tags;
     std::set<unsigned long> _deleted_Ids;
+    // all tags in *_tags and _newly_added_tags
+    TagGrid _tag_grid;
 
-    boost::optional<Tag> getTag(int x, int y);
+    const Tag * getTag(int x, int y) const;
 
     template<typename T>
     void eraseTag(const unsigned long id, T& tags) {
         _deleted_Ids.insert(id);
+        _tag_grid.erase(id);
         tags.erase(std::remove_if(tags.begin(), tags.end(),
                                   [id](auto & t){
                                       return t.id() == id;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include <opencv2/core.hpp>
 
 namespace deeplocalizer {
@@ -8,6 +10,10 @@ namespace deeplocalizer {
     const int TAG_HEIGHT = 64;
     const cv::Point2i TAG_CENTER{TAG_WIDTH / 2, TAG_HEIGHT / 2};
     const cv::Size2i TAG_SIZE{TAG_WIDTH, TAG_HEIGHT};
+    // The tags are always TAG_SIZE, but the patches extracted around them
+    // for training and classification can be larger, e.g. the 100x100
+    // input of the proposal net. See Patch.h.
+    static const int PATCH_SIZE_DEFAULT = TAG_WIDTH;
 
     static const int MAX_TRANSLATION = TAG_WIDTH / 8;
     static const int MIN_TRANSLATION = -MAX_TRANSLATION;
@@ -16,12 +22,41 @@ namespace deeplocalizer {
     static const double TAGINESS_STD = 1./MAX_TRANSLATION;
     static const double RATIO_AROUND_TO_UNIFORM_DEFAULT = 0.2;
     static const double RATIO_TRUE_TO_FALSE_SAMPLES_DEFAULT = 1.;
+    // The nets are trained on pixels scaled by 1/256, the `scale` of the
+    // data layers in models/*/train_val.prototxt.
+    static const double NET_INPUT_SCALE = 1./256;
 
 
+    // The box grown by `additional_border` and moved into the image.
+    cv::Rect subimageBox(const cv::Mat & orginal, cv::Rect box,
+                         unsigned int additional_border=0);
     cv::Mat getSubimage(const cv::Mat & orginal, cv::Rect box,
                         unsigned int additional_border=0);
 
+    // Like getSubimage, but returns views into `orginal` instead of copies.
+    // The views share the data of `orginal` and keep it alive.
+    std::vector<cv::Mat> getSubimageViews(const cv::Mat & orginal,
+                                          const std::vector<cv::Rect> & boxes,
+                                          unsigned int additional_border=0);
+
+    // Packs the subimages into `blob`, a continuous float blob of the shape
+    // N x 1 x height x width as expected by the input layer of a caffe net.
+    // The pixels are multiplied by `scale`. Subimages that are not of
+    // `patch_size` are resized. `blob` is only reallocated if its shape
+    // changes, so it can be reused for every batch.
+    void packSubimages(const cv::Mat & orginal, const std::vector<cv::Rect> & boxes,
+                       cv::Mat & blob, cv::Size patch_size,
+                       unsigned int additional_border=0, double scale=NET_INPUT_SCALE);
+    // Writes one subimage as `patch_size` floats to `dst`, e.g. a plane of a blob.
+    void packSubimage(const cv::Mat & orginal, cv::Rect box, float * dst,
+                      cv::Size patch_size, unsigned int additional_border=0,
+                      double scale=NET_INPUT_SCALE);
+
     inline cv::Rect tagBoxForCenter(const cv::Point2i p) {
-        return cv::Rect(cv::Point2i(p.x - TAG_WIDTH/2, p.y - TAG_WIDTH/2), TAG_SIZE);
+        return cv::Rect(cv::Point2i(p.x - TAG_WIDTH/2, p.y - TAG_HEIGHT/2), TAG_SIZE);
+    }
+    // A square patch of `patch_size` centered at `p`.
+    inline cv::Rect patchBoxForCenter(const cv::Point2i p, int patch_size) {
+        return cv::Rect(p.x - patch_size/2, p.y - patch_size/2, patch_size, patch_size);
     }
 }
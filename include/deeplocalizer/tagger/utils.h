@@ -5,6 +5,10 @@
 #include <chrono>
 #include <sstream>
 #include <random>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <mutex>
 
 #include <boost/serialization/nvp.hpp>
 #include <boost/archive/archive_exception.hpp>
@@ -86,6 +90,79 @@ inline std::vector<unsigned long> shuffledIndecies(unsigned long n) {
     return indecies;
 }
 
+inline size_t defaultNbThreads() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Calls `fn(i)` for every `i` in [0, n) on `nb_threads` threads. The threads
+// share one counter and grab the next `chunk_size` indecies as soon as they
+// are idle, so expensive items do not stall the other threads.
+// The first exception thrown by `fn` is rethrown after all threads joined.
+template<typename Fn>
+void parallelFor(size_t n, size_t nb_threads, Fn fn, size_t chunk_size = 1) {
+    std::atomic<size_t> next_idx(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+    chunk_size = std::max<size_t>(chunk_size, 1);
+    auto worker = [&]() {
+        try {
+            for(size_t start = next_idx.fetch_add(chunk_size);
+                start < n && !failed.load(std::memory_order_relaxed);
+                start = next_idx.fetch_add(chunk_size)) {
+                size_t end = std::min(start + chunk_size, n);
+                for(size_t i = start; i < end; i++) {
+                    fn(i);
+                }
+            }
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+            failed = true;
+        }
+    };
+    nb_threads = std::max<size_t>(std::min(nb_threads, (n + chunk_size - 1) / chunk_size), 1);
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < nb_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for(auto & thread : threads) {
+        thread.join();
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+// FNV-1a hash. Unlike std::hash it is the same on every platform and run.
+inline uint64_t stableHash(const std::string & str) {
+    uint64_t hash = 14695981039346656037ull;
+    for(unsigned char c : str) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// The shard in [0, nb_shards) a file belongs to.
+inline size_t shardOf(const std::string & path, size_t nb_shards) {
+    return stableHash(path) % std::max<size_t>(nb_shards, 1);
+}
+
+// Parses a shard given as `i/N`.
+inline std::pair<size_t, size_t> parseShard(const std::string & str) {
+    auto slash = str.find('/');
+    ASSERT(slash != std::string::npos, "Expected a shard as i/N. But got: " << str);
+    size_t shard = std::stoul(str.substr(0, slash));
+    size_t nb_shards = std::stoul(str.substr(slash + 1));
+    ASSERT(nb_shards > 0 && shard < nb_shards, "Invalid shard " << str
+           << ". Shards are numbered from 0 to N-1.");
+    return std::make_pair(shard, nb_shards);
+}
+
 inline std::vector<std::string>  parsePathfile(std::string path) {
     const boost::filesystem::path pathfile(path);
     ASSERT(boost::filesystem::exists(pathfile), "File " << pathfile << " does not exists.");
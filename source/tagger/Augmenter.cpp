@@ -0,0 +1,176 @@
+
+#include "Augmenter.h"
+
+#include <cmath>
+#include <random>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "Patch.h"
+#include "TagGrid.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace {
+
+// rotations in steps of one degree
+const std::vector<cv::Vec2d> & rotationTable() {
+    static const std::vector<cv::Vec2d> table = []() {
+        std::vector<cv::Vec2d> t;
+        for(int deg = 0; deg < 360; deg++) {
+            const double rad = deg * CV_PI / 180;
+            t.emplace_back(std::cos(rad), std::sin(rad));
+        }
+        return t;
+    }();
+    return table;
+}
+
+// A patch of `patch_size` centered at `center` in the image, rotated by the
+// rotation with index `angle` around its center.
+cv::Matx23d patchToImage(cv::Point2d center, int angle, int patch_size) {
+    const cv::Vec2d & r = rotationTable().at(angle);
+    const double c = r[0];
+    const double s = r[1];
+    const double half = patch_size / 2;
+    // p_image = R * (p_patch - patch_center) + center
+    return cv::Matx23d(
+            c, -s, center.x - c*half + s*half,
+            s,  c, center.y - s*half - c*half);
+}
+
+// The top left corner of the patch in the image, if `patch_to_image` only
+// translates by whole pixels. Then warpAffine would copy the pixels anyway.
+bool isPixelTranslation(const cv::Matx23d & patch_to_image, cv::Point2i & top_left) {
+    const cv::Matx23d & m = patch_to_image;
+    if (m(0, 0) != 1 || m(0, 1) != 0 || m(1, 0) != 0 || m(1, 1) != 1 ||
+            m(0, 2) != std::floor(m(0, 2)) || m(1, 2) != std::floor(m(1, 2))) {
+        return false;
+    }
+    top_left = cv::Point2i(static_cast<int>(m(0, 2)), static_cast<int>(m(1, 2)));
+    return true;
+}
+
+bool closeToTag(const TagGrid & grid, cv::Point2i center) {
+    const int d = MIN_AROUND_WRONG;
+    for(const Tag * tag : grid.query(cv::Rect(center.x - d - TAG_WIDTH/2, center.y - d - TAG_HEIGHT/2,
+                                               2*d + TAG_WIDTH, 2*d + TAG_HEIGHT))) {
+        cv::Point2i diff = tag->center() - center;
+        if (diff.dot(diff) < d*d) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+Augmenter::Augmenter(const AugmentationOptions & opt) :
+    _opt(opt)
+{
+    ASSERT(opt.ratio_true_to_false > 0, "The ratio of true to false samples must be positive.");
+    ASSERT(opt.ratio_around_to_uniform >= 0 && opt.ratio_around_to_uniform <= 1,
+           "The ratio of around to uniform samples must be in [0, 1].");
+    checkPatchSize(opt.patch_size);
+}
+
+std::vector<Augmenter::Sample> Augmenter::plan(const cv::Size & image_size,
+                                               const ImageDesc & desc) const {
+    std::mt19937_64 rng(_opt.seed ^ stableHash(desc.filename));
+    std::uniform_int_distribution<int> angle_dis(0, _opt.rotate ? 359 : 0);
+    // the direction of a sample around a tag, also without rotation
+    std::uniform_int_distribution<int> direction_dis(0, 359);
+    std::uniform_int_distribution<int> translation_dis(MIN_TRANSLATION, MAX_TRANSLATION);
+    std::uniform_real_distribution<double> around_dis(MIN_AROUND_WRONG, MAX_AROUND_WRONG);
+    const int patch_size = _opt.patch_size;
+    const cv::Rect inner(patch_size/2, patch_size/2, image_size.width - patch_size,
+                         image_size.height - patch_size);
+
+    std::vector<Sample> samples;
+    std::vector<const Tag *> positives;
+    TagGrid occupied;
+    size_t nb_negatives = 0;
+    for(const auto & tag : desc.getTags()) {
+        if (tag.isExclude()) {
+            occupied.insert(tag);
+            continue;
+        }
+        const int label = tag.isTag() ? 1 : 0;
+        if (label == 1) {
+            positives.push_back(&tag);
+            occupied.insert(tag);
+        } else {
+            nb_negatives += _opt.sample_rate;
+        }
+        for(size_t i = 0; i < _opt.sample_rate; i++) {
+            cv::Point2d center(tag.center().x + translation_dis(rng),
+                               tag.center().y + translation_dis(rng));
+            samples.push_back(Sample{patchToImage(center, angle_dis(rng), patch_size), label});
+        }
+    }
+    const size_t nb_false = static_cast<size_t>(
+            std::round(positives.size() * _opt.sample_rate / _opt.ratio_true_to_false));
+    if (nb_false <= nb_negatives || inner.area() <= 0) {
+        return samples;
+    }
+    std::uniform_int_distribution<int> x_dis(patch_size/2, image_size.width - patch_size/2 - 1);
+    std::uniform_int_distribution<int> y_dis(patch_size/2, image_size.height - patch_size/2 - 1);
+    const size_t nb_generated = nb_false - nb_negatives;
+    const size_t nb_around = positives.empty() ? 0 :
+            static_cast<size_t>(std::round(nb_generated * _opt.ratio_around_to_uniform));
+    // gives up on crowded images instead of looping forever
+    const size_t max_tries = 10*nb_generated;
+    std::uniform_int_distribution<size_t> positive_dis(0, positives.empty() ? 0 : positives.size() - 1);
+    size_t nb_added = 0;
+    for(size_t tries = 0; nb_added < nb_generated && tries < max_tries; tries++) {
+        cv::Point2i center;
+        if (nb_added < nb_around) {
+            const Tag * tag = positives.at(positive_dis(rng));
+            const cv::Vec2d & direction = rotationTable().at(direction_dis(rng));
+            const double distance = around_dis(rng);
+            center = tag->center() + cv::Point2i(cvRound(direction[0]*distance),
+                                                  cvRound(direction[1]*distance));
+        } else {
+            center = cv::Point2i(x_dis(rng), y_dis(rng));
+        }
+        if (!inner.contains(center) || closeToTag(occupied, center)) {
+            continue;
+        }
+        samples.push_back(Sample{patchToImage(center, angle_dis(rng), patch_size), 0});
+        nb_added++;
+    }
+    return samples;
+}
+
+std::vector<TrainDatum> Augmenter::apply(const cv::Mat & image, const std::vector<Sample> & samples,
+                                         int patch_size) {
+    std::vector<TrainDatum> data;
+    if (samples.empty()) {
+        return data;
+    }
+    data.reserve(samples.size());
+    const cv::Rect image_box(0, 0, image.cols, image.rows);
+    cv::Mat buffer(static_cast<int>(samples.size()) * patch_size, patch_size, image.type());
+    for(size_t i = 0; i < samples.size(); i++) {
+        const int y = static_cast<int>(i) * patch_size;
+        cv::Mat patch = buffer.rowRange(y, y + patch_size);
+        cv::Point2i top_left;
+        if (isPixelTranslation(samples[i].patch_to_image, top_left) &&
+                image_box.contains(top_left) &&
+                image_box.contains(top_left + cv::Point2i(patch_size - 1, patch_size - 1))) {
+            copyPatch(image, top_left, patch);
+        } else {
+            // the matrix maps from the patch into the image, so warpAffine does not invert it
+            cv::warpAffine(image, patch, cv::Mat(samples[i].patch_to_image),
+                           cv::Size(patch_size, patch_size),
+                           cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REFLECT_101);
+        }
+        data.push_back(TrainDatum{patch, samples[i].label});
+    }
+    return data;
+}
+
+std::vector<TrainDatum> Augmenter::samples(const cv::Mat & image, const ImageDesc & desc) const {
+    return apply(image, plan(image.size(), desc), _opt.patch_size);
+}
+}
@@ -0,0 +1,74 @@
+
+#include "BackgroundWriter.h"
+
+#include <iostream>
+
+namespace deeplocalizer {
+
+BackgroundWriter::BackgroundWriter() :
+    _worker(&BackgroundWriter::workerLoop, this)
+{
+}
+
+BackgroundWriter::~BackgroundWriter() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _work.notify_all();
+    _worker.join();
+}
+
+void BackgroundWriter::schedule(const std::string & key, job_t job) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _jobs.find(key);
+        if (it != _jobs.end()) {
+            it->second = std::move(job);
+            return;
+        }
+        _jobs.emplace(key, std::move(job));
+        _order.push_back(key);
+    }
+    _work.notify_one();
+}
+
+void BackgroundWriter::flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]() { return _order.empty() && !_busy; });
+}
+
+size_t BackgroundWriter::pending() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _order.size();
+}
+
+void BackgroundWriter::workerLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true) {
+        _work.wait(lock, [this]() { return _stop || !_order.empty(); });
+        if (_order.empty()) {
+            // only stop after all jobs are written
+            return;
+        }
+        auto it = _jobs.find(_order.front());
+        job_t job = std::move(it->second);
+        _jobs.erase(it);
+        _order.pop_front();
+        _busy = true;
+        lock.unlock();
+        try {
+            job();
+        } catch(const std::string & msg) {
+            std::cerr << "[BackgroundWriter] " << msg << std::endl;
+        } catch(const std::exception & e) {
+            std::cerr << "[BackgroundWriter] " << e.what() << std::endl;
+        }
+        lock.lock();
+        _busy = false;
+        if (_order.empty()) {
+            _idle.notify_all();
+        }
+    }
+}
+}
@@ -0,0 +1,56 @@
+
+#include "DatasetGenerator.h"
+
+#include "Patch.h"
+#include "Stats.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+
+constexpr double DatasetGenerator::TEST_RATIO_DEFAULT;
+
+DatasetGenerator::DatasetGenerator(double test_ratio, const AugmentationOptions & augmentation) :
+    _test_ratio(test_ratio),
+    _augmenter(augmentation)
+{
+    ASSERT(test_ratio >= 0 && test_ratio <= 1, "The test ratio must be in [0, 1]. But got: " << test_ratio);
+}
+
+Phase DatasetGenerator::phase(const std::string & filename) const {
+    const double u = static_cast<double>(stableHash(filename) % 1000000) / 1000000;
+    return u < _test_ratio ? Phase::Test : Phase::Train;
+}
+
+std::vector<TrainDatum> DatasetGenerator::samples(const cv::Mat & image,
+                                                  const ImageDesc & desc) const {
+    stats::ScopedTimer timer(stats::Metric::Samples, image.total());
+    if (_augmenter.options().sample_rate > 0) {
+        return _augmenter.samples(image, desc);
+    }
+    const auto & tags = desc.getTags();
+    const int patch_size = _augmenter.options().patch_size;
+    std::vector<const Tag *> selected;
+    selected.reserve(tags.size());
+    for(const auto & tag : tags) {
+        if (!tag.isExclude()) {
+            selected.push_back(&tag);
+        }
+    }
+    std::vector<TrainDatum> data;
+    if (selected.empty()) {
+        return data;
+    }
+    data.reserve(selected.size());
+    // Copies into one buffer per image, like Augmenter::apply. Views would
+    // keep the whole frame alive until their batch is written.
+    cv::Mat buffer(static_cast<int>(selected.size()) * patch_size, patch_size, image.type());
+    for(size_t i = 0; i < selected.size(); i++) {
+        const int y = static_cast<int>(i) * patch_size;
+        cv::Mat patch = buffer.rowRange(y, y + patch_size);
+        const cv::Rect box = subimageBox(image, patchBoxForCenter(selected[i]->center(), patch_size));
+        copyPatch(image, box.tl(), patch);
+        data.push_back(TrainDatum{patch, selected[i]->isTag() ? 1 : 0});
+    }
+    return data;
+}
+}
@@ -0,0 +1,401 @@
+
+#include "DatasetWriter.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#ifdef DEEPLOCALIZER_USE_LMDB
+#include <lmdb.h>
+#endif
+
+#ifdef DEEPLOCALIZER_USE_HDF5
+#include <hdf5.h>
+#endif
+
+#include "deeplocalizer_tagger.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace io = boost::filesystem;
+
+std::string phase_to_str(Phase phase) {
+    switch (phase) {
+        case Phase::Train:
+            return "train";
+        case Phase::Test:
+            return "test";
+        default:
+            throw "unknown phase";
+    }
+}
+
+DatasetFormat str_to_dataset_format(const std::string & str) {
+    if (str == "images") {
+        return DatasetFormat::Images;
+    } else if (str == "lmdb") {
+        return DatasetFormat::LMDB;
+    }
+    ASSERT(str == "hdf5", "Expected `images`, `lmdb` or `hdf5` format. But got: " << str);
+    return DatasetFormat::HDF5;
+}
+
+bool isAvailable(DatasetFormat format) {
+    switch (format) {
+        case DatasetFormat::Images:
+            return true;
+        case DatasetFormat::LMDB:
+#ifdef DEEPLOCALIZER_USE_LMDB
+            return true;
+#else
+            return false;
+#endif
+        case DatasetFormat::HDF5:
+#ifdef DEEPLOCALIZER_USE_HDF5
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+namespace {
+
+void openLists(const io::path & output_dir, std::ofstream (&lists)[2]) {
+    io::create_directories(output_dir);
+    for(Phase phase : {Phase::Train, Phase::Test}) {
+        io::path path = output_dir / (phase_to_str(phase) + ".txt");
+        lists[static_cast<int>(phase)].open(path.string());
+        ASSERT(lists[static_cast<int>(phase)].good(), "Could not open " << path);
+    }
+}
+
+std::string numbered(const std::string & prefix, size_t number, size_t width) {
+    std::stringstream ss;
+    ss << prefix << std::setw(width) << std::setfill('0') << number;
+    return ss.str();
+}
+}
+
+std::unique_ptr<DatasetWriter> DatasetWriter::create(DatasetFormat format,
+                                                     const io::path & output_dir,
+                                                     const DatasetWriterOptions & opt) {
+    ASSERT(isAvailable(format), "This build does not support the dataset format. "
+           "LMDB and HDF5 need the libraries at build time.");
+    switch (format) {
+        case DatasetFormat::Images:
+            return std::make_unique<ImageDatasetWriter>(output_dir);
+#ifdef DEEPLOCALIZER_USE_LMDB
+        case DatasetFormat::LMDB:
+            return std::make_unique<LMDBDatasetWriter>(output_dir, opt);
+#endif
+#ifdef DEEPLOCALIZER_USE_HDF5
+        case DatasetFormat::HDF5:
+            return std::make_unique<HDF5DatasetWriter>(output_dir, opt);
+#endif
+        default:
+            (void) opt;
+            return nullptr;
+    }
+}
+
+ImageDatasetWriter::ImageDatasetWriter(const io::path & output_dir) :
+    _output_dir(io::absolute(output_dir))
+{
+    openLists(_output_dir, _lists);
+}
+
+ImageDatasetWriter::~ImageDatasetWriter() {
+    close();
+}
+
+void ImageDatasetWriter::write(const std::vector<TrainDatum> & batch, Phase phase) {
+    const int p = static_cast<int>(phase);
+    for(const auto & datum : batch) {
+        size_t & count = _counts[p];
+        // keeps the directories small enough for every filesystem
+        io::path dir = _output_dir / phase_to_str(phase) /
+                numbered("", count / FILES_PER_DIRECTORY, 5);
+        if (count % FILES_PER_DIRECTORY == 0) {
+            io::create_directories(dir);
+        }
+        io::path path = dir / (numbered("", count, 8) + ".png");
+        ASSERT(cv::imwrite(path.string(), datum.patch), "Could not write " << path);
+        _lists[p] << path.string() << " " << datum.label << '\n';
+        count++;
+    }
+}
+
+void ImageDatasetWriter::close() {
+    for(auto & list : _lists) {
+        list.flush();
+    }
+}
+
+#ifdef DEEPLOCALIZER_USE_LMDB
+
+namespace {
+
+void checkLMDB(int rc) {
+    ASSERT(rc == MDB_SUCCESS, "LMDB error: " << mdb_strerror(rc));
+}
+
+void appendVarint(std::string & out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void appendField(std::string & out, int field, int64_t value) {
+    appendVarint(out, static_cast<uint64_t>(field << 3));
+    appendVarint(out, static_cast<uint64_t>(value));
+}
+}
+
+struct LMDBDatasetWriter::Database {
+    MDB_env * env = nullptr;
+    MDB_dbi dbi;
+    size_t bytes = 0;
+    size_t count = 0;
+
+    Database(const io::path & path, size_t map_size) {
+        io::create_directories(path);
+        checkLMDB(mdb_env_create(&env));
+        checkLMDB(mdb_env_set_mapsize(env, map_size));
+        checkLMDB(mdb_env_open(env, path.string().c_str(), 0, 0664));
+        MDB_txn * txn;
+        checkLMDB(mdb_txn_begin(env, nullptr, 0, &txn));
+        checkLMDB(mdb_dbi_open(txn, nullptr, 0, &dbi));
+        checkLMDB(mdb_txn_commit(txn));
+    }
+    ~Database() {
+        mdb_dbi_close(env, dbi);
+        mdb_env_close(env);
+    }
+    void write(const std::vector<std::string> & values) {
+        MDB_txn * txn;
+        checkLMDB(mdb_txn_begin(env, nullptr, 0, &txn));
+        for(const auto & value : values) {
+            std::string key = numbered("", count++, 10);
+            MDB_val mdb_key{key.size(), const_cast<char *>(key.data())};
+            MDB_val mdb_value{value.size(), const_cast<char *>(value.data())};
+            int rc = mdb_put(txn, dbi, &mdb_key, &mdb_value, 0);
+            if (rc != MDB_SUCCESS) {
+                mdb_txn_abort(txn);
+                checkLMDB(rc);
+            }
+            bytes += key.size() + value.size();
+        }
+        checkLMDB(mdb_txn_commit(txn));
+    }
+};
+
+std::string LMDBDatasetWriter::encodeDatum(const cv::Mat & patch, int label) {
+    ASSERT(patch.type() == CV_8UC1, "Expected a grayscale patch");
+    std::string out;
+    out.reserve(patch.total() + 32);
+    appendField(out, 1, 1);
+    appendField(out, 2, patch.rows);
+    appendField(out, 3, patch.cols);
+    // field 4, bytes
+    appendVarint(out, (4 << 3) | 2);
+    appendVarint(out, patch.total());
+    // row by row, as patches are often views into a larger image
+    for(int y = 0; y < patch.rows; y++) {
+        out.append(patch.ptr<char>(y), patch.cols);
+    }
+    appendField(out, 5, label);
+    return out;
+}
+
+LMDBDatasetWriter::LMDBDatasetWriter(const io::path & output_dir,
+                                     const DatasetWriterOptions & opt) :
+    _output_dir(io::absolute(output_dir)),
+    _opt(opt)
+{
+    openLists(_output_dir, _lists);
+}
+
+LMDBDatasetWriter::~LMDBDatasetWriter() {
+    close();
+}
+
+LMDBDatasetWriter::Database & LMDBDatasetWriter::database(Phase phase, size_t next_bytes) {
+    const int p = static_cast<int>(phase);
+    auto & db = _dbs[p];
+    if (!db || (db->count > 0 && db->bytes + next_bytes > _opt.max_file_bytes)) {
+        db.reset();
+        io::path path = _output_dir / numbered(phase_to_str(phase) + "_lmdb_", _nb_files[p]++, 3);
+        // the map size is only reserved address space, the file grows as needed
+        db = std::make_unique<Database>(path, 2*_opt.max_file_bytes + 2*next_bytes + (64 << 20));
+        _lists[p] << path.string() << '\n' << std::flush;
+    }
+    return *db;
+}
+
+void LMDBDatasetWriter::write(const std::vector<TrainDatum> & batch, Phase phase) {
+    std::vector<std::string> values;
+    values.reserve(batch.size());
+    size_t bytes = 0;
+    for(const auto & datum : batch) {
+        values.push_back(encodeDatum(datum.patch, datum.label));
+        bytes += values.back().size();
+    }
+    database(phase, bytes).write(values);
+}
+
+void LMDBDatasetWriter::close() {
+    for(auto & db : _dbs) {
+        db.reset();
+    }
+    for(auto & list : _lists) {
+        list.flush();
+    }
+}
+#endif
+
+#ifdef DEEPLOCALIZER_USE_HDF5
+
+namespace {
+
+void checkHDF5(herr_t status, const char * what) {
+    ASSERT(status >= 0, "HDF5 error in " << what);
+}
+}
+
+// The `data` dataset has the shape N x 1 x height x width and holds the
+// patches scaled by NET_INPUT_SCALE, like the data layers of the nets scale
+// the LMDB bytes. `label` has the shape N x 1. Both can be read
+// by Caffe's HDF5Data layer.
+struct HDF5DatasetWriter::File {
+    hid_t file;
+    hid_t data;
+    hid_t label;
+    hsize_t height;
+    hsize_t width;
+    size_t count = 0;
+    size_t bytes = 0;
+
+    File(const io::path & path, const DatasetWriterOptions & opt, int rows, int cols) :
+        height(rows), width(cols)
+    {
+        file = H5Fcreate(path.string().c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        ASSERT(file >= 0, "Could not create " << path);
+        const hsize_t chunk = std::max<size_t>(opt.chunk_size, 1);
+        hsize_t data_dims[4] = {0, 1, height, width};
+        hsize_t data_max[4] = {H5S_UNLIMITED, 1, height, width};
+        hsize_t data_chunk[4] = {chunk, 1, height, width};
+        data = createDataset("data", 4, data_dims, data_max, data_chunk, opt.compression);
+        hsize_t label_dims[2] = {0, 1};
+        hsize_t label_max[2] = {H5S_UNLIMITED, 1};
+        hsize_t label_chunk[2] = {chunk, 1};
+        label = createDataset("label", 2, label_dims, label_max, label_chunk, opt.compression);
+    }
+    ~File() {
+        H5Dclose(data);
+        H5Dclose(label);
+        H5Fclose(file);
+    }
+    hid_t createDataset(const char * name, int rank, const hsize_t * dims,
+                        const hsize_t * max_dims, const hsize_t * chunk, int compression) {
+        hid_t space = H5Screate_simple(rank, dims, max_dims);
+        hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+        checkHDF5(H5Pset_chunk(plist, rank, chunk), "H5Pset_chunk");
+        if (compression > 0) {
+            checkHDF5(H5Pset_deflate(plist, static_cast<unsigned>(compression)), "H5Pset_deflate");
+        }
+        hid_t dataset = H5Dcreate2(file, name, H5T_NATIVE_FLOAT, space,
+                                   H5P_DEFAULT, plist, H5P_DEFAULT);
+        H5Pclose(plist);
+        H5Sclose(space);
+        ASSERT(dataset >= 0, "Could not create HDF5 dataset " << name);
+        return dataset;
+    }
+    void append(hid_t dataset, int rank, const hsize_t * shape, const float * values) {
+        hsize_t new_dims[4];
+        hsize_t start[4] = {count, 0, 0, 0};
+        for(int i = 0; i < rank; i++) {
+            new_dims[i] = shape[i];
+        }
+        new_dims[0] += count;
+        checkHDF5(H5Dset_extent(dataset, new_dims), "H5Dset_extent");
+        hid_t file_space = H5Dget_space(dataset);
+        checkHDF5(H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr,
+                                      shape, nullptr), "H5Sselect_hyperslab");
+        hid_t mem_space = H5Screate_simple(rank, shape, nullptr);
+        checkHDF5(H5Dwrite(dataset, H5T_NATIVE_FLOAT, mem_space, file_space,
+                           H5P_DEFAULT, values), "H5Dwrite");
+        H5Sclose(mem_space);
+        H5Sclose(file_space);
+    }
+    void write(const std::vector<TrainDatum> & batch) {
+        const size_t n = batch.size();
+        std::vector<float> data_values(n * height * width);
+        std::vector<float> label_values(n);
+        for(size_t i = 0; i < n; i++) {
+            const cv::Mat & patch = batch.at(i).patch;
+            ASSERT(patch.type() == CV_8UC1 && hsize_t(patch.rows) == height &&
+                   hsize_t(patch.cols) == width, "All patches must have the same size");
+            cv::Mat out(patch.rows, patch.cols, CV_32F, data_values.data() + i * height * width);
+            patch.convertTo(out, CV_32F, NET_INPUT_SCALE);
+            label_values.at(i) = static_cast<float>(batch.at(i).label);
+        }
+        hsize_t data_shape[4] = {n, 1, height, width};
+        hsize_t label_shape[2] = {n, 1};
+        append(data, 4, data_shape, data_values.data());
+        append(label, 2, label_shape, label_values.data());
+        count += n;
+        bytes += (data_values.size() + label_values.size()) * sizeof(float);
+    }
+};
+
+HDF5DatasetWriter::HDF5DatasetWriter(const io::path & output_dir,
+                                     const DatasetWriterOptions & opt) :
+    _output_dir(io::absolute(output_dir)),
+    _opt(opt)
+{
+    openLists(_output_dir, _lists);
+}
+
+HDF5DatasetWriter::~HDF5DatasetWriter() {
+    close();
+}
+
+HDF5DatasetWriter::File & HDF5DatasetWriter::file(Phase phase, const cv::Mat & patch,
+                                                 size_t next_bytes) {
+    const int p = static_cast<int>(phase);
+    auto & f = _files[p];
+    // the size is measured uncompressed, so the files stay below the limit
+    if (!f || (f->count > 0 && f->bytes + next_bytes > _opt.max_file_bytes)) {
+        f.reset();
+        io::path path = _output_dir / (numbered(phase_to_str(phase) + "_", _nb_files[p]++, 3) + ".h5");
+        f = std::make_unique<File>(path, _opt, patch.rows, patch.cols);
+        _lists[p] << path.string() << '\n' << std::flush;
+    }
+    return *f;
+}
+
+void HDF5DatasetWriter::write(const std::vector<TrainDatum> & batch, Phase phase) {
+    if (batch.empty()) {
+        return;
+    }
+    const cv::Mat & first = batch.front().patch;
+    const size_t next_bytes = batch.size() * (first.total() + 1) * sizeof(float);
+    file(phase, first, next_bytes).write(batch);
+}
+
+void HDF5DatasetWriter::close() {
+    for(auto & f : _files) {
+        f.reset();
+    }
+    for(auto & list : _lists) {
+        list.flush();
+    }
+}
+#endif
+}
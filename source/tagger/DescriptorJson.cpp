@@ -0,0 +1,335 @@
+
+#include "DescriptorJson.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "Stats.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+namespace descriptor_json {
+
+namespace io = boost::filesystem;
+
+namespace {
+
+bool equals(const char * begin, const char * end, const char * literal) {
+    const size_t n = std::strlen(literal);
+    return static_cast<size_t>(end - begin) == n && std::memcmp(begin, literal, n) == 0;
+}
+
+// the first character is enough to tell the tag types apart
+TagType tagTypeFromName(const char * begin, const char * end) {
+    if (begin != end) {
+        switch (*begin) {
+            case 'n':
+                if (equals(begin, end, "notag")) return TagType::NoTag;
+                break;
+            case 'b':
+                if (equals(begin, end, "bee_without_tag")) return TagType::BeeWithoutTag;
+                break;
+            case 'e':
+                if (equals(begin, end, "exclude")) return TagType::Exclude;
+                break;
+            case 'i':
+                if (equals(begin, end, "istag")) return TagType::IsTag;
+                break;
+        }
+    }
+    throw std::string("unknown tag type: ") + std::string(begin, end);
+}
+
+void writeString(std::ostream & os, const std::string & str) {
+    os.put('"');
+    for(char c : str) {
+        switch (c) {
+            case '"':  os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\b': os << "\\b"; break;
+            case '\f': os << "\\f"; break;
+            case '\n': os << "\\n"; break;
+            case '\r': os << "\\r"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    os << buf;
+                } else {
+                    os.put(c);
+                }
+        }
+    }
+    os.put('"');
+}
+
+// A pull parser over the text. Strings without escapes are not copied.
+class Parser {
+public:
+    Parser(const char * begin, const char * end) : _pos(begin), _end(end) {}
+
+    ImageDesc parseDesc() {
+        ImageDesc desc;
+        expect('{');
+        if (!consume('}')) {
+            do {
+                const std::string key = parseString();
+                expect(':');
+                if (key == "filename") {
+                    desc.filename = parseString();
+                } else if (key == "tags") {
+                    parseTags(desc.getTags());
+                } else {
+                    skipValue();
+                }
+            } while(consume(','));
+            expect('}');
+        }
+        skipWhitespace();
+        ASSERT(_pos == _end, "Unexpected content after the image description");
+        return desc;
+    }
+private:
+    const char * _pos;
+    const char * _end;
+    std::string _buffer;
+
+    void skipWhitespace() {
+        while(_pos < _end && (*_pos == ' ' || *_pos == '\n' || *_pos == '\r' || *_pos == '\t')) {
+            _pos++;
+        }
+    }
+    bool consume(char c) {
+        skipWhitespace();
+        if (_pos < _end && *_pos == c) {
+            _pos++;
+            return true;
+        }
+        return false;
+    }
+    void expect(char c) {
+        ASSERT(consume(c), "Expected `" << c << "` in image description json");
+    }
+    // Returns the raw characters of the string. Escaped strings are decoded
+    // into `_buffer`.
+    std::pair<const char *, const char *> parseStringView() {
+        expect('"');
+        const char * begin = _pos;
+        const char * quote = static_cast<const char *>(std::memchr(_pos, '"', _end - _pos));
+        ASSERT(quote != nullptr, "Unterminated string in image description json");
+        if (!std::memchr(begin, '\\', quote - begin)) {
+            _pos = quote + 1;
+            return {begin, quote};
+        }
+        _buffer.clear();
+        while(_pos < _end && *_pos != '"') {
+            char c = *_pos++;
+            if (c != '\\') {
+                _buffer.push_back(c);
+                continue;
+            }
+            ASSERT(_pos < _end, "Unterminated string in image description json");
+            c = *_pos++;
+            switch (c) {
+                case 'b': _buffer.push_back('\b'); break;
+                case 'f': _buffer.push_back('\f'); break;
+                case 'n': _buffer.push_back('\n'); break;
+                case 'r': _buffer.push_back('\r'); break;
+                case 't': _buffer.push_back('\t'); break;
+                case 'u': appendCodepoint(); break;
+                default: _buffer.push_back(c);
+            }
+        }
+        expect('"');
+        return {_buffer.data(), _buffer.data() + _buffer.size()};
+    }
+    std::string parseString() {
+        auto view = parseStringView();
+        return std::string(view.first, view.second);
+    }
+    unsigned parseHex4() {
+        ASSERT(_end - _pos >= 4, "Invalid escape in image description json");
+        char hex[5] = {_pos[0], _pos[1], _pos[2], _pos[3], '\0'};
+        _pos += 4;
+        return static_cast<unsigned>(std::strtoul(hex, nullptr, 16));
+    }
+    void appendCodepoint() {
+        unsigned cp = parseHex4();
+        if (cp >= 0xD800 && cp < 0xDC00 && _end - _pos >= 6 && _pos[0] == '\\' && _pos[1] == 'u') {
+            _pos += 2;
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (parseHex4() - 0xDC00);
+        }
+        // utf-8
+        if (cp < 0x80) {
+            _buffer.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            _buffer.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            _buffer.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            _buffer.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            _buffer.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            _buffer.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            _buffer.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            _buffer.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            _buffer.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            _buffer.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+    // Integers are read directly, other numbers are truncated like
+    // nlohmann::json does when converting to int.
+    int parseInt() {
+        skipWhitespace();
+        // copied, as the text does not have to be null terminated
+        char number[32];
+        const size_t n = std::min<size_t>(sizeof(number) - 1, _end - _pos);
+        std::memcpy(number, _pos, n);
+        number[n] = '\0';
+        char * num_end;
+        long value = std::strtol(number, &num_end, 10);
+        ASSERT(num_end != number, "Expected a number in image description json");
+        if (*num_end == '.' || *num_end == 'e' || *num_end == 'E') {
+            value = static_cast<long>(std::strtod(number, &num_end));
+        }
+        _pos += num_end - number;
+        return static_cast<int>(value);
+    }
+    void parseTags(std::vector<Tag> & tags) {
+        expect('[');
+        // every tag is an object, so this bounds the number of tags
+        tags.reserve(std::count(_pos, _end, '{'));
+        if (consume(']')) {
+            return;
+        }
+        do {
+            tags.push_back(parseTag());
+        } while(consume(','));
+        expect(']');
+    }
+    Tag parseTag() {
+        cv::Point2i center;
+        TagType type = TagType::IsTag;
+        bool has_x = false, has_y = false, has_type = false;
+        expect('{');
+        if (!consume('}')) {
+            do {
+                auto key = parseStringView();
+                const size_t key_size = key.second - key.first;
+                const char first = key_size == 1 ? *key.first : '\0';
+                expect(':');
+                if (first == 'x') {
+                    center.x = parseInt();
+                    has_x = true;
+                } else if (first == 'y') {
+                    center.y = parseInt();
+                    has_y = true;
+                } else if (equals(key.first, key.second, "tagtype")) {
+                    auto value = parseStringView();
+                    type = tagTypeFromName(value.first, value.second);
+                    has_type = true;
+                } else {
+                    skipValue();
+                }
+            } while(consume(','));
+            expect('}');
+        }
+        ASSERT(has_x && has_y && has_type, "A tag needs x, y and tagtype");
+        Tag tag(tagBoxForCenter(center));
+        tag.setType(type);
+        return tag;
+    }
+    void skipValue() {
+        skipWhitespace();
+        ASSERT(_pos < _end, "Unexpected end of image description json");
+        const char c = *_pos;
+        if (c == '"') {
+            parseStringView();
+        } else if (c == '{' || c == '[') {
+            const char close = c == '{' ? '}' : ']';
+            _pos++;
+            if (consume(close)) {
+                return;
+            }
+            do {
+                if (c == '{') {
+                    parseStringView();
+                    expect(':');
+                }
+                skipValue();
+            } while(consume(','));
+            expect(close);
+        } else {
+            // numbers, true, false and null
+            while(_pos < _end && *_pos != ',' && *_pos != '}' && *_pos != ']' &&
+                  *_pos != ' ' && *_pos != '\n' && *_pos != '\r' && *_pos != '\t') {
+                _pos++;
+            }
+        }
+    }
+};
+}
+
+void write(std::ostream & os, const ImageDesc & desc) {
+    os << "{\"filename\":";
+    writeString(os, desc.filename);
+    os << ",\"tags\":[";
+    bool first = true;
+    for(const auto & tag : desc.getTags()) {
+        if (!first) {
+            os.put(',');
+        }
+        first = false;
+        const cv::Point2i c = tag.center();
+        os << "{\"tagtype\":\"" << tagtype_to_string(tag.type()) << "\",\"x\":" << c.x
+           << ",\"y\":" << c.y << '}';
+    }
+    os << "]}";
+}
+
+std::string dump(const ImageDesc & desc) {
+    std::ostringstream os;
+    write(os, desc);
+    return os.str();
+}
+
+void save(const std::string & path, const ImageDesc & desc) {
+    io::path save_path{path};
+    io::path tmp_path = io::unique_path(save_path.parent_path() / "%%%%%%%%%.json");
+    stats::ScopedTimer timer(stats::Metric::JsonSave);
+    {
+        std::ofstream os(tmp_path.string());
+        write(os, desc);
+        ASSERT(os.good(), "Could not write " << tmp_path);
+    }
+    io::rename(tmp_path, save_path);
+}
+
+ImageDesc parse(const char * begin, const char * end) {
+    return Parser(begin, end).parseDesc();
+}
+
+ImageDesc parse(const std::string & text) {
+    return parse(text.data(), text.data() + text.size());
+}
+
+ImageDesc load(const std::string & path) {
+    stats::ScopedTimer timer(stats::Metric::JsonLoad);
+    std::ifstream is(path, std::ios::binary);
+    ASSERT(is.good(), "Could not open " << path);
+    std::string text;
+    is.seekg(0, std::ios::end);
+    text.resize(static_cast<size_t>(is.tellg()));
+    is.seekg(0, std::ios::beg);
+    is.read(&text[0], text.size());
+    timer.setBytes(text.size());
+    return parse(text);
+}
+}
+}
@@ -0,0 +1,157 @@
+#include "DescriptorStore.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace io = boost::filesystem;
+namespace bip = boost::interprocess;
+using namespace store;
+
+const char DescriptorStore::MAGIC[8] = {'D', 'L', 'D', 'E', 'S', 'C', '\0', '\0'};
+const uint32_t DescriptorStore::VERSION;
+
+PackedTag PackedTag::fromTag(const Tag & tag) {
+    PackedTag packed{};
+    packed.x = tag.center().x;
+    packed.y = tag.center().y;
+    packed.type = static_cast<uint8_t>(tag.type());
+    return packed;
+}
+
+Tag PackedTag::toTag() const {
+    Tag tag(tagBoxForCenter(cv::Point2i(x, y)));
+    tag.setType(static_cast<TagType>(type));
+    return tag;
+}
+
+DescriptorStore::DescriptorStore(const std::string & path) {
+    ASSERT(io::exists(path), "File " << path << " does not exists.");
+    const uintmax_t file_size = io::file_size(path);
+    ASSERT(file_size >= sizeof(Header), "File " << path << " is not a descriptor store.");
+    _file = bip::file_mapping(path.c_str(), bip::read_only);
+    _region = bip::mapped_region(_file, bip::read_only);
+    _data = static_cast<const char *>(_region.get_address());
+    _header = reinterpret_cast<const Header *>(_data);
+    ASSERT(std::memcmp(_header->magic, MAGIC, sizeof(MAGIC)) == 0,
+           "File " << path << " is not a descriptor store.");
+    ASSERT(_header->version == VERSION,
+           "Descriptor store " << path << " has version " << _header->version
+           << ", expected " << VERSION);
+    ASSERT(_header->images_offset + _header->nb_images * sizeof(ImageEntry) <= file_size &&
+           _header->tags_offset + _header->nb_tags * sizeof(PackedTag) <= file_size &&
+           _header->strings_offset + _header->strings_size <= file_size,
+           "Descriptor store " << path << " is truncated.");
+    _images = reinterpret_cast<const ImageEntry *>(_data + _header->images_offset);
+    _tags = reinterpret_cast<const PackedTag *>(_data + _header->tags_offset);
+    _strings = _data + _header->strings_offset;
+}
+
+const ImageEntry & DescriptorStore::entry(size_t idx) const {
+    ASSERT(idx < size(), "Index " << idx << " exceeds descriptor store of size " << size());
+    return _images[idx];
+}
+
+boost::string_ref DescriptorStore::filename(size_t idx) const {
+    const ImageEntry & e = entry(idx);
+    return boost::string_ref(_strings + e.filename_offset, e.filename_size);
+}
+
+const PackedTag * DescriptorStore::tagsBegin(size_t idx) const {
+    return _tags + entry(idx).first_tag;
+}
+
+const PackedTag * DescriptorStore::tagsEnd(size_t idx) const {
+    const ImageEntry & e = entry(idx);
+    return _tags + e.first_tag + e.nb_tags;
+}
+
+size_t DescriptorStore::nbTags(size_t idx) const {
+    return entry(idx).nb_tags;
+}
+
+ImageDesc DescriptorStore::imageDesc(size_t idx) const {
+    std::vector<Tag> tags;
+    tags.reserve(nbTags(idx));
+    for(auto tag = tagsBegin(idx); tag != tagsEnd(idx); tag++) {
+        tags.push_back(tag->toTag());
+    }
+    return ImageDesc(filename(idx).to_string(), std::move(tags));
+}
+
+std::vector<ImageDescPtr> DescriptorStore::toImageDescs() const {
+    std::vector<ImageDescPtr> descs;
+    descs.reserve(size());
+    for(size_t i = 0; i < size(); i++) {
+        descs.push_back(std::make_shared<ImageDesc>(imageDesc(i)));
+    }
+    return descs;
+}
+
+void DescriptorStore::exportJson(const std::string & extension) const {
+    for(size_t i = 0; i < size(); i++) {
+        ImageDesc desc = imageDesc(i);
+        desc.setSavePathExtension(extension);
+        desc.save();
+    }
+}
+
+template<typename Getter>
+void writeStore(const std::string & path, size_t nb_images, Getter get) {
+    Header header{};
+    std::memcpy(header.magic, DescriptorStore::MAGIC, sizeof(header.magic));
+    header.version = DescriptorStore::VERSION;
+    header.nb_images = nb_images;
+
+    std::vector<ImageEntry> images;
+    std::vector<PackedTag> tags;
+    std::string strings;
+    images.reserve(nb_images);
+    for(size_t i = 0; i < nb_images; i++) {
+        const ImageDesc & desc = get(i);
+        ImageEntry e{};
+        e.filename_offset = strings.size();
+        e.filename_size = static_cast<uint32_t>(desc.filename.size());
+        e.first_tag = tags.size();
+        e.nb_tags = static_cast<uint32_t>(desc.getTags().size());
+        strings += desc.filename;
+        for(const auto & tag : desc.getTags()) {
+            tags.push_back(PackedTag::fromTag(tag));
+        }
+        images.push_back(e);
+    }
+    header.nb_tags = tags.size();
+    header.images_offset = sizeof(Header);
+    header.tags_offset = header.images_offset + images.size() * sizeof(ImageEntry);
+    header.strings_offset = header.tags_offset + tags.size() * sizeof(PackedTag);
+    header.strings_size = strings.size();
+
+    io::path save_path{path};
+    io::path tmp_path = io::unique_path(save_path.parent_path() / "%%%%%%%%%.store");
+    {
+        std::ofstream os(tmp_path.string(), std::ios::binary);
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        os.write(reinterpret_cast<const char *>(images.data()), images.size() * sizeof(ImageEntry));
+        os.write(reinterpret_cast<const char *>(tags.data()), tags.size() * sizeof(PackedTag));
+        os.write(strings.data(), strings.size());
+        ASSERT(os.good(), "Could not write descriptor store " << tmp_path);
+    }
+    io::rename(tmp_path, save_path);
+}
+
+void DescriptorStore::write(const std::string & path, const std::vector<ImageDescPtr> & descs) {
+    writeStore(path, descs.size(), [&](size_t i) -> const ImageDesc & { return *descs.at(i); });
+}
+
+void DescriptorStore::write(const std::string & path, const std::vector<ImageDesc> & descs) {
+    writeStore(path, descs.size(), [&](size_t i) -> const ImageDesc & { return descs.at(i); });
+}
+
+void DescriptorStore::fromPathFile(const std::string & pathfile, const std::string & extension,
+                                   const std::string & path) {
+    write(path, ImageDesc::fromPathFile(pathfile, extension));
+}
+}
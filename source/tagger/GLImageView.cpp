@@ -0,0 +1,415 @@
+
+#include "GLImageView.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include <QGridLayout>
+#include <QGuiApplication>
+#include <QMouseEvent>
+#include <QOpenGLPixelTransferOptions>
+#include <QSurfaceFormat>
+#include <QWheelEvent>
+
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace {
+
+const char * IMAGE_VERTEX_SHADER = R"(
+#version 330 core
+layout(location = 0) in vec2 corner;
+uniform vec2 canvas_size;
+uniform vec2 offset;
+uniform float scale;
+uniform vec2 image_size;
+out vec2 uv;
+void main() {
+    vec2 pos = (offset + corner * image_size * scale) / canvas_size * 2.0 - 1.0;
+    gl_Position = vec4(pos.x, -pos.y, 0.0, 1.0);
+    uv = corner;
+}
+)";
+
+const char * IMAGE_FRAGMENT_SHADER = R"(
+#version 330 core
+in vec2 uv;
+uniform sampler2D image;
+out vec4 color;
+void main() {
+    float v = texture(image, uv).r;
+    color = vec4(v, v, v, 1.0);
+}
+)";
+
+// One quad per tag, the circle and the cross of Tag::draw are cut out in
+// the fragment shader. All lengths are in image pixels.
+const char * TAG_VERTEX_SHADER = R"(
+#version 330 core
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec2 center;
+layout(location = 2) in float radius;
+layout(location = 3) in vec3 tag_color;
+uniform vec2 canvas_size;
+uniform vec2 offset;
+uniform float scale;
+uniform float pen;
+out vec2 local;
+flat out float tag_radius;
+flat out vec3 frag_color;
+void main() {
+    float extent = radius + max(pen, 0.5 / scale);
+    local = (corner * 2.0 - 1.0) * extent;
+    vec2 pos = (offset + (center + local) * scale) / canvas_size * 2.0 - 1.0;
+    gl_Position = vec4(pos.x, -pos.y, 0.0, 1.0);
+    tag_radius = radius;
+    frag_color = tag_color;
+}
+)";
+
+const char * TAG_FRAGMENT_SHADER = R"(
+#version 330 core
+in vec2 local;
+flat in float tag_radius;
+flat in vec3 frag_color;
+uniform float scale;
+uniform float pen;
+out vec4 color;
+void main() {
+    // at least one pixel wide on the screen
+    float min_width = 0.5 / scale;
+    bool ring = abs(length(local) - tag_radius) <= max(pen, min_width);
+    vec2 a = abs(local);
+    bool cross = a.x <= 3.0 && a.y <= 3.0 && abs(a.x - a.y) <= max(0.5, min_width);
+    if (!ring && !cross) {
+        discard;
+    }
+    color = vec4(frag_color, 1.0);
+}
+)";
+
+// the same pen as Tag::draw
+const float TAG_PEN_HALF_WIDTH = 1.5;
+
+struct TagInstance {
+    GLfloat x, y;
+    GLfloat radius;
+    GLfloat r, g, b;
+};
+
+TagInstance toInstance(const Tag & tag) {
+    const auto & bb = tag.getBoundingBox();
+    TagInstance instance{bb.x + bb.width / 2.f, bb.y + bb.height / 2.f,
+                         bb.width / 2.f, 0, 0, 0};
+    if (tag.isTag()) {
+        instance.g = 1;
+    } else if (tag.isNoTag()) {
+        instance.r = 1;
+    } else if (tag.isExclude()) {
+        instance.r = 1;
+        instance.b = 1;
+    } else if (tag.isBeeWithoutTag()) {
+        instance.g = 1;
+        instance.b = 1;
+    }
+    return instance;
+}
+}
+
+GLImageCanvas::GLImageCanvas(GLImageView * view) :
+    QOpenGLWidget(view),
+    _view(view),
+    _quad_buffer(QOpenGLBuffer::VertexBuffer),
+    _tag_buffer(QOpenGLBuffer::VertexBuffer)
+{
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    setFormat(format);
+    setCursor(Qt::CrossCursor);
+}
+
+GLImageCanvas::~GLImageCanvas() {
+    makeCurrent();
+    _texture.reset();
+    _quad_buffer.destroy();
+    _tag_buffer.destroy();
+    _image_vao.destroy();
+    _tag_vao.destroy();
+    doneCurrent();
+}
+
+void GLImageCanvas::imageChanged() {
+    _image_dirty = true;
+    update();
+}
+
+void GLImageCanvas::tagsChanged() {
+    _tags_dirty = true;
+    update();
+}
+
+void GLImageCanvas::initializeGL() {
+    initializeOpenGLFunctions();
+    ASSERT(_image_program.addShaderFromSourceCode(QOpenGLShader::Vertex, IMAGE_VERTEX_SHADER) &&
+           _image_program.addShaderFromSourceCode(QOpenGLShader::Fragment, IMAGE_FRAGMENT_SHADER) &&
+           _image_program.link(),
+           "Could not compile image shader: " << _image_program.log().toStdString());
+    ASSERT(_tag_program.addShaderFromSourceCode(QOpenGLShader::Vertex, TAG_VERTEX_SHADER) &&
+           _tag_program.addShaderFromSourceCode(QOpenGLShader::Fragment, TAG_FRAGMENT_SHADER) &&
+           _tag_program.link(),
+           "Could not compile tag shader: " << _tag_program.log().toStdString());
+
+    const GLfloat quad[] = {0, 0,  1, 0,  0, 1,  1, 1};
+    _quad_buffer.create();
+    _quad_buffer.bind();
+    _quad_buffer.allocate(quad, sizeof(quad));
+    _tag_buffer.create();
+    _tag_buffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+
+    _image_vao.create();
+    _image_vao.bind();
+    _quad_buffer.bind();
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    _image_vao.release();
+
+    _tag_vao.create();
+    _tag_vao.bind();
+    _quad_buffer.bind();
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    _tag_buffer.bind();
+    const GLsizei stride = sizeof(TagInstance);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void *>(offsetof(TagInstance, x)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void *>(offsetof(TagInstance, radius)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void *>(offsetof(TagInstance, r)));
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribDivisor(3, 1);
+    _tag_vao.release();
+
+    _image_dirty = true;
+    _tags_dirty = true;
+}
+
+void GLImageCanvas::uploadImage() {
+    _texture.reset();
+    const cv::Mat & mat = _view->mat();
+    if (mat.empty()) {
+        return;
+    }
+    ASSERT(mat.type() == CV_8UC1, "Expected a grayscale image");
+    _texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target2D);
+    _texture->setSize(mat.cols, mat.rows);
+    _texture->setFormat(QOpenGLTexture::R8_UNorm);
+    _texture->setMipLevels(_texture->maximumMipLevels());
+    _texture->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::UInt8);
+    QOpenGLPixelTransferOptions options;
+    options.setAlignment(1);
+    options.setRowLength(static_cast<int>(mat.step1()));
+    _texture->setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, mat.data, &options);
+    _texture->generateMipMaps();
+    _texture->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    _texture->setMagnificationFilter(QOpenGLTexture::Nearest);
+    _texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+}
+
+void GLImageCanvas::uploadTags() {
+    std::vector<TagInstance> instances;
+    if (_view->tags()) {
+        instances.reserve(_view->tags()->size());
+        for(const auto & tag : *_view->tags()) {
+            instances.push_back(toInstance(tag));
+        }
+    }
+    _nb_tags = static_cast<int>(instances.size());
+    _tag_buffer.bind();
+    _tag_buffer.allocate(instances.data(), static_cast<int>(instances.size() * sizeof(TagInstance)));
+    _tag_buffer.release();
+}
+
+void GLImageCanvas::resizeGL(int, int) {
+    _view->updateScrollBars();
+}
+
+void GLImageCanvas::paintGL() {
+    if (_image_dirty) {
+        uploadImage();
+        _image_dirty = false;
+    }
+    if (_tags_dirty) {
+        uploadTags();
+        _tags_dirty = false;
+    }
+    glClearColor(0.3f, 0.3f, 0.3f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (!_texture) {
+        return;
+    }
+    const QPointF offset = _view->offset();
+    const float scale = static_cast<float>(_view->scale());
+    auto setTransform = [&](QOpenGLShaderProgram & program) {
+        program.setUniformValue("canvas_size", QVector2D(width(), height()));
+        program.setUniformValue("offset", QVector2D(offset));
+        program.setUniformValue("scale", scale);
+    };
+
+    _image_program.bind();
+    setTransform(_image_program);
+    _image_program.setUniformValue("image_size", QVector2D(_view->mat().cols, _view->mat().rows));
+    _image_program.setUniformValue("image", 0);
+    _texture->bind(0);
+    _image_vao.bind();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    _image_vao.release();
+    _texture->release();
+    _image_program.release();
+
+    if (_nb_tags > 0) {
+        _tag_program.bind();
+        setTransform(_tag_program);
+        _tag_program.setUniformValue("pen", TAG_PEN_HALF_WIDTH);
+        _tag_vao.bind();
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _nb_tags);
+        _tag_vao.release();
+        _tag_program.release();
+    }
+}
+
+void GLImageCanvas::mousePressEvent(QMouseEvent * event) {
+    _view->mousePressed(event);
+}
+
+void GLImageCanvas::wheelEvent(QWheelEvent * event) {
+    if (event->angleDelta().y() > 0) {
+        _view->zoom(1.25, event->pos());
+    } else if (event->angleDelta().y() < 0) {
+        _view->zoom(0.8, event->pos());
+    }
+}
+
+GLImageView::GLImageView(QWidget * parent) :
+    QWidget(parent),
+    _canvas(new GLImageCanvas(this)),
+    _horz(new QScrollBar(Qt::Horizontal, this)),
+    _vert(new QScrollBar(Qt::Vertical, this))
+{
+    auto layout = new QGridLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addWidget(_canvas, 0, 0);
+    layout->addWidget(_vert, 0, 1);
+    layout->addWidget(_horz, 1, 0);
+    _horz->setSingleStep(20);
+    _vert->setSingleStep(20);
+    connect(_horz, &QScrollBar::valueChanged, _canvas, [this]() { _canvas->update(); });
+    connect(_vert, &QScrollBar::valueChanged, _canvas, [this]() { _canvas->update(); });
+}
+
+void GLImageView::setTags(cv::Mat mat, std::vector<Tag> * tags) {
+    _mat = mat;
+    _tags = tags;
+    reindexTags();
+    updateScrollBars();
+    _canvas->imageChanged();
+}
+
+void GLImageView::reindexTags() {
+    _tag_grid.clear();
+    if (_tags) {
+        _tag_grid.insert(*_tags);
+    }
+    _canvas->tagsChanged();
+}
+
+QPointF GLImageView::offset() const {
+    // centered like the QScrollArea of WholeImageWidget if the image is smaller
+    const double width = _mat.cols * _scale;
+    const double height = _mat.rows * _scale;
+    return QPointF(width < _canvas->width() ? (_canvas->width() - width) / 2 : -_horz->value(),
+                   height < _canvas->height() ? (_canvas->height() - height) / 2 : -_vert->value());
+}
+
+QPointF GLImageView::toImage(const QPoint & canvas_pos) const {
+    return (QPointF(canvas_pos) - offset()) / _scale;
+}
+
+void GLImageView::updateScrollBars() {
+    const int width = static_cast<int>(_mat.cols * _scale);
+    const int height = static_cast<int>(_mat.rows * _scale);
+    _horz->setRange(0, std::max(0, width - _canvas->width()));
+    _vert->setRange(0, std::max(0, height - _canvas->height()));
+    _horz->setPageStep(_canvas->width());
+    _vert->setPageStep(_canvas->height());
+}
+
+void GLImageView::setZoomFactor(double factor) {
+    zoom(factor / _scale, _canvas->rect().center());
+}
+
+void GLImageView::zoom(double factor, QPoint canvas_pos) {
+    if(_scale > MAX_SCALE && factor > 1) return;
+    if(_scale < MIN_SCALE && factor < 1) return;
+    // keep the image point under canvas_pos fixed
+    const QPointF image_pos = toImage(canvas_pos);
+    _scale *= factor;
+    updateScrollBars();
+    _horz->setValue(static_cast<int>(image_pos.x() * _scale - canvas_pos.x()));
+    _vert->setValue(static_cast<int>(image_pos.y() * _scale - canvas_pos.y()));
+    _canvas->update();
+}
+
+void GLImageView::zoomIn() {
+    zoom(1.25, _canvas->rect().center());
+}
+
+void GLImageView::zoomOut() {
+    zoom(0.8, _canvas->rect().center());
+}
+
+boost::optional<Tag> GLImageView::createTag(int x, int y) const {
+    if(x < TAG_WIDTH / 2 || y < TAG_HEIGHT / 2 ||
+       x > _mat.cols - TAG_WIDTH / 2 || y > _mat.rows - TAG_HEIGHT / 2) {
+        return boost::optional<Tag>();
+    }
+    return Tag(cv::Rect(x - TAG_WIDTH / 2, y - TAG_HEIGHT / 2, TAG_WIDTH, TAG_HEIGHT));
+}
+
+void GLImageView::mousePressed(QMouseEvent * event) {
+    if (!_tags) {
+        return;
+    }
+    const QPointF pos = toImage(event->pos());
+    const int x = static_cast<int>(pos.x());
+    const int y = static_cast<int>(pos.y());
+    if (const Tag * hit = _tag_grid.find(x, y)) {
+        const unsigned long id = hit->id();
+        _tag_grid.erase(id);
+        _tags->erase(std::remove_if(_tags->begin(), _tags->end(),
+                                    [id](const Tag & t) { return t.id() == id; }),
+                     _tags->end());
+    } else {
+        auto modifier = QGuiApplication::queryKeyboardModifiers();
+        boost::optional<Tag> opt_tag = createTag(x, y);
+        if(!opt_tag) return;
+        Tag & tag = opt_tag.get();
+        if (modifier.testFlag(Qt::ControlModifier)) {
+            tag.setType(TagType::Exclude);
+        } else if (modifier.testFlag(Qt::AltModifier)) {
+            tag.setType(TagType::BeeWithoutTag);
+        }
+        _tags->push_back(tag);
+        _tag_grid.insert(tag);
+    }
+    emit changed();
+    _canvas->tagsChanged();
+}
+}
@@ -1,11 +1,19 @@
 
+#include <fstream>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#ifdef DEEPLOCALIZER_USE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 
 #include "Image.h"
+#include "DescriptorJson.h"
+#include "Stats.h"
 #include "Tag.h"
 #include "utils.h"
 #include "qt_helper.h"
@@ -20,12 +28,12 @@ ImageDesc::ImageDesc() {
 
 }
 
-ImageDesc::ImageDesc(const std::string _filename) : filename(_filename) {
+ImageDesc::ImageDesc(std::string _filename) : filename(std::move(_filename)) {
 
 }
 
-ImageDesc::ImageDesc(const std::string _filename, std::vector<Tag> _tags) :
-        filename(_filename), tags(_tags) {
+ImageDesc::ImageDesc(std::string _filename, std::vector<Tag> _tags) :
+        filename(std::move(_filename)), tags(std::move(_tags)) {
 
 }
 
@@ -41,15 +49,19 @@ QPixmap ImageDesc::visualise_tags() {
 }
 
 void ImageDesc::addTag(Tag && tag) {
-    this->tags.emplace_back(tag);
+    this->tags.push_back(std::move(tag));
 }
 
-void ImageDesc::addTag(Tag tag) {
-    this->tags.emplace_back(std::move(tag));
+void ImageDesc::addTag(const Tag & tag) {
+    this->tags.push_back(tag);
 }
 
 
 void ImageDesc::setTags(std::vector<Tag> && tags) {
+    this->tags = std::move(tags);
+}
+
+void ImageDesc::setTags(const std::vector<Tag> & tags) {
     this->tags = tags;
 }
 
@@ -61,51 +73,55 @@ bool ImageDesc::operator==(const ImageDesc & other) const {
 
 std::vector<ImageDescPtr> ImageDesc::fromPathFilePtr(const std::string &path,
                                                const std::string & image_desc_extension) {
-    auto image_descs = fromPathFile(path, image_desc_extension);
-    std::vector<ImageDescPtr> image_desc_ptrs;
-    for(auto & desc : image_descs) {
-        image_desc_ptrs.emplace_back(std::make_shared<ImageDesc>(std::move(desc)));
-    }
-    return image_desc_ptrs;
+    return fromPathsPtr(readPathFile(path), image_desc_extension);
 }
 
 std::vector<ImageDesc> ImageDesc::fromPathFile(const std::string &path,
                                                const std::string & image_desc_extension) {
+    return fromPaths(readPathFile(path), image_desc_extension);
+}
+
+std::vector<std::string> ImageDesc::readPathFile(const std::string &path) {
     const io::path pathfile(path);
     ASSERT(io::exists(pathfile), "File " << pathfile << " does not exists.");
     ifstream ifs{pathfile.string()};
     std::string path_to_image;
     std::vector<std::string> paths;
-    for(int i = 0; std::getline(ifs, path_to_image); i++) {
-        ASSERT(io::exists(path_to_image), "File " << path_to_image << " does not exists.");
+    while(std::getline(ifs, path_to_image)) {
         paths.push_back(path_to_image);
     }
-    return fromPaths(paths, image_desc_extension);
+    return paths;
 }
 
-std::vector<ImageDescPtr> ImageDesc::fromPathsPtr(const std::vector<std::string> paths,
-                                                  const std::string & image_desc_extension) {
-    auto image_descs = fromPaths(paths, image_desc_extension);
-    std::vector<ImageDescPtr> image_desc_ptrs;
-    for(auto & desc : image_descs) {
-        image_desc_ptrs.emplace_back(std::make_shared<ImageDesc>(std::move(desc)));
+ImageDescPtr ImageDesc::loadForImage(const std::string &path,
+                                     const std::string & image_desc_extension) {
+    ASSERT(io::exists(path), "File " << path << " does not exists.");
+    auto desc = std::make_shared<ImageDesc>(path);
+    desc->setSavePathExtension(image_desc_extension);
+    if(io::exists(desc->savePath())) {
+        desc = ImageDesc::load(desc->savePath());
+        desc->filename = path;
+        desc->setSavePathExtension(image_desc_extension);
     }
-    return image_desc_ptrs;
+    return desc;
+}
+
+std::vector<ImageDescPtr> ImageDesc::fromPathsPtr(const std::vector<std::string> & paths,
+                                                  const std::string & image_desc_extension) {
+    std::vector<ImageDescPtr> descs(paths.size());
+    // mostly waiting for the filesystem, therefore more threads than cores
+    parallelFor(paths.size(), 4*defaultNbThreads(), [&](size_t i) {
+        descs.at(i) = loadForImage(paths.at(i), image_desc_extension);
+    }, 16);
+    return descs;
 }
 
-std::vector<ImageDesc> ImageDesc::fromPaths(const std::vector<std::string> paths,
+std::vector<ImageDesc> ImageDesc::fromPaths(const std::vector<std::string> & paths,
                                             const std::string & image_desc_extension) {
-    std::vector<ImageDesc> descs;
-    for(auto & path: paths) {
-        ASSERT(io::exists(path), "File " << path << " does not exists.");
-        auto desc = ImageDesc(path);
-        desc.setSavePathExtension(image_desc_extension);
-        if(io::exists(desc.savePath())) {
-            desc = *ImageDesc::load(desc.savePath());
-            desc.filename = path;
-        }
-        descs.push_back(desc);
-    }
+    std::vector<ImageDesc> descs(paths.size());
+    parallelFor(paths.size(), 4*defaultNbThreads(), [&](size_t i) {
+        descs.at(i) = std::move(*loadForImage(paths.at(i), image_desc_extension));
+    }, 16);
     return descs;
 }
 
@@ -122,14 +138,11 @@ void ImageDesc::save() {
     save(savePath());
 }
 void ImageDesc::save(const std::string & path) {
-    safe_serialization(path, this->to_json());
+    descriptor_json::save(path, *this);
 }
 
 ImageDescPtr ImageDesc::load(const std::string & path) {
-    std::ifstream is(path);
-    nlohmann::json json_desc;
-    is >>  json_desc;
-    return std::make_shared<ImageDesc>(ImageDesc::from_json(json_desc));
+    return std::make_shared<ImageDesc>(descriptor_json::load(path));
 }
 
 Image::Image() {
@@ -137,7 +150,114 @@ Image::Image() {
 
 Image::Image(const ImageDesc & descr) : _filename(descr.filename)  {
     ASSERT(io::exists(_filename), "Cannot open file: " << _filename);
+    stats::ScopedTimer timer(stats::Metric::Decode);
     _mat = cv::imread(_filename, cv::IMREAD_GRAYSCALE);
+    timer.setBytes(_mat.total());
+}
+
+Image::Image(const ImageDesc & descr, const DecodeOptions & opt) : _filename(descr.filename) {
+    ASSERT(io::exists(_filename), "Cannot open file: " << _filename);
+    _mat = decode(readFile(_filename), opt);
+}
+
+Image::Image(std::string filename, cv::Mat mat) :
+    _mat(std::move(mat)), _filename(std::move(filename))
+{
+}
+
+namespace {
+
+int reducedFlag(int reduction) {
+    switch (reduction) {
+        case 1:
+            return cv::IMREAD_GRAYSCALE;
+        case 2:
+            return cv::IMREAD_REDUCED_GRAYSCALE_2;
+        case 4:
+            return cv::IMREAD_REDUCED_GRAYSCALE_4;
+        case 8:
+            return cv::IMREAD_REDUCED_GRAYSCALE_8;
+        default:
+            ASSERT(false, "The reduction must be 1, 2, 4 or 8. But got: " << reduction);
+            return cv::IMREAD_GRAYSCALE;
+    }
+}
+
+bool isJPEG(const uchar * data, size_t size) {
+    return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+#ifdef DEEPLOCALIZER_USE_TURBOJPEG
+struct TurboJPEGHandle {
+    tjhandle handle = tjInitDecompress();
+    ~TurboJPEGHandle() {
+        tjDestroy(handle);
+    }
+};
+
+cv::Mat decodeTurboJPEG(const uchar * data, size_t size, int reduction) {
+    // creating a handle allocates, so every thread keeps its own
+    static thread_local TurboJPEGHandle tj;
+    int width, height, subsampling, colorspace;
+    if (tjDecompressHeader3(tj.handle, data, static_cast<unsigned long>(size),
+                            &width, &height, &subsampling, &colorspace) != 0) {
+        return cv::Mat();
+    }
+    const tjscalingfactor factor{1, reduction};
+    const int scaled_width = TJSCALED(width, factor);
+    const int scaled_height = TJSCALED(height, factor);
+    cv::Mat mat(scaled_height, scaled_width, CV_8U);
+    if (tjDecompress2(tj.handle, data, static_cast<unsigned long>(size), mat.data,
+                      scaled_width, static_cast<int>(mat.step), scaled_height,
+                      TJPF_GRAY, 0) != 0) {
+        return cv::Mat();
+    }
+    return mat;
+}
+#endif
+}
+
+cv::Mat Image::decode(const uchar * data, size_t size, const DecodeOptions & opt) {
+    const int flag = reducedFlag(opt.reduction);
+    if (size == 0) {
+        return cv::Mat();
+    }
+    stats::ScopedTimer timer(stats::Metric::Decode, size);
+#ifdef DEEPLOCALIZER_USE_TURBOJPEG
+    if (opt.use_turbojpeg && isJPEG(data, size)) {
+        cv::Mat mat = decodeTurboJPEG(data, size, opt.reduction);
+        if (!mat.empty()) {
+            return mat;
+        }
+    }
+#endif
+    // OpenCV scales JPEGs in the DCT domain and resizes the other formats
+    const cv::Mat buffer(1, static_cast<int>(size), CV_8U, const_cast<uchar *>(data));
+    return cv::imdecode(buffer, flag);
+}
+
+cv::Mat Image::decode(const std::vector<uchar> & buffer, const DecodeOptions & opt) {
+    return decode(buffer.data(), buffer.size(), opt);
+}
+
+std::vector<uchar> Image::readFile(const std::string & path) {
+    stats::ScopedTimer timer(stats::Metric::Read);
+    std::ifstream is(path, std::ios::binary);
+    ASSERT(is.good(), "Cannot open file: " << path);
+    is.seekg(0, std::ios::end);
+    std::vector<uchar> buffer(static_cast<size_t>(is.tellg()));
+    is.seekg(0, std::ios::beg);
+    is.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+    timer.setBytes(buffer.size());
+    return buffer;
+}
+
+bool Image::hasTurboJPEG() {
+#ifdef DEEPLOCALIZER_USE_TURBOJPEG
+    return true;
+#else
+    return false;
+#endif
 }
 
 
@@ -153,7 +273,20 @@ bool Image::write(const io::path & path, boost::optional<std::pair<int, int>> co
         compress_vec.push_back(std::get<0>(compression.get()));
         compress_vec.push_back(std::get<1>(compression.get()));
     }
-    return cv::imwrite(p.string(), _mat, compress_vec);
+    // encoded and written separately to tell CPU from I/O time apart
+    std::vector<uchar> buffer;
+    {
+        stats::ScopedTimer timer(stats::Metric::Encode, _mat.total());
+        if (!cv::imencode(p.extension().string(), _mat, buffer, compress_vec)) {
+            return false;
+        }
+    }
+    stats::ScopedTimer timer(stats::Metric::Write, buffer.size());
+    std::ofstream os(p.string(), std::ios::binary);
+    os.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    // the data may only reach the disk when the stream is closed, e.g. ENOSPC
+    os.close();
+    return os.good();
 }
 
 bool Image::operator==(const Image &other) const {
@@ -185,11 +318,13 @@ json ImageDesc::to_json() const {
 }
 
 ImageDesc ImageDesc::from_json(const json &j) {
+    const json & jtags = j["tags"];
     std::vector<Tag> tags;
-    for(const auto & jtag : j["tags"]) {
+    tags.reserve(jtags.size());
+    for(const auto & jtag : jtags) {
         tags.push_back(Tag::from_json((jtag)));
     }
-    return ImageDesc(j["filename"], tags);
+    return ImageDesc(j["filename"], std::move(tags));
 }
 
 }
@@ -0,0 +1,172 @@
+
+#include "ImageCache.h"
+
+#include <algorithm>
+
+#include <QDebug>
+
+namespace deeplocalizer {
+
+ImageCache::ImageCache(size_t max_bytes) :
+    _max_bytes(max_bytes),
+    _worker(&ImageCache::workerLoop, this)
+{
+}
+
+ImageCache::~ImageCache() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _pending.clear();
+    }
+    _work.notify_all();
+    _worker.join();
+}
+
+ImagePtr ImageCache::get(const std::string & filename) {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _decoded.wait(lock, [&]() { return _in_flight != filename; });
+        auto error = _errors.find(filename);
+        if (error != _errors.end()) {
+            std::exception_ptr e = error->second;
+            _errors.erase(error);
+            std::rethrow_exception(e);
+        }
+        auto image = lookup(filename);
+        if (image) {
+            return image;
+        }
+        // no need to decode it twice
+        _pending.erase(std::remove(_pending.begin(), _pending.end(), filename),
+                       _pending.end());
+    }
+    auto image = std::make_shared<Image>(ImageDesc(filename));
+    std::lock_guard<std::mutex> lock(_mutex);
+    insert(filename, image);
+    return image;
+}
+
+ImagePtr ImageCache::tryGet(const std::string & filename) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return lookup(filename);
+}
+
+void ImageCache::prefetch(std::vector<std::string> filenames) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending.clear();
+        for(auto & filename : filenames) {
+            if (!_index.count(filename) && filename != _in_flight) {
+                _pending.push_back(std::move(filename));
+            }
+        }
+    }
+    _work.notify_one();
+}
+
+void ImageCache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending.clear();
+    _errors.clear();
+    _lru.clear();
+    _index.clear();
+    _bytes = 0;
+}
+
+size_t ImageCache::size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _lru.size();
+}
+
+size_t ImageCache::bytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bytes;
+}
+
+size_t ImageCache::maxBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _max_bytes;
+}
+
+void ImageCache::setMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_bytes = max_bytes;
+    evict();
+}
+
+void ImageCache::workerLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true) {
+        _work.wait(lock, [this]() { return _stop || !_pending.empty(); });
+        if (_stop) {
+            return;
+        }
+        _in_flight = std::move(_pending.front());
+        _pending.pop_front();
+        if (_index.count(_in_flight)) {
+            _in_flight.clear();
+            continue;
+        }
+        _errors.erase(_in_flight);
+        lock.unlock();
+        ImagePtr image;
+        // e.g. a cv::Exception of a corrupt file or a std::bad_alloc must
+        // not terminate the tagger, get() rethrows it on the GUI thread
+        std::exception_ptr error;
+        try {
+            image = std::make_shared<Image>(ImageDesc(_in_flight));
+        } catch(const std::string & msg) {
+            qWarning() << "[ImageCache] " << QString::fromStdString(msg);
+            error = std::current_exception();
+        } catch(const std::exception & e) {
+            qWarning() << "[ImageCache] " << e.what();
+            error = std::current_exception();
+        } catch(...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        if (image) {
+            insert(_in_flight, image);
+        } else if (error) {
+            _errors[_in_flight] = error;
+        }
+        _in_flight.clear();
+        _decoded.notify_all();
+    }
+}
+
+ImagePtr ImageCache::lookup(const std::string & filename) {
+    auto it = _index.find(filename);
+    if (it == _index.end()) {
+        return nullptr;
+    }
+    _lru.splice(_lru.begin(), _lru, it->second);
+    return it->second->second;
+}
+
+void ImageCache::insert(const std::string & filename, ImagePtr image) {
+    if (_index.count(filename)) {
+        lookup(filename);
+        return;
+    }
+    _bytes += imageBytes(*image);
+    _lru.emplace_front(filename, std::move(image));
+    _index[filename] = _lru.begin();
+    evict();
+}
+
+void ImageCache::evict() {
+    // always keep the most recently used image
+    while(_bytes > _max_bytes && _lru.size() > 1) {
+        _bytes -= imageBytes(*_lru.back().second);
+        _index.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+}
+
+size_t ImageCache::imageBytes(const Image & image) {
+    const cv::Mat & mat = image.getCvMat();
+    return mat.total() * mat.elemSize();
+}
+}
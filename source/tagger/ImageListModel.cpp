@@ -0,0 +1,101 @@
+
+#include "ImageListModel.h"
+
+#include "qt_helper.h"
+
+namespace deeplocalizer {
+
+ImageListModel::ImageListModel(const ManuallyTagger & tagger, QObject * parent) :
+    QAbstractListModel(parent),
+    _tagger(tagger),
+    _pixmaps(MAX_PIXMAPS)
+{
+    // the thumbnails arrive on the worker thread of the cache
+    connect(this, &ImageListModel::thumbnailLoaded,
+            this, &ImageListModel::insertThumbnail, Qt::QueuedConnection);
+}
+
+ImageListModel::~ImageListModel() {
+    // waits for a callback that emits on this model right now
+    if (_thumbnails) {
+        _thumbnails->setCallback(nullptr);
+    }
+}
+
+int ImageListModel::rowCount(const QModelIndex & parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(_tagger.getImageDescs().size());
+}
+
+QVariant ImageListModel::data(const QModelIndex & index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+    const int row = index.row();
+    const std::string & filename = _tagger.getImageDescs().at(row)->filename;
+    if (role == Qt::DisplayRole) {
+        QString check;
+        if (_tagger.isDone(row)) {
+            check = "\u2713  ";
+        }
+        return "#" + QString::number(row + 1) + ":   " + check +
+               QString::fromStdString(filename);
+    }
+    if (role == Qt::DecorationRole && _thumbnails) {
+        if (QPixmap * pixmap = _pixmaps.object(row)) {
+            return *pixmap;
+        }
+        if (_requested.emplace(filename, row).second) {
+            _thumbnails->request(filename);
+        }
+    }
+    return QVariant();
+}
+
+void ImageListModel::setThumbnailCache(ThumbnailCache * cache) {
+    if (_thumbnails) {
+        _thumbnails->setCallback(nullptr);
+    }
+    _thumbnails = cache;
+    _pixmaps.clear();
+    _requested.clear();
+    if (_thumbnails) {
+        _thumbnails->setCallback([this](const std::string & filename, const cv::Mat & thumbnail) {
+            // the image of cvMatToQImage shares the data of the matrix
+            emit thumbnailLoaded(QString::fromStdString(filename),
+                                 cvMatToQImage(thumbnail).copy());
+        });
+    }
+    allChanged();
+}
+
+void ImageListModel::imageChanged(unsigned long idx) {
+    if (idx >= _tagger.getImageDescs().size()) {
+        return;
+    }
+    const QModelIndex changed = index(static_cast<int>(idx));
+    emit dataChanged(changed, changed);
+}
+
+void ImageListModel::allChanged() {
+    if (rowCount() == 0) {
+        return;
+    }
+    emit dataChanged(index(0), index(rowCount() - 1));
+}
+
+void ImageListModel::insertThumbnail(QString filename, QImage thumbnail) {
+    // the row may have been requested before setThumbnailCache cleared it
+    auto it = _requested.find(filename.toStdString());
+    if (it == _requested.end()) {
+        return;
+    }
+    const int row = it->second;
+    _requested.erase(it);
+    _pixmaps.insert(row, new QPixmap(QPixmap::fromImage(thumbnail)));
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, {Qt::DecorationRole});
+}
+}
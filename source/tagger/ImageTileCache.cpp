@@ -0,0 +1,111 @@
+
+#include "ImageTileCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "qt_helper.h"
+
+namespace deeplocalizer {
+
+const int ImageTileCache::TILE_SIZE;
+const size_t ImageTileCache::DEFAULT_MAX_TILES;
+
+ImageTileCache::ImageTileCache(size_t max_tiles) :
+    _max_tiles(std::max<size_t>(max_tiles, 1))
+{
+}
+
+void ImageTileCache::setImage(const cv::Mat & mat) {
+    clear();
+    _pyramid.clear();
+    if (mat.empty()) {
+        return;
+    }
+    _pyramid.push_back(mat);
+    while(_pyramid.back().cols > TILE_SIZE && _pyramid.back().rows > TILE_SIZE) {
+        cv::Mat down;
+        cv::pyrDown(_pyramid.back(), down);
+        _pyramid.push_back(down);
+    }
+}
+
+void ImageTileCache::clear() {
+    _lru.clear();
+    _index.clear();
+}
+
+QSize ImageTileCache::scaledSize(double scale) const {
+    if (_pyramid.empty()) {
+        return QSize();
+    }
+    return QSize(int(_pyramid.front().cols*scale), int(_pyramid.front().rows*scale));
+}
+
+size_t ImageTileCache::levelForScale(double scale) const {
+    if (_pyramid.empty() || scale >= 1) {
+        return 0;
+    }
+    // level i is downscaled by 2^i. Never render from a level smaller than the output
+    size_t level = static_cast<size_t>(std::floor(std::log2(1 / scale)));
+    return std::min(level, _pyramid.size() - 1);
+}
+
+cv::Mat ImageTileCache::renderTile(double scale, int tile_x, int tile_y) const {
+    const cv::Mat & src = _pyramid.at(levelForScale(scale));
+    const QSize size = scaledSize(scale);
+    const int width = std::min(TILE_SIZE, size.width() - tile_x*TILE_SIZE);
+    const int height = std::min(TILE_SIZE, size.height() - tile_y*TILE_SIZE);
+    cv::Mat tile;
+    if (width <= 0 || height <= 0) {
+        return tile;
+    }
+    // level pixels to tile pixels, mapping pixel centers onto pixel centers.
+    // The same mapping for all tiles avoids seams.
+    const double fx = scale * _pyramid.front().cols / src.cols;
+    const double fy = scale * _pyramid.front().rows / src.rows;
+    cv::Mat transform = (cv::Mat_<double>(2, 3) <<
+            fx, 0, 0.5*(fx - 1) - tile_x*TILE_SIZE,
+            0, fy, 0.5*(fy - 1) - tile_y*TILE_SIZE);
+    cv::warpAffine(src, tile, transform, cv::Size(width, height),
+                   fx > 1 ? cv::INTER_NEAREST : cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    return tile;
+}
+
+const QPixmap & ImageTileCache::tile(double scale, int tile_x, int tile_y) {
+    key_t key{scale, tile_x, tile_y};
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return it->second->second;
+    }
+    _lru.emplace_front(key, cvMatToQPixmap(renderTile(scale, tile_x, tile_y)));
+    _index[key] = _lru.begin();
+    while(_lru.size() > _max_tiles) {
+        _index.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+    return _lru.front().second;
+}
+
+void ImageTileCache::draw(QPainter & painter, const QRect & exposed, double scale) {
+    if (_pyramid.empty()) {
+        return;
+    }
+    QRect visible = exposed.intersected(QRect(QPoint(0, 0), scaledSize(scale)));
+    if (visible.isEmpty()) {
+        return;
+    }
+    const int first_x = visible.left() / TILE_SIZE;
+    const int first_y = visible.top() / TILE_SIZE;
+    const int last_x = visible.right() / TILE_SIZE;
+    const int last_y = visible.bottom() / TILE_SIZE;
+    for(int y = first_y; y <= last_y; y++) {
+        for(int x = first_x; x <= last_x; x++) {
+            painter.drawPixmap(x*TILE_SIZE, y*TILE_SIZE, tile(scale, x, y));
+        }
+    }
+}
+}
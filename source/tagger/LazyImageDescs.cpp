@@ -0,0 +1,41 @@
+#include "LazyImageDescs.h"
+
+#include "utils.h"
+
+namespace deeplocalizer {
+
+LazyImageDescs::LazyImageDescs(std::vector<std::string> paths, std::string image_desc_extension) :
+    _paths(std::move(paths)),
+    _extension(std::move(image_desc_extension)),
+    _descs(_paths.size()),
+    _loaded(new std::once_flag[_paths.size()])
+{ }
+
+LazyImageDescs LazyImageDescs::fromPathFile(const std::string & pathfile,
+                                            const std::string & image_desc_extension) {
+    return LazyImageDescs(ImageDesc::readPathFile(pathfile), image_desc_extension);
+}
+
+ImageDescPtr LazyImageDescs::at(size_t idx) const {
+    ASSERT(idx < size(), "Index " << idx << " exceeds size " << size());
+    std::call_once(_loaded[idx], [this, idx]() {
+        _descs.at(idx) = ImageDesc::loadForImage(_paths.at(idx), _extension);
+    });
+    return _descs.at(idx);
+}
+
+void LazyImageDescs::prefetch(size_t begin, size_t end) const {
+    end = std::min(end, size());
+    if (begin >= end) {
+        return;
+    }
+    parallelFor(end - begin, 4*defaultNbThreads(), [&](size_t i) {
+        at(begin + i);
+    }, 16);
+}
+
+std::vector<ImageDescPtr> LazyImageDescs::loadAll() const {
+    prefetch(0, size());
+    return _descs;
+}
+}
@@ -1,11 +1,18 @@
 
 #include "ManuallyTagger.h"
 
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
 #include <QDebug>
 #include <boost/archive/xml_oarchive.hpp>
 #include <boost/archive/xml_iarchive.hpp>
 
 #include "utils.h"
+#include "DescriptorJson.h"
+#include "ProgressJournal.h"
+#include "ProgressFile.h"
+#include "DescriptorStore.h"
 #include "qt_helper.h"
 
 namespace deeplocalizer {
@@ -17,6 +24,8 @@ namespace io = boost::filesystem;
 
 const std::string ManuallyTagger::IMAGE_DESC_EXT = "tagger.json";
 const std::string ManuallyTagger::DEFAULT_SAVE_PATH = "tagger_progress.json";
+const std::string ManuallyTagger::COMPACT_SAVE_PATH = "tagger_progress.bin";
+const size_t ManuallyTagger::DEFAULT_PREFETCH_DEPTH;
 
 
 ManuallyTagger::ManuallyTagger() {
@@ -53,64 +62,195 @@ ManuallyTagger::ManuallyTagger(std::vector<ImageDescPtr> && descriptions,
 
 void ManuallyTagger::init() {
     if(_loaded_from_serialization) {
-        _image_descs = ImageDesc::fromPathsPtr(_image_paths, IMAGE_DESC_EXT);
+        // the saved descriptions are loaded below
+        _image_descs.clear();
+        if (!_store_path.empty()) {
+            // the images that are not tagged yet keep the tags of the store
+            DescriptorStore store(_store_path);
+            ASSERT(_store_indices.size() == _image_paths.size(),
+                   "Expected one descriptor store index per image");
+            for(uint32_t idx : _store_indices) {
+                ASSERT(idx < store.size(), "Image " << idx << " is not in the descriptor store "
+                       << _store_path);
+                _image_descs.push_back(std::make_shared<ImageDesc>(store.imageDesc(idx)));
+            }
+        } else {
+            for(const auto & path : _image_paths) {
+                _image_descs.push_back(std::make_shared<ImageDesc>(path));
+            }
+        }
     }
     _image_paths.clear();
-    for(auto & descr : _image_descs) {
+    const size_t n = _image_descs.size();
+    // the serialized done flags are only valid for the same list of images
+    if (_done_tagging.size() != n) {
+        _done_tagging = std::vector<bool>(n, false);
+    }
+    // mostly waiting for the filesystem, therefore more threads than cores
+    const size_t nb_threads = 4*defaultNbThreads();
+    // the only pass that stats the *.tagger.json files
+    std::vector<char> has_saved_desc(n, false);
+    parallelFor(n, nb_threads, [&](size_t i) {
+        auto & descr = _image_descs.at(i);
         ASSERT(io::exists(descr->filename),
                "Could not open file " << descr->filename);
         descr->setSavePathExtension(IMAGE_DESC_EXT);
-    }
+        has_saved_desc.at(i) = io::exists(descr->savePath());
+    }, 16);
     // sort images that are allready done to the begining
-    std::sort(_image_descs.begin(), _image_descs.end(),
-              [this](const ImageDescPtr &d1, const ImageDescPtr &d2){
-                    return isDone(*d1) > isDone(*d2);
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_partition(order.begin(), order.end(), [&](size_t i) {
+        return has_saved_desc.at(i) || _done_tagging.at(i);
     });
-    for(auto & descr : _image_descs) {
-        if (io::exists(descr->savePath())) {
+    std::vector<ImageDescPtr> descs;
+    std::vector<bool> done;
+    std::vector<char> has_saved;
+    descs.reserve(n);
+    done.reserve(n);
+    has_saved.reserve(n);
+    for(size_t i : order) {
+        descs.push_back(std::move(_image_descs.at(i)));
+        done.push_back(has_saved_desc.at(i) || _done_tagging.at(i));
+        has_saved.push_back(has_saved_desc.at(i));
+    }
+    _image_descs = std::move(descs);
+    _done_tagging = std::move(done);
+    parallelFor(n, nb_threads, [&](size_t i) {
+        auto & descr = _image_descs.at(i);
+        if (has_saved.at(i)) {
             descr = ImageDesc::load(descr->savePath());
         } else {
-            descr->setSavePathExtension(".proposal.json");
+            descr->setSavePathExtension("proposal.json");
             if (io::exists(descr->savePath())) {
                 descr = ImageDesc::load(descr->savePath());
             }
         }
         descr->setSavePathExtension(IMAGE_DESC_EXT);
+    }, 16);
+    for(auto & descr : _image_descs) {
         _image_paths.push_back(descr->filename);
     }
-    if (_image_descs.size() != _done_tagging.size()) {
-        _done_tagging = std::vector<bool>(_image_descs.size(), false);
-        _n_done = 0;
-    } else {
-        _n_done = std::count(_done_tagging.cbegin(), _done_tagging.cend(), true);
+    _n_done = std::count(_done_tagging.cbegin(), _done_tagging.cend(), true);
+}
+
+void ManuallyTagger::refreshDoneState() {
+    std::vector<char> has_saved_desc(_image_descs.size(), false);
+    parallelFor(_image_descs.size(), 4*defaultNbThreads(), [&](size_t i) {
+        has_saved_desc.at(i) = io::exists(_image_descs.at(i)->savePath());
+    }, 16);
+    for(size_t i = 0; i < _image_descs.size(); i++) {
+        if (has_saved_desc.at(i)) {
+            _done_tagging.at(i) = true;
+        }
     }
+    _n_done = std::count(_done_tagging.cbegin(), _done_tagging.cend(), true);
+    emit progress(static_cast<double>(_n_done)/_image_descs.size());
+}
+
+void ManuallyTagger::scheduleSave(const ImageDesc & desc) const {
+    const std::string path = desc.savePath();
+    const ImageDesc snapshot(desc.filename, desc.getTags());
+    _writer->schedule(path, [path, snapshot]() {
+        descriptor_json::save(path, snapshot);
+    });
 }
 
 void ManuallyTagger::save(bool all_descs) const {
-    save(savePath());
     if (all_descs) {
         for(auto & desc: _image_descs) {
-            desc->save();
+            scheduleSave(*desc);
         }
-    } else {
-        _image_descs.at(_image_idx)->save();
+    } else if (_image_idx < _image_descs.size()) {
+        scheduleSave(*_image_descs.at(_image_idx));
     }
-
+    if (_progress_written && _journal_seq - _compacted_seq < COMPACT_EVERY) {
+        return;
+    }
+    const std::string path = savePath();
+    const Progress progress = toProgress();
+    const uint64_t seq = _journal_seq;
+    _writer->schedule(path, [path, progress, seq]() {
+        progress_file::write(path, progress);
+        journal::compact(journal::pathFor(path), seq);
+    });
+    _compacted_seq = seq;
+    _progress_written = true;
 }
+
 void ManuallyTagger::save(const std::string & path) const {
-    safe_serialization(path, this->to_json());
+    progress_file::write(path, toProgress());
 }
 
 std::unique_ptr<ManuallyTagger> ManuallyTagger::load(const std::string & path) {
-    std::ifstream is(path);
-    nlohmann::json j;
-    is >> j;
-    auto tagger = ManuallyTagger::from_json(j);
+    const Progress progress = progress_file::read(path);
+    auto tagger = ManuallyTagger::fromProgress(progress);
+    tagger->_save_path = path;
+    // init sorts the images, so the current image is looked up by its path
+    std::string current;
+    if (progress.image_idx < progress.image_paths.size()) {
+        current = progress.image_paths.at(progress.image_idx);
+    }
+    tagger->replayJournal(journal::pathFor(path), progress.journal_seq, current);
     tagger->_loaded_from_serialization = true;
+    tagger->_progress_written = true;
     tagger->init();
+    const auto & paths = tagger->_image_paths;
+    auto it = std::find(paths.begin(), paths.end(), current);
+    tagger->_image_idx = it != paths.end() ? static_cast<unsigned long>(it - paths.begin()) : 0;
+    if (!progress.store_path.empty()) {
+        // init sorts the images, so the indices are recomputed in the new order
+        tagger->setDescriptorStore(progress.store_path);
+    }
     return tagger;
 
 }
+
+void ManuallyTagger::setDescriptorStore(const std::string & path) {
+    DescriptorStore store(path);
+    std::unordered_map<std::string, uint32_t> filename_to_idx;
+    filename_to_idx.reserve(store.size());
+    for(size_t i = 0; i < store.size(); i++) {
+        filename_to_idx[store.filename(i).to_string()] = static_cast<uint32_t>(i);
+    }
+    _store_indices.clear();
+    _store_indices.reserve(_image_paths.size());
+    for(const auto & image_path : _image_paths) {
+        auto it = filename_to_idx.find(image_path);
+        ASSERT(it != filename_to_idx.end(),
+               "Image " << image_path << " is not in the descriptor store " << path);
+        _store_indices.push_back(it->second);
+    }
+    _store_path = path;
+}
+
+void ManuallyTagger::replayJournal(const std::string & journal_path, uint64_t progress_seq,
+                                   std::string & current) {
+    _journal_seq = progress_seq;
+    _compacted_seq = progress_seq;
+    // journal entries refer to paths, the order of the images changes in `init`
+    std::unordered_map<std::string, size_t> path_to_idx;
+    for(size_t i = 0; i < _image_paths.size(); i++) {
+        path_to_idx[_image_paths.at(i)] = i;
+    }
+    if (_done_tagging.size() != _image_paths.size()) {
+        _done_tagging = std::vector<bool>(_image_paths.size(), false);
+    }
+    for(const auto & entry : journal::read(journal_path)) {
+        if (entry.seq <= progress_seq) {
+            continue;
+        }
+        auto it = path_to_idx.find(entry.done);
+        if (it != path_to_idx.end()) {
+            _done_tagging.at(it->second) = true;
+        }
+        if (!entry.current.empty()) {
+            current = entry.current;
+        }
+        _journal_seq = std::max(_journal_seq, entry.seq);
+    }
+}
+
 void ManuallyTagger::loadNextImage() {
     loadImage(_image_idx + 1);
 }
@@ -126,11 +266,26 @@ void ManuallyTagger::loadImage(unsigned long idx) {
         return;
     }
     _image_idx = idx;
-    _image = std::make_shared<Image>(*_image_descs.at(_image_idx));
     _desc = _image_descs.at(_image_idx);
+    _image = _image_cache->get(_desc->filename);
     emit loadedImage(_image_idx, _desc, _image);
     if (_image_idx == 0) { emit firstImage(); }
     if (_image_idx + 1 == _image_descs.size()) { emit lastImage(); }
+    prefetchAround(_image_idx);
+}
+
+void ManuallyTagger::prefetchAround(unsigned long idx) {
+    // the next images first, the user mostly goes forward
+    std::vector<std::string> filenames;
+    for(size_t d = 1; d <= _prefetch_depth; d++) {
+        if (idx + d < _image_descs.size()) {
+            filenames.push_back(_image_descs.at(idx + d)->filename);
+        }
+        if (idx >= d) {
+            filenames.push_back(_image_descs.at(idx - d)->filename);
+        }
+    }
+    _image_cache->prefetch(std::move(filenames));
 }
 
 void ManuallyTagger::loadCurrentImage() {
@@ -146,35 +301,52 @@ void ManuallyTagger::doneTagging(unsigned long idx) {
         qWarning() << "[doneTagging] index " << idx << " exceeded size of images "
             << _done_tagging.size();
     }
-    _image_descs.at(idx)->save();
+    scheduleSave(*_image_descs.at(idx));
+    if (!_done_tagging.at(idx)) {
+        _done_tagging.at(idx) = true;
+        _n_done++;
+    }
+    const std::string journal_path = journal::pathFor(savePath());
+    const std::string current = _image_idx < _image_descs.size() ?
+                                _image_descs.at(_image_idx)->filename : "";
+    const journal::Entry entry{++_journal_seq, _image_descs.at(idx)->filename, current};
+    // unique keys, journal entries must not be coalesced
+    _writer->schedule(journal_path + ":" + std::to_string(entry.seq), [journal_path, entry]() {
+        journal::append(journal_path, entry);
+    });
     save();
-    _done_tagging.at(idx) = true;
-    _n_done++;
     emit progress(static_cast<double>(_n_done)/_image_descs.size());
 }
 
+Progress ManuallyTagger::toProgress() const {
+    Progress progress;
+    progress.image_idx = _image_idx;
+    progress.done_tagging = _done_tagging;
+    progress.image_paths = _image_paths;
+    progress.journal_seq = _journal_seq;
+    if (!_store_path.empty()) {
+        progress.store_path = _store_path;
+        progress.store_indices = _store_indices;
+    }
+    return progress;
+}
+
+std::unique_ptr<ManuallyTagger> ManuallyTagger::fromProgress(const Progress & progress) {
+    auto tagger = std::make_unique<ManuallyTagger>();
+    tagger->_image_idx = progress.image_idx;
+    tagger->_done_tagging = progress.done_tagging;
+    tagger->_image_paths = progress.image_paths;
+    tagger->_store_path = progress.store_path;
+    tagger->_store_indices = progress.store_indices;
+    return tagger;
+}
+
 nlohmann::json ManuallyTagger::to_json() const {
-    nlohmann::json j;
-    j["image_idx"] = _image_idx;
-    j["done_tagging"] = _done_tagging;
-    j["image_paths"] =  _image_paths;
-    return j;
+    return toProgress().to_json();
 }
 
 
 std::unique_ptr<ManuallyTagger> ManuallyTagger::from_json(const nlohmann::json &json) {
-    auto tagger = std::make_unique<ManuallyTagger>();
-    tagger->_image_idx = json["image_idx"];
-    std::vector<bool> done_tagging;
-    for(auto done : json["done_tagging"]) {
-        done_tagging.push_back(done);
-    }
-    tagger->_done_tagging = done_tagging;
-    std::vector<std::string> image_paths;
-    for(auto path : json["image_paths"]) {
-        image_paths.push_back(path);
-    }
-    tagger->_image_paths  = image_paths;
-    return tagger;
+    return fromProgress(Progress::from_json(json));
 }
 }
@@ -11,27 +11,38 @@ using boost::optional;
 namespace deeplocalizer {
 
 
-ManuallyTaggerWindow::ManuallyTaggerWindow(std::unique_ptr<ManuallyTagger> tagger) :
+ManuallyTaggerWindow::ManuallyTaggerWindow(std::unique_ptr<ManuallyTagger> tagger,
+                                           bool use_opengl) :
     QMainWindow(nullptr),
     _tagger(std::move(tagger))
 {
-    init();
+    init(use_opengl);
 }
 
-ManuallyTaggerWindow::ManuallyTaggerWindow(std::vector<ImageDescPtr> && descriptions) :
+ManuallyTaggerWindow::ManuallyTaggerWindow(std::vector<ImageDescPtr> && descriptions,
+                                           bool use_opengl) :
     QMainWindow(nullptr),
     _tagger(std::make_unique<ManuallyTagger>(std::move(descriptions)))
 {
-    init();
+    init(use_opengl);
 }
 
-void ManuallyTaggerWindow::init() {
+void ManuallyTaggerWindow::init(bool use_opengl) {
     ui = new Ui::ManuallyTaggerWindow;
     ui->setupUi(this);
     _grid_layout = new QGridLayout(ui->scrollArea);
-    _whole_image = new WholeImageWidget(ui->scrollArea);
+    if (use_opengl) {
+        // the GLImageView has its own scroll bars and replaces the scroll area
+        _gl_image = new GLImageView(ui->scrollArea->parentWidget());
+        ui->scrollArea->parentWidget()->layout()->replaceWidget(ui->scrollArea, _gl_image);
+        ui->scrollArea->hide();
+        _image_view = _gl_image;
+    } else {
+        _whole_image = new WholeImageWidget(ui->scrollArea);
+        _image_view = _whole_image;
+    }
     _progres_bar = new QProgressBar(ui->statusbar);
-    _image_list_model = new QStringListModel(this);
+    _image_list_model = new ImageListModel(*_tagger, this);
     _save_timer = new QTimer(this);
     _save_timer->start(10000);
     ui->scrollArea->setAlignment(Qt::AlignCenter);
@@ -45,11 +56,18 @@ void ManuallyTaggerWindow::init() {
 ManuallyTaggerWindow::~ManuallyTaggerWindow()
 {
     save();
+    // the model refers to the tagger and the thumbnail cache, which are
+    // destroyed before the children of the window
+    delete _image_list_model;
+    _image_list_model = nullptr;
     delete ui;
 }
 
 void ManuallyTaggerWindow::showImage() {
-    _whole_image->setTags(_image->getCvMat(), &_desc->getTags());
+    _image_view->setTags(_image->getCvMat(), &_desc->getTags());
+    if (!_whole_image) {
+        return;
+    }
     ui->scrollArea->takeWidget();
     ui->scrollArea->setWidget(_whole_image);
     ui->scrollArea->setBackgroundRole(QPalette::Dark);
@@ -76,6 +94,7 @@ void ManuallyTaggerWindow::setupActions() {
     addAction(ui->actionScrollRight);
     addAction(ui->actionScrollUp);
     addAction(ui->actionScrollDown);
+    addAction(ui->actionRefresh);
 
     connect(ui->actionNext, &QAction::triggered, this, &ManuallyTaggerWindow::next);
     connect(ui->actionBack, &QAction::triggered, this, &ManuallyTaggerWindow::back);
@@ -89,15 +108,25 @@ void ManuallyTaggerWindow::setupActions() {
     connect(ui->actionScrollUp, &QAction::triggered, this, &ManuallyTaggerWindow::scrollTop);
     connect(ui->actionScrollDown, &QAction::triggered, this, &ManuallyTaggerWindow::scrollBottom);
 
-    connect(ui->actionZoomIn, &QAction::triggered, _whole_image, &WholeImageWidget::zoomIn);
-    connect(ui->actionZoomOut, &QAction::triggered, _whole_image, &WholeImageWidget::zoomOut);
+    connect(ui->actionZoomIn, &QAction::triggered, this, [this]() { _image_view->zoomIn(); });
+    connect(ui->actionZoomOut, &QAction::triggered, this, [this]() { _image_view->zoomOut(); });
     connect(ui->actionSave, &QAction::triggered, this, &ManuallyTaggerWindow::save);
+    // the done flags are cached, images tagged in another session only
+    // show up after a refresh
+    connect(ui->actionRefresh, &QAction::triggered, this, [this]() {
+        _tagger->refreshDoneState();
+        _image_list_model->allChanged();
+    });
 }
 
 void ManuallyTaggerWindow::setupConnections() {
     connect(ui->push_next, &QPushButton::clicked, ui->actionNext, &QAction::trigger);
     connect(ui->push_back, &QPushButton::clicked, ui->actionBack, &QAction::trigger);
-    connect(_whole_image, &WholeImageWidget::changed, this, &ManuallyTaggerWindow::changed);
+    if (_whole_image) {
+        connect(_whole_image, &WholeImageWidget::changed, this, &ManuallyTaggerWindow::changed);
+    } else {
+        connect(_gl_image, &GLImageView::changed, this, &ManuallyTaggerWindow::changed);
+    }
     connect(_tagger.get(), &ManuallyTagger::loadedImage, this, &ManuallyTaggerWindow::setImage);
     connect(_tagger.get(), &ManuallyTagger::outOfRange, []() {
         QMessageBox box;
@@ -130,35 +159,34 @@ void ManuallyTaggerWindow::updateStatusBar() {
 void ManuallyTaggerWindow::setupUi() {
     ui->statusbar->addPermanentWidget(_progres_bar);
     setProgress(0);
-    _image_list_model->setStringList(fileStringList());
+    // all rows have the same height, the view must not ask every row for it
+    ui->imagesListView->setUniformItemSizes(true);
     ui->imagesListView->setModel(_image_list_model);
-
 }
 
-QStringList ManuallyTaggerWindow::fileStringList() {
-    QStringList list;
-    auto & descs = _tagger->getImageDescs();
-    for(size_t i = 0; i < descs.size(); i++) {
-        const auto &desc = descs.at(i);
-        QString check;
-        if (_tagger->isDone(i)) {
-            check = "\u2713  ";
-        }
-        list.append("#" + QString::number(i+1) + ":   " + check +
-                            QString::fromStdString(desc->filename));
+void ManuallyTaggerWindow::setThumbnailDir(const std::string & dir) {
+    _image_list_model->setThumbnailCache(nullptr);
+    _thumbnails = std::make_unique<ThumbnailCache>(dir);
+    _image_list_model->setThumbnailCache(_thumbnails.get());
+    const int side = _thumbnails->maxSide();
+    ui->imagesListView->setIconSize(QSize(side, side));
+    std::vector<std::string> filenames;
+    filenames.reserve(_tagger->getImageDescs().size());
+    for(const auto & desc : _tagger->getImageDescs()) {
+        filenames.push_back(desc->filename);
     }
-    return list;
+    _thumbnails->generate(std::move(filenames));
 }
+
 void ManuallyTaggerWindow::next() {
-    if (_whole_image->getZoomFactor() > 0.5) {
-        _whole_image->setZoomFactor(0.30);
+    if (_image_view->getZoomFactor() > 0.5) {
+        _image_view->setZoomFactor(0.30);
         return;
     }
 
-    _whole_image->setZoomFactor(1.50);
+    _image_view->setZoomFactor(1.50);
     _tagger->doneTagging();
-
-    _image_list_model->setStringList(fileStringList());
+    _image_list_model->imageChanged(_tagger->getIdx());
     _tagger->loadNextImage();
 }
 
@@ -167,8 +195,8 @@ void ManuallyTaggerWindow::back() {
 }
 
 void ManuallyTaggerWindow::scroll() {
-    QScrollBar * vert = ui->scrollArea->verticalScrollBar();
-    QScrollBar * horz = ui->scrollArea->horizontalScrollBar();
+    QScrollBar * vert = _image_view->verticalScrollBar();
+    QScrollBar * horz = _image_view->horizontalScrollBar();
     int next_horz = horz->value() + horz->pageStep() / 2;
     int next_vert = vert->value() + static_cast<int>(vert->pageStep() * 0.8);
 
@@ -189,8 +217,8 @@ void ManuallyTaggerWindow::scroll() {
 }
 
 void ManuallyTaggerWindow::scrollBack() {
-    QScrollBar * vert = ui->scrollArea->verticalScrollBar();
-    QScrollBar * horz = ui->scrollArea->horizontalScrollBar();
+    QScrollBar * vert = _image_view->verticalScrollBar();
+    QScrollBar * horz = _image_view->horizontalScrollBar();
     int last_horz = horz->value() - horz->pageStep() / 2;
     int last_vert = vert->value() - static_cast<int>(vert->pageStep() * 0.8);
     if(horz->value() == horz->minimum() && vert->value() == vert->minimum()) {
@@ -210,22 +238,22 @@ void ManuallyTaggerWindow::scrollBack() {
 }
 
 void ManuallyTaggerWindow::scrollLeft() {
-    auto horz = ui->scrollArea->horizontalScrollBar();
+    auto horz = _image_view->horizontalScrollBar();
     horz->setValue(horz->value() - horz->pageStep()/8);
 }
 
 void ManuallyTaggerWindow::scrollRight() {
-    auto horz = ui->scrollArea->horizontalScrollBar();
+    auto horz = _image_view->horizontalScrollBar();
     horz->setValue(int(horz->value() + horz->pageStep()/8));
 }
 
 void ManuallyTaggerWindow::scrollTop() {
-    auto vert = ui->scrollArea->verticalScrollBar();
+    auto vert = _image_view->verticalScrollBar();
     vert->setValue(int(vert->value() - vert->pageStep()/8));
 }
 
 void ManuallyTaggerWindow::scrollBottom() {
-    auto vert = ui->scrollArea->verticalScrollBar();
+    auto vert = _image_view->verticalScrollBar();
     vert->setValue(int(vert->value() + vert->pageStep()/8));
 }
 
@@ -244,6 +272,7 @@ void ManuallyTaggerWindow::eraseNegativeTags() {
     tags.erase(std::remove_if(tags.begin(), tags.end(), [](const auto & tag) {
         return tag.isNoTag();
     }), tags.end());
+    _image_view->reindexTags();
 }
 
 void ManuallyTaggerWindow::changed() {
@@ -252,13 +281,8 @@ void ManuallyTaggerWindow::changed() {
 }
 void ManuallyTaggerWindow::save(bool all_descs) {
     if(_changed) {
-        _tagger->save();
-        if (all_descs) {
-        } else {
-            if (_desc) {
-                _desc->save();
-            }
-        }
+        // also writes the current description, off the GUI thread
+        _tagger->save(all_descs);
         _changed = false;
         updateStatusBar();
     }
@@ -0,0 +1,46 @@
+
+#include "Patch.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "utils.h"
+
+namespace deeplocalizer {
+
+bool isSpecializedPatchSize(int size) {
+    return std::find(std::begin(SPECIALIZED_PATCH_SIZES), std::end(SPECIALIZED_PATCH_SIZES),
+                     size) != std::end(SPECIALIZED_PATCH_SIZES);
+}
+
+void checkPatchSize(int size) {
+    ASSERT(size > 0 && size % 2 == 0, "The patch size must be positive and even. But got: " << size);
+}
+
+void copyPatch(const cv::Mat & src, cv::Point top_left, cv::Mat & dst) {
+    const int size = dst.rows;
+    const cv::Rect box(top_left, cv::Size(size, size));
+    CV_Assert(dst.cols == size && dst.type() == src.type() &&
+              (box & cv::Rect(0, 0, src.cols, src.rows)) == box);
+    if (src.type() != CV_8UC1) {
+        src(box).copyTo(dst);
+        return;
+    }
+    const uchar * begin = src.ptr<uchar>(top_left.y) + top_left.x;
+    dispatchPatchSize(size, [&](auto kernel) {
+        decltype(kernel)::copy(begin, src.step, dst.data, dst.step, size);
+    });
+}
+
+void packPatch(const cv::Mat & src, float * dst, float scale) {
+    if (src.type() != CV_8UC1 || src.rows != src.cols) {
+        cv::Mat plane(src.size(), CV_32F, dst);
+        src.convertTo(plane, CV_32F, scale);
+        return;
+    }
+    const int size = src.rows;
+    dispatchPatchSize(size, [&](auto kernel) {
+        decltype(kernel)::pack(src.data, src.step, dst, scale, size);
+    });
+}
+}
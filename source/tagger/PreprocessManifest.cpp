@@ -0,0 +1,140 @@
+#include "PreprocessManifest.h"
+
+#include <iostream>
+
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace io = boost::filesystem;
+using json = nlohmann::json;
+
+const std::string PreprocessManifest::DEFAULT_FILENAME = "preprocess_manifest.jsonl";
+
+json ManifestEntry::to_json() const {
+    json j;
+    j["input"] = input;
+    j["size"] = size;
+    j["mtime"] = static_cast<int64_t>(mtime);
+    j["fingerprint"] = fingerprint;
+    j["output"] = output;
+    return j;
+}
+
+ManifestEntry ManifestEntry::from_json(const json & j) {
+    ManifestEntry entry;
+    entry.input = j["input"].get<std::string>();
+    entry.size = j["size"].get<uintmax_t>();
+    entry.mtime = static_cast<std::time_t>(j["mtime"].get<int64_t>());
+    entry.fingerprint = j["fingerprint"].get<std::string>();
+    entry.output = j["output"].get<std::string>();
+    return entry;
+}
+
+PreprocessManifest::PreprocessManifest(const io::path & path) : _path(path) {
+    load();
+    _journal.open(_path.string(), std::ios::app);
+    ASSERT(_journal.good(), "Could not open manifest " << _path);
+}
+
+void PreprocessManifest::load() {
+    if (!io::exists(_path)) {
+        return;
+    }
+    std::ifstream is(_path.string());
+    std::string line;
+    while(std::getline(is, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        try {
+            ManifestEntry entry = ManifestEntry::from_json(json::parse(line));
+            _entries[entry.input] = entry;
+        } catch(const std::exception & e) {
+            // the last line is truncated if a run was killed while writing
+            std::cerr << "Ignore broken line of manifest " << _path << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+boost::optional<ManifestEntry> PreprocessManifest::stat(const std::string & input) {
+    boost::system::error_code ec;
+    ManifestEntry entry;
+    entry.input = input;
+    entry.size = io::file_size(input, ec);
+    if (ec) { return boost::optional<ManifestEntry>(); }
+    entry.mtime = io::last_write_time(input, ec);
+    if (ec) { return boost::optional<ManifestEntry>(); }
+    return entry;
+}
+
+boost::optional<std::string> PreprocessManifest::upToDate(const std::string & input,
+                                                          const std::string & fingerprint) const {
+    ManifestEntry recorded;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(input);
+        if (it == _entries.end()) {
+            return boost::optional<std::string>();
+        }
+        recorded = it->second;
+    }
+    auto current = stat(input);
+    if (!current ||
+            current->size != recorded.size ||
+            current->mtime != recorded.mtime ||
+            fingerprint != recorded.fingerprint ||
+            !io::exists(recorded.output)) {
+        return boost::optional<std::string>();
+    }
+    return recorded.output;
+}
+
+void PreprocessManifest::record(const std::string & input, const std::string & fingerprint,
+                                const std::string & output) {
+    auto entry = stat(input);
+    if (!entry) {
+        return;
+    }
+    entry->fingerprint = fingerprint;
+    entry->output = output;
+    std::string line = entry->to_json().dump();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _journal << line << '\n' << std::flush;
+    _entries[input] = entry.get();
+}
+
+void PreprocessManifest::merge(const PreprocessManifest & other) {
+    std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+    std::unique_lock<std::mutex> other_lock(other._mutex, std::defer_lock);
+    std::lock(lock, other_lock);
+    for(const auto & pair : other._entries) {
+        _journal << pair.second.to_json().dump() << '\n';
+        _entries[pair.first] = pair.second;
+    }
+    _journal << std::flush;
+}
+
+boost::optional<std::string> PreprocessManifest::output(const std::string & input) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(input);
+    if (it == _entries.end()) {
+        return boost::optional<std::string>();
+    }
+    return it->second.output;
+}
+
+void PreprocessManifest::compact() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _journal.close();
+    io::path tmp_path = io::unique_path(_path.parent_path() / "%%%%%%%%%.jsonl");
+    {
+        std::ofstream os(tmp_path.string());
+        for(const auto & pair : _entries) {
+            os << pair.second.to_json().dump() << '\n';
+        }
+    }
+    io::rename(tmp_path, _path);
+    _journal.open(_path.string(), std::ios::app);
+}
+}
@@ -0,0 +1,489 @@
+#include "Preprocessor.h"
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "Patch.h"
+#include "Stats.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace io = boost::filesystem;
+
+const double Preprocessor::THRESHOLD_MAX_VALUE = 255;
+const int Preprocessor::THRESHOLD_BLOCK_SIZE = 51;
+const double Preprocessor::THRESHOLD_WEIGHT_ORIGINAL = 0.7;
+const double Preprocessor::THRESHOLD_WEIGHT_THRESHOLD = 0.3;
+const int Preprocessor::CLAHE_CLIP_LIMIT = 2;
+const int Preprocessor::THRESHOLD_STRIP_ROWS = 32;
+
+std::string format_to_str(ImageFormat format) {
+    if (format == ImageFormat::JPEG) {
+        return "jpeg";
+    } else if(format == ImageFormat::PNG) {
+        return "png";
+    } else {
+        return "wrong";
+    }
+}
+
+std::pair<int, int> OutputVariant::opencv_compression() const {
+    int f;
+    if (format == ImageFormat::JPEG) {
+        f = cv::IMWRITE_JPEG_QUALITY;
+    } else {
+        f = cv::IMWRITE_PNG_COMPRESSION;
+    }
+    return std::make_pair(f, compression);
+}
+
+std::string OutputVariant::extension() const {
+    std::vector<std::string> parts;
+    if (use_hist_eq) {
+        parts.push_back("clahe");
+    }
+    if (use_thresholding) {
+        parts.push_back("t");
+    }
+    if (add_border) {
+        parts.push_back("b");
+    }
+    if (parts.empty()) {
+        return "";
+    } else {
+        std::stringstream ss;
+        for(const auto & part : parts) {
+            ss << "." << part;
+        }
+        return ss.str();
+    }
+}
+
+std::string OutputVariant::fingerprint() const {
+    std::stringstream ss;
+    ss << extension() << "." << format_to_str(format) << ":" << compression;
+    if (use_thresholding && use_binary_image) {
+        ss << ":binary";
+    }
+    // unchanged for the default, so existing outputs are not written again
+    if (add_border && patch_size != PATCH_SIZE_DEFAULT) {
+        ss << ":patch" << patch_size;
+    }
+    return ss.str();
+}
+
+namespace {
+
+bool parseBool(const std::string & key, const std::string & value) {
+    if (value == "1" || value == "true") {
+        return true;
+    }
+    ASSERT(value == "0" || value == "false",
+           "Expected 0 or 1 for " << key << " of a variant. But got: " << value);
+    return false;
+}
+}
+
+OutputVariant OutputVariant::parse(const std::string & spec, const OutputVariant & base) {
+    OutputVariant variant = base;
+    bool has_compression = false;
+    std::stringstream ss(spec);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        auto eq = item.find('=');
+        ASSERT(eq != std::string::npos, "Expected key=value in variant " << spec << ". But got: " << item);
+        const std::string key = item.substr(0, eq);
+        const std::string value = item.substr(eq + 1);
+        if (key == "dir") {
+            variant.output_dir = value;
+        } else if (key == "border") {
+            variant.add_border = parseBool(key, value);
+        } else if (key == "patch") {
+            variant.patch_size = std::stoi(value);
+            checkPatchSize(variant.patch_size);
+        } else if (key == "clahe") {
+            variant.use_hist_eq = parseBool(key, value);
+        } else if (key == "threshold") {
+            variant.use_thresholding = parseBool(key, value);
+        } else if (key == "binary") {
+            variant.use_binary_image = parseBool(key, value);
+        } else if (key == "format") {
+            ASSERT(value == "jpeg" || value == "png",
+                   "Expected `png` or `jpeg` format. But got: " << value);
+            variant.format = value == "png" ? ImageFormat::PNG : ImageFormat::JPEG;
+        } else if (key == "compression") {
+            variant.compression = std::stoi(value);
+            has_compression = true;
+        } else {
+            ASSERT(false, "Unknown key " << key << " in variant " << spec);
+        }
+    }
+    if (!has_compression && variant.format != base.format) {
+        variant.compression = variant.format == ImageFormat::JPEG ?
+                              DEFAULT_JPEG_COMPRESSION : DEFAULT_PNG_COMPRESSION;
+    }
+    return variant;
+}
+
+OutputVariant PreprocessOptions::variant() const {
+    OutputVariant variant;
+    variant.output_dir = output_dir;
+    variant.use_hist_eq = use_hist_eq;
+    variant.use_thresholding = use_thresholding;
+    variant.use_binary_image = use_binary_image;
+    variant.add_border = add_border;
+    variant.patch_size = patch_size;
+    variant.format = format;
+    variant.compression = compression;
+    return variant;
+}
+
+std::vector<OutputVariant> PreprocessOptions::variants() const {
+    std::vector<OutputVariant> variants{variant()};
+    variants.insert(variants.end(), extra_variants.begin(), extra_variants.end());
+    return variants;
+}
+
+std::pair<int, int> PreprocessOptions::opencv_compression() const {
+    return variant().opencv_compression();
+}
+
+std::string PreprocessOptions::extension() const {
+    return variant().extension();
+}
+
+std::string PreprocessOptions::fingerprint() const {
+    std::string fingerprint = variant().fingerprint();
+    for(const auto & extra : extra_variants) {
+        fingerprint += "|" + extra.output_dir.string() + "/" + extra.fingerprint();
+    }
+    return fingerprint;
+}
+
+void PreprocessOptions::print() const {
+    std::cout << "output-dir:       " << output_dir << std::endl;
+    std::cout << "use-hist-eq:      " << use_hist_eq << std::endl;
+    std::cout << "use-thresholding: " << use_thresholding << std::endl;
+    std::cout << "add-border:       " << add_border << std::endl;
+    std::cout << "patch-size:       " << patch_size << std::endl;
+    std::cout << "threads:          " << nb_threads << std::endl;
+    std::cout << "io-threads:       " << nb_io_threads << std::endl;
+    std::cout << "queue-depth:      " << queue_depth << std::endl;
+    for(const auto & extra : extra_variants) {
+        std::cout << "variant:          " << extra.output_dir << " "
+                  << extra.fingerprint() << std::endl;
+    }
+}
+
+io::path add_extension(const io::path & filename, const OutputVariant & variant) {
+    io::path output_path(filename);
+    output_path.replace_extension();
+    output_path += variant.extension() + std::string(".") + format_to_str(variant.format);
+    return output_path;
+}
+
+io::path add_extension(const io::path & filename, const PreprocessOptions & opt) {
+    return add_extension(filename, opt.variant());
+}
+
+namespace {
+
+void thresholdAndBlendScalar(const uchar * src, const float * mean, uchar * dst,
+                             int begin, int end, const uchar * lut) {
+    for(int x = begin; x < end; x++) {
+        // the mean is rounded like cv::Mat::convertTo, and cv::THRESH_BINARY
+        // with delta 0 is 255 iff the pixel is above it
+        const bool above = src[x] > cv::saturate_cast<uchar>(mean[x]);
+        dst[x] = lut[(int(above) << 8) | src[x]];
+    }
+}
+
+// Compares and blends 16 pixels at once with the universal intrinsics of
+// OpenCV, SSE2 or NEON. Returns the number of pixels done, the rest of the
+// row is left to thresholdAndBlendScalar.
+int thresholdAndBlendVector(const uchar * src, const float * mean, uchar * dst, int cols) {
+    int x = 0;
+#if CV_SIMD128
+    // cv::addWeighted computes src * alpha + threshold * beta in float
+    const cv::v_float32x4 alpha = cv::v_setall_f32(
+            static_cast<float>(Preprocessor::THRESHOLD_WEIGHT_ORIGINAL));
+    const cv::v_float32x4 above = cv::v_setall_f32(
+            static_cast<float>(Preprocessor::THRESHOLD_MAX_VALUE) *
+            static_cast<float>(Preprocessor::THRESHOLD_WEIGHT_THRESHOLD));
+    const cv::v_float32x4 below = cv::v_setzero_f32();
+    for(; x <= cols - 16; x += 16) {
+        const cv::v_uint8x16 s = cv::v_load(src + x);
+        const cv::v_uint8x16 m = cv::v_pack_u(
+                cv::v_pack(cv::v_round(cv::v_load(mean + x)),     cv::v_round(cv::v_load(mean + x + 4))),
+                cv::v_pack(cv::v_round(cv::v_load(mean + x + 8)), cv::v_round(cv::v_load(mean + x + 12))));
+        cv::v_uint16x8 s0, s1;
+        cv::v_expand(s, s0, s1);
+        cv::v_uint32x4 s00, s01, s10, s11;
+        cv::v_expand(s0, s00, s01);
+        cv::v_expand(s1, s10, s11);
+        const cv::v_float32x4 f0 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(s00));
+        const cv::v_float32x4 f1 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(s01));
+        const cv::v_float32x4 f2 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(s10));
+        const cv::v_float32x4 f3 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(s11));
+        auto blend = [&](const cv::v_float32x4 & threshold) {
+            return cv::v_pack_u(
+                    cv::v_pack(cv::v_round(f0 * alpha + threshold), cv::v_round(f1 * alpha + threshold)),
+                    cv::v_pack(cv::v_round(f2 * alpha + threshold), cv::v_round(f3 * alpha + threshold)));
+        };
+        cv::v_store(dst + x, cv::v_select(s > m, blend(above), blend(below)));
+    }
+#else
+    (void) src; (void) mean; (void) dst; (void) cols;
+#endif
+    return x;
+}
+
+// The vector kernel rounds in its own way, e.g. the compiler may fuse its
+// multiply and add. It is only used if it gives the same result as the
+// lookup table for every pixel value below and above its mean, and for
+// means halfway between two values, the only ones where rounding matters.
+bool vectorKernelMatches(const uchar * lut) {
+    const int n = 1024;
+    std::vector<uchar> src(n), expected(n), out(n);
+    std::vector<float> mean(n);
+    for(int i = 0; i < n; i++) {
+        if (i < 512) {
+            // every value below a mean that saturates, then above one
+            src[i] = static_cast<uchar>(i % 256);
+            mean[i] = i < 256 ? 300.f : -10.f;
+        } else {
+            const int j = i - 512;
+            mean[i] = j * 0.5f;
+            src[i] = static_cast<uchar>((j + 1) / 2);
+        }
+    }
+    thresholdAndBlendScalar(src.data(), mean.data(), expected.data(), 0, n, lut);
+    if (thresholdAndBlendVector(src.data(), mean.data(), out.data(), n) != n) {
+        return false;
+    }
+    return out == expected;
+}
+}
+
+Preprocessor::Preprocessor(const PreprocessOptions & opt) :
+    Preprocessor(opt.variant())
+{
+}
+
+Preprocessor::Preprocessor(const OutputVariant & opt) :
+    _add_border(opt.add_border),
+    _border(opt.patch_size / 2),
+    _use_hist_eq(opt.use_hist_eq),
+    _use_thresholding(opt.use_thresholding),
+    _use_binary_image(opt.use_binary_image)
+{
+    initBlendLut();
+    _vector_kernel = vectorKernelMatches(_blend_lut.data());
+    if (_use_hist_eq) {
+        static const cv::Size tile_size(TAG_WIDTH / 2, TAG_HEIGHT / 2);
+        _clahe = cv::createCLAHE(CLAHE_CLIP_LIMIT, tile_size);
+    }
+}
+
+void Preprocessor::process(const cv::Mat & src, cv::Mat & dst) {
+    stats::ScopedTimer timer(stats::Metric::Filter, src.total());
+    int remaining_steps = int(_add_border) + int(_use_hist_eq) + int(_use_thresholding);
+    if (remaining_steps == 0) {
+        dst = src;
+        return;
+    }
+    // every step writes into its own reused buffer, only the last one to `dst`
+    auto output = [&](cv::Mat & buffer) -> cv::Mat & {
+        remaining_steps--;
+        return remaining_steps == 0 ? dst : buffer;
+    };
+    const cv::Mat * current = &src;
+    if (_add_border) {
+        cv::Mat & out = output(_bordered);
+        makeBorder(*current, out);
+        current = &out;
+    }
+    if (_use_hist_eq) {
+        cv::Mat & out = output(_clahe_out);
+        localHistogramEq(*current, out);
+        current = &out;
+    }
+    if (_use_thresholding) {
+        // thresholding is always the last step
+        adaptiveTresholding(*current, dst);
+    }
+}
+
+void Preprocessor::process(cv::Mat & mat) {
+    // `mat` refers to `_result` after the last call. Once the caller let go
+    // of that image, the buffer is written again.
+    if (_result.u && _result.u->refcount > 1) {
+        _result.release();
+    }
+    process(mat, _result);
+    mat = _result;
+}
+
+void Preprocessor::makeBorder(const cv::Mat & src, cv::Mat & dst) const {
+    // copyMakeBorder only allocates if `dst` does not fit already
+    cv::copyMakeBorder(src, dst,
+                       _border, _border, _border, _border,
+                       cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+}
+
+void Preprocessor::localHistogramEq(const cv::Mat & src, cv::Mat & dst) {
+    _clahe->apply(src, dst);
+}
+
+void Preprocessor::adaptiveTresholding(const cv::Mat & src, cv::Mat & dst) {
+    if (_use_binary_image) {
+        cv::adaptiveThreshold(src, dst, THRESHOLD_MAX_VALUE,
+                              cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                              cv::THRESH_BINARY, THRESHOLD_BLOCK_SIZE, 0);
+    } else {
+        thresholdAndBlend(src, dst);
+    }
+}
+
+void Preprocessor::thresholdAndBlend(const cv::Mat & src, cv::Mat & dst) {
+    CV_Assert(src.type() == CV_8UC1);
+    const int radius = THRESHOLD_BLOCK_SIZE / 2;
+    _src_float.create(src.size(), CV_32F);
+    _strip_mean.create(THRESHOLD_STRIP_ROWS, src.cols, CV_32F);
+    dst.create(src.size(), CV_8UC1);
+    int converted = 0;
+    for(int y0 = 0; y0 < src.rows; y0 += THRESHOLD_STRIP_ROWS) {
+        const int y1 = std::min(y0 + THRESHOLD_STRIP_ROWS, src.rows);
+        // the blur of a strip reads `radius` rows below it
+        const int needed = std::min(y1 + radius, src.rows);
+        cv::Mat src_float = _src_float.rowRange(converted, needed);
+        src.rowRange(converted, needed).convertTo(src_float, CV_32F);
+        converted = needed;
+        // The same gaussian mean as cv::adaptiveThreshold computes since
+        // OpenCV 3.3, blurred in float. The strip is not isolated, so the
+        // blur takes the rows around it from the frame and replicates only
+        // at the frame borders. Without a sigma GaussianBlur never uses IPP,
+        // so every row is the same as if the whole frame was blurred at once.
+        cv::Mat mean = _strip_mean.rowRange(0, y1 - y0);
+        cv::GaussianBlur(_src_float.rowRange(y0, y1), mean,
+                         cv::Size(THRESHOLD_BLOCK_SIZE, THRESHOLD_BLOCK_SIZE), 0, 0,
+                         cv::BORDER_REPLICATE);
+        // the mean of the strip is still in the cache
+        for(int y = y0; y < y1; y++) {
+            thresholdAndBlendRow(src.ptr<uchar>(y), mean.ptr<float>(y - y0),
+                                 dst.ptr<uchar>(y), src.cols);
+        }
+    }
+}
+
+void Preprocessor::thresholdAndBlendRow(const uchar * src, const float * mean,
+                                        uchar * dst, int cols) const {
+    int x = 0;
+    if (_vector_kernel) {
+        x = thresholdAndBlendVector(src, mean, dst, cols);
+    }
+    thresholdAndBlendScalar(src, mean, dst, x, cols, _blend_lut.data());
+}
+
+void Preprocessor::initBlendLut() {
+    // Taking the values from cv::addWeighted itself guarantees the same
+    // rounding as the separate adaptiveThreshold + addWeighted calls.
+    cv::Mat ramp(1, 256, CV_8UC1);
+    for(int i = 0; i < 256; i++) {
+        ramp.at<uchar>(i) = static_cast<uchar>(i);
+    }
+    for(int above = 0; above < 2; above++) {
+        cv::Mat threshold(1, 256, CV_8UC1, cv::Scalar(above ? THRESHOLD_MAX_VALUE : 0));
+        cv::Mat blended;
+        cv::addWeighted(ramp, THRESHOLD_WEIGHT_ORIGINAL, threshold, THRESHOLD_WEIGHT_THRESHOLD,
+                        0 /*gamma*/, blended);
+        std::copy(blended.ptr<uchar>(), blended.ptr<uchar>() + 256,
+                  _blend_lut.begin() + 256 * above);
+    }
+}
+
+VariantPreprocessor::VariantPreprocessor(const std::vector<OutputVariant> & variants) {
+    // at most three steps per variant, the vector must not reallocate later
+    _nodes.reserve(3 * variants.size());
+    for(size_t v = 0; v < variants.size(); v++) {
+        const OutputVariant & variant = variants[v];
+        OutputVariant step;
+        step.add_border = false;
+        int node = -1;
+        std::string key;
+        if (variant.add_border) {
+            OutputVariant border = step;
+            border.add_border = true;
+            border.patch_size = variant.patch_size;
+            key += ".b" + std::to_string(variant.patch_size);
+            node = addStep(node, key, border);
+        }
+        if (variant.use_hist_eq) {
+            OutputVariant clahe = step;
+            clahe.use_hist_eq = true;
+            key += ".clahe";
+            node = addStep(node, key, clahe);
+        }
+        if (variant.use_thresholding) {
+            OutputVariant threshold = step;
+            threshold.use_thresholding = true;
+            threshold.use_binary_image = variant.use_binary_image;
+            key += variant.use_binary_image ? ".t:binary" : ".t";
+            node = addStep(node, key, threshold);
+        }
+        if (node >= 0 && _nodes[node].output < 0) {
+            _nodes[node].output = static_cast<int>(v);
+        }
+        _variant_nodes.push_back(node);
+    }
+}
+
+int VariantPreprocessor::addStep(int parent, const std::string & key, const OutputVariant & step) {
+    for(size_t n = 0; n < _nodes.size(); n++) {
+        if (_nodes[n].key == key) {
+            return static_cast<int>(n);
+        }
+    }
+    _nodes.push_back(Node{parent, key, Preprocessor(step), -1, cv::Mat()});
+    return static_cast<int>(_nodes.size() - 1);
+}
+
+bool VariantPreprocessor::sharesOutput(size_t variant) const {
+    const int node = _variant_nodes.at(variant);
+    if (node < 0) {
+        return true;
+    }
+    return std::count(_variant_nodes.begin(), _variant_nodes.end(), node) > 1;
+}
+
+void VariantPreprocessor::process(const cv::Mat & src, std::vector<cv::Mat> & outputs) {
+    outputs.resize(_variant_nodes.size());
+    auto result = [&](int node) -> cv::Mat & {
+        Node & n = _nodes[node];
+        return n.output < 0 ? n.buffer : outputs[n.output];
+    };
+    // parents are always added before their children
+    for(size_t n = 0; n < _nodes.size(); n++) {
+        Node & node = _nodes[n];
+        const cv::Mat & input = node.parent < 0 ? src : result(node.parent);
+        node.step.process(input, result(static_cast<int>(n)));
+    }
+    for(size_t v = 0; v < _variant_nodes.size(); v++) {
+        const int node = _variant_nodes[v];
+        if (node < 0) {
+            outputs[v] = src;
+        } else if (_nodes[node].output != static_cast<int>(v)) {
+            outputs[v] = outputs[_nodes[node].output];
+        }
+    }
+}
+}
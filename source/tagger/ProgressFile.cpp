@@ -0,0 +1,181 @@
+
+#include "ProgressFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <boost/filesystem.hpp>
+
+#include "DescriptorStore.h"
+#include "Shards.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace io = boost::filesystem;
+using json = nlohmann::json;
+
+json Progress::to_json() const {
+    json j;
+    j["image_idx"] = image_idx;
+    j["done_tagging"] = done_tagging;
+    j["image_paths"] = image_paths;
+    j["journal_seq"] = journal_seq;
+    return j;
+}
+
+Progress Progress::from_json(const json & j) {
+    Progress progress;
+    progress.image_idx = j["image_idx"];
+    for(auto done : j["done_tagging"]) {
+        progress.done_tagging.push_back(done);
+    }
+    for(auto path : j["image_paths"]) {
+        progress.image_paths.push_back(path);
+    }
+    if (j.count("journal_seq")) {
+        progress.journal_seq = j["journal_seq"];
+    }
+    return progress;
+}
+
+namespace progress_file {
+
+const char MAGIC[8] = {'D', 'L', 'P', 'R', 'O', 'G', '\0', '\0'};
+
+bool isBinaryPath(const std::string & path) {
+    return io::path(path).extension() == BINARY_EXTENSION;
+}
+
+bool isBinaryFile(const std::string & path) {
+    std::ifstream is(path, std::ios::binary);
+    char magic[sizeof(MAGIC)] = {};
+    is.read(magic, sizeof(magic));
+    return is && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+namespace {
+
+void writeBinary(std::ostream & os, const Progress & progress) {
+    const size_t n = progress.image_paths.size();
+    const bool use_store = !progress.store_path.empty();
+    ASSERT(!use_store || progress.store_indices.size() == n,
+           "Expected one descriptor store index per image");
+    std::string table;
+    if (use_store) {
+        table = progress.store_path;
+    } else {
+        for(const auto & path : progress.image_paths) {
+            table.append(path);
+            table.push_back('\n');
+        }
+    }
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.flags = use_store ? FLAG_STORE : 0;
+    header.nb_images = n;
+    header.image_idx = progress.image_idx;
+    header.journal_seq = progress.journal_seq;
+    header.table_size = table.size();
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    os.write(table.data(), table.size());
+    if (use_store) {
+        os.write(reinterpret_cast<const char *>(progress.store_indices.data()),
+                 n * sizeof(uint32_t));
+    }
+    std::vector<uint64_t> words((n + 63) / 64, 0);
+    for(size_t i = 0; i < n && i < progress.done_tagging.size(); i++) {
+        if (progress.done_tagging[i]) {
+            words[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+    os.write(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint64_t));
+}
+
+Progress readBinary(const std::string & path) {
+    std::ifstream is(path, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    ASSERT(data.size() >= sizeof(Header), "Progress file " << path << " is truncated.");
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    ASSERT(header.version == VERSION, "Progress file " << path << " has version "
+           << header.version << ", expected " << VERSION);
+    const size_t n = header.nb_images;
+    const bool use_store = header.flags & FLAG_STORE;
+    const size_t indices_size = use_store ? n * sizeof(uint32_t) : 0;
+    const size_t words_size = (n + 63) / 64 * sizeof(uint64_t);
+    ASSERT(data.size() >= sizeof(Header) + header.table_size + indices_size + words_size,
+           "Progress file " << path << " is truncated.");
+
+    Progress progress;
+    progress.image_idx = header.image_idx;
+    progress.journal_seq = header.journal_seq;
+    const char * table = data.data() + sizeof(Header);
+    if (use_store) {
+        progress.store_path.assign(table, header.table_size);
+        progress.store_indices.resize(n);
+        std::memcpy(progress.store_indices.data(), table + header.table_size, indices_size);
+        DescriptorStore store(progress.store_path);
+        progress.image_paths.reserve(n);
+        for(uint32_t idx : progress.store_indices) {
+            ASSERT(idx < store.size(), "Progress file " << path << " refers to image " << idx
+                   << ", but the descriptor store " << progress.store_path << " only has "
+                   << store.size() << " images.");
+            progress.image_paths.push_back(store.filename(idx).to_string());
+        }
+    } else {
+        progress.image_paths.reserve(n);
+        const char * begin = table;
+        const char * end = table + header.table_size;
+        while(begin < end) {
+            const char * line_end = std::find(begin, end, '\n');
+            progress.image_paths.emplace_back(begin, line_end);
+            begin = line_end + 1;
+        }
+        ASSERT(progress.image_paths.size() == n, "Progress file " << path << " is corrupted.");
+    }
+    const char * words = table + header.table_size + indices_size;
+    progress.done_tagging.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        uint64_t word;
+        std::memcpy(&word, words + (i / 64) * sizeof(uint64_t), sizeof(word));
+        progress.done_tagging[i] = (word >> (i % 64)) & 1;
+    }
+    return progress;
+}
+}
+
+void write(const std::string & path, const Progress & progress) {
+    if (!isBinaryPath(path)) {
+        safe_serialization(path, progress.to_json());
+        return;
+    }
+    io::path save_path(path);
+    io::path tmp_path = io::unique_path(save_path.parent_path() / "%%%%%%%%%.bin");
+    {
+        std::ofstream os(tmp_path.string(), std::ios::binary);
+        writeBinary(os, progress);
+        ASSERT(os.good(), "Could not write progress file " << tmp_path);
+    }
+    io::rename(tmp_path, save_path);
+}
+
+Progress read(const std::string & path) {
+    ASSERT(io::exists(path), "File " << path << " does not exists.");
+    if (isBinaryFile(path)) {
+        return readBinary(path);
+    }
+    std::ifstream is(path);
+    json j;
+    is >> j;
+    return Progress::from_json(j);
+}
+
+std::string shardPath(const std::string & path, size_t shard, size_t nb_shards) {
+    return deeplocalizer::shardPath(path, shard, nb_shards);
+}
+}
+}
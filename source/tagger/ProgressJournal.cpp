@@ -0,0 +1,72 @@
+
+#include "ProgressJournal.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+namespace deeplocalizer {
+namespace journal {
+
+namespace io = boost::filesystem;
+using json = nlohmann::json;
+
+json Entry::to_json() const {
+    json j;
+    j["seq"] = seq;
+    j["done"] = done;
+    j["current"] = current;
+    return j;
+}
+
+Entry Entry::from_json(const json & j) {
+    Entry entry;
+    entry.seq = j["seq"];
+    entry.done = j["done"].get<std::string>();
+    // entries of older versions only have the index of the current image
+    if (j.find("current") != j.end()) {
+        entry.current = j["current"].get<std::string>();
+    }
+    return entry;
+}
+
+std::string pathFor(const std::string & progress_path) {
+    return progress_path + ".journal";
+}
+
+std::vector<Entry> read(const std::string & path) {
+    std::vector<Entry> entries;
+    std::ifstream is(path);
+    std::string line;
+    while(std::getline(is, line)) {
+        try {
+            entries.push_back(Entry::from_json(json::parse(line)));
+        } catch(const std::exception &) {
+            continue;
+        }
+    }
+    return entries;
+}
+
+void append(const std::string & path, const Entry & entry) {
+    std::ofstream os(path, std::ios::app);
+    os << entry.to_json().dump() << '\n';
+}
+
+void compact(const std::string & path, uint64_t seq) {
+    if (!io::exists(path)) {
+        return;
+    }
+    io::path tmp_path = io::unique_path(io::path(path).parent_path() / "%%%%%%%%%.journal");
+    {
+        std::ofstream os(tmp_path.string());
+        for(const auto & entry : read(path)) {
+            if (entry.seq > seq) {
+                os << entry.to_json().dump() << '\n';
+            }
+        }
+    }
+    io::rename(tmp_path, path);
+}
+}
+}
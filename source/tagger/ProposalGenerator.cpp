@@ -0,0 +1,307 @@
+
+#include "ProposalGenerator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <sstream>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#ifdef HAVE_OPENCV_DNN
+#include <opencv2/dnn.hpp>
+#endif
+
+#include "Stats.h"
+#include "TagGrid.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+
+NetInputShape parseInputShape(const std::string & deploy_path) {
+    std::ifstream is(deploy_path);
+    ASSERT(is.good(), "Could not open " << deploy_path);
+    // the newer `input_shape { dim: ... }` and the old `input_dim: ...` syntax
+    const std::regex dim_regex("^\\s*(input_dim|dim)\\s*:\\s*(\\d+)");
+    std::vector<int> dims;
+    std::string line;
+    std::smatch match;
+    while(std::getline(is, line) && dims.size() < 4) {
+        if (line.find("layer") != std::string::npos) {
+            break;
+        }
+        if (std::regex_search(line, match, dim_regex)) {
+            dims.push_back(std::stoi(match[2]));
+        }
+    }
+    ASSERT(dims.size() == 4, "Expected 4 input dimensions in " << deploy_path
+           << ". But got " << dims.size());
+    return NetInputShape{dims[0], dims[1], dims[2], dims[3]};
+}
+
+std::vector<cv::Rect> candidateWindows(cv::Size image_size, int stride) {
+    ASSERT(stride > 0, "The stride must be positive.");
+    std::vector<cv::Rect> windows;
+    for(int y = TAG_HEIGHT/2; y + TAG_HEIGHT/2 <= image_size.height; y += stride) {
+        for(int x = TAG_WIDTH/2; x + TAG_WIDTH/2 <= image_size.width; x += stride) {
+            windows.push_back(tagBoxForCenter(cv::Point2i(x, y)));
+        }
+    }
+    return windows;
+}
+
+std::vector<Tag> nonMaximumSuppression(std::vector<ScoredWindow> windows,
+                                       float threshold, int min_distance) {
+    windows.erase(std::remove_if(windows.begin(), windows.end(),
+                                 [&](const ScoredWindow & w) { return w.score < threshold; }),
+                  windows.end());
+    std::stable_sort(windows.begin(), windows.end(),
+                     [](const ScoredWindow & a, const ScoredWindow & b) { return a.score > b.score; });
+    TagGrid kept;
+    std::vector<Tag> tags;
+    const int d2 = min_distance*min_distance;
+    for(const auto & window : windows) {
+        Tag tag(window.box);
+        const cv::Point2i c = tag.center();
+        cv::Rect around(c.x - min_distance - TAG_WIDTH/2, c.y - min_distance - TAG_HEIGHT/2,
+                        2*min_distance + TAG_WIDTH, 2*min_distance + TAG_HEIGHT);
+        bool suppressed = false;
+        for(const Tag * other : kept.query(around)) {
+            cv::Point2i diff = other->center() - c;
+            if (diff.dot(diff) < d2) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) {
+            kept.insert(tag);
+            tags.push_back(std::move(tag));
+        }
+    }
+    return tags;
+}
+
+unsigned int borderForInput(const NetInputShape & shape) {
+    return static_cast<unsigned int>(std::max(0, (shape.width - TAG_WIDTH) / 2));
+}
+
+namespace {
+
+size_t matchingBrace(const std::string & text, size_t open) {
+    int depth = 0;
+    size_t i = open;
+    for(; i < text.size(); i++) {
+        if (text[i] == '{') {
+            depth++;
+        } else if (text[i] == '}' && --depth == 0) {
+            break;
+        }
+    }
+    ASSERT(i < text.size(), "Unbalanced braces in prototxt");
+    return i;
+}
+
+std::string convertLayer(const std::string & layer, const std::map<std::string, cv::Size> & kernels) {
+    static const std::regex type_regex("type\\s*:\\s*\"InnerProduct\"");
+    static const std::regex name_regex("name\\s*:\\s*\"([^\"]+)\"");
+    static const std::regex param_regex("inner_product_param\\s*\\{");
+    if (!std::regex_search(layer, type_regex)) {
+        return layer;
+    }
+    std::smatch match;
+    ASSERT(std::regex_search(layer, match, name_regex), "InnerProduct layer without a name");
+    const std::string name = match[1];
+    ASSERT(kernels.count(name), "No kernel size for layer " << name);
+    const cv::Size kernel = kernels.at(name);
+    std::stringstream param;
+    param << "convolution_param {\n    kernel_h: " << kernel.height
+          << "\n    kernel_w: " << kernel.width;
+    std::string converted = std::regex_replace(layer, type_regex, "type: \"Convolution\"");
+    return std::regex_replace(converted, param_regex, param.str());
+}
+}
+
+std::string fullyConvolutionalPrototxt(const std::string & deploy,
+                                       const std::map<std::string, cv::Size> & kernels) {
+    static const std::regex layer_regex("\\blayers?\\s*\\{");
+    std::string out;
+    size_t pos = 0;
+    std::smatch match;
+    while(std::regex_search(deploy.begin() + pos, deploy.end(), match, layer_regex)) {
+        const size_t begin = pos + match.position(0);
+        const size_t end = matchingBrace(deploy, begin + match.length(0) - 1);
+        out.append(deploy, pos, begin - pos);
+        out.append(convertLayer(deploy.substr(begin, end + 1 - begin), kernels));
+        pos = end + 1;
+    }
+    out.append(deploy, pos, std::string::npos);
+    return out;
+}
+
+std::vector<Tag> peaksToTags(const cv::Mat & heat_map, int stride, cv::Point2i offset,
+                             float threshold, int min_distance) {
+    CV_Assert(heat_map.type() == CV_32F);
+    // only local maxima are candidates, the greedy suppression thins them out
+    const int radius = std::max(1, min_distance / std::max(stride, 1));
+    cv::Mat dilated;
+    cv::dilate(heat_map, dilated, cv::getStructuringElement(
+            cv::MORPH_RECT, cv::Size(2*radius + 1, 2*radius + 1)));
+    std::vector<ScoredWindow> windows;
+    for(int y = 0; y < heat_map.rows; y++) {
+        const float * row = heat_map.ptr<float>(y);
+        const float * max_row = dilated.ptr<float>(y);
+        for(int x = 0; x < heat_map.cols; x++) {
+            if (row[x] >= threshold && row[x] == max_row[x]) {
+                windows.push_back(ScoredWindow{
+                        tagBoxForCenter(offset + cv::Point2i(x*stride, y*stride)), row[x]});
+            }
+        }
+    }
+    return nonMaximumSuppression(std::move(windows), threshold, min_distance);
+}
+
+#ifdef HAVE_OPENCV_DNN
+
+struct TagClassifier::Impl {
+    cv::dnn::Net net;
+};
+
+TagClassifier::TagClassifier(const std::string & deploy_path,
+                             const std::string & weights_path, bool use_gpu) :
+    _impl(std::make_unique<Impl>()),
+    _shape(parseInputShape(deploy_path))
+{
+    _impl->net = cv::dnn::readNetFromCaffe(deploy_path, weights_path);
+    ASSERT(!_impl->net.empty(), "Could not load net " << deploy_path);
+    if (use_gpu) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 2)
+        _impl->net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+        _impl->net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+#else
+        std::cerr << "This OpenCV has no CUDA backend, running on the CPU." << std::endl;
+#endif
+    }
+}
+
+TagClassifier::~TagClassifier() = default;
+
+std::vector<float> TagClassifier::classify(const cv::Mat & blob, size_t n) {
+    ASSERT(blob.dims == 4 && blob.type() == CV_32F && blob.isContinuous() &&
+           static_cast<size_t>(blob.size[0]) >= n, "Expected a continuous N x C x H x W float blob");
+    // only the first n planes, e.g. of the last batch, which is not full
+    const int sizes[4] = {static_cast<int>(n), blob.size[1], blob.size[2], blob.size[3]};
+    const cv::Mat input(4, sizes, CV_32F, const_cast<uchar *>(blob.data));
+    cv::Mat prob;
+    {
+        stats::ScopedTimer timer(stats::Metric::Forward, input.total() * input.elemSize());
+        _impl->net.setInput(input);
+        prob = _impl->net.forward();
+    }
+    // N x 2 probabilities of the softmax layer
+    prob = prob.reshape(1, prob.size[0]);
+    std::vector<float> scores(n);
+    for(size_t i = 0; i < n; i++) {
+        scores[i] = prob.at<float>(static_cast<int>(i), prob.cols - 1);
+    }
+    return scores;
+}
+
+struct FullyConvolutionalLocalizer::Impl {
+    cv::dnn::Net net;
+};
+
+namespace {
+
+cv::dnn::MatShape inputShapeFor(const NetInputShape & shape, int height, int width) {
+    return cv::dnn::MatShape{1, shape.channels, height, width};
+}
+
+cv::dnn::MatShape outputShape(cv::dnn::Net & net, const cv::dnn::MatShape & input) {
+    std::vector<cv::dnn::MatShape> in_shapes, out_shapes;
+    const auto names = net.getLayerNames();
+    net.getLayerShapes(input, net.getLayerId(names.back()), in_shapes, out_shapes);
+    return out_shapes.at(0);
+}
+}
+
+FullyConvolutionalLocalizer::FullyConvolutionalLocalizer(const std::string & deploy_path,
+                                                         const std::string & weights_path,
+                                                         bool use_gpu) :
+    _impl(std::make_unique<Impl>()),
+    _shape(parseInputShape(deploy_path)),
+    _border(borderForInput(_shape))
+{
+    cv::dnn::Net window_net = cv::dnn::readNetFromCaffe(deploy_path, weights_path);
+    ASSERT(!window_net.empty(), "Could not load net " << deploy_path);
+    // the kernel of an InnerProduct layer covers its whole input
+    const auto window_input = inputShapeFor(_shape, _shape.height, _shape.width);
+    std::map<std::string, cv::Size> kernels;
+    std::map<std::string, cv::Mat> weights;
+    for(const auto & name : window_net.getLayerNames()) {
+        const int id = window_net.getLayerId(name);
+        if (window_net.getLayer(id)->type != "InnerProduct") {
+            continue;
+        }
+        std::vector<cv::dnn::MatShape> in_shapes, out_shapes;
+        window_net.getLayerShapes(window_input, id, in_shapes, out_shapes);
+        const auto & in = in_shapes.at(0);
+        cv::Size kernel = in.size() == 4 ? cv::Size(in[3], in[2]) : cv::Size(1, 1);
+        kernels[name] = kernel;
+        cv::Mat w = window_net.getParam(id, 0);
+        const int channels = static_cast<int>(w.total() / w.size[0] / kernel.area());
+        const int sizes[4] = {w.size[0], channels, kernel.height, kernel.width};
+        weights[name] = w.reshape(1, 4, sizes).clone();
+    }
+    std::ifstream is(deploy_path);
+    const std::string deploy((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    const std::string fcn = fullyConvolutionalPrototxt(deploy, kernels);
+
+    std::ifstream weights_is(weights_path, std::ios::binary);
+    const std::string model((std::istreambuf_iterator<char>(weights_is)), std::istreambuf_iterator<char>());
+    _impl->net = cv::dnn::readNetFromCaffe(fcn.data(), fcn.size(), model.data(), model.size());
+    ASSERT(!_impl->net.empty(), "Could not convert net " << deploy_path);
+    for(const auto & w : weights) {
+        _impl->net.setParam(_impl->net.getLayerId(w.first), 0, w.second);
+    }
+    if (use_gpu) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 2)
+        _impl->net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+        _impl->net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+#else
+        std::cerr << "This OpenCV has no CUDA backend, running on the CPU." << std::endl;
+#endif
+    }
+    // the stride follows from how much the output grows with the input
+    const int grow = 4*TAG_WIDTH;
+    const auto single = outputShape(_impl->net, window_input);
+    const auto larger = outputShape(_impl->net, inputShapeFor(_shape, _shape.height, _shape.width + grow));
+    ASSERT(single.size() == 4 && single[3] == 1, "Expected a single window for the input size of " << deploy_path);
+    ASSERT(larger[3] > 1, "The net " << deploy_path << " does not slide over the input");
+    _stride = grow / (larger[3] - 1);
+    _offset = cv::Point2i(_shape.width / 2 - static_cast<int>(_border),
+                          _shape.height / 2 - static_cast<int>(_border));
+}
+
+FullyConvolutionalLocalizer::~FullyConvolutionalLocalizer() = default;
+
+cv::Mat FullyConvolutionalLocalizer::heatMap(const cv::Mat & image) {
+    cv::Mat padded;
+    cv::copyMakeBorder(image, padded, _border, _border, _border, _border, cv::BORDER_REFLECT_101);
+    cv::Mat prob;
+    {
+        stats::ScopedTimer timer(stats::Metric::Forward, padded.total());
+        _impl->net.setInput(cv::dnn::blobFromImage(padded, NET_INPUT_SCALE));
+        prob = _impl->net.forward();
+    }
+    // 1 x 2 x rows x cols, the second channel is the tag class
+    ASSERT(prob.dims == 4 && prob.size[1] == 2, "Expected a probability map with two classes");
+    return cv::Mat(prob.size[2], prob.size[3], CV_32F, prob.ptr<float>(0, 1)).clone();
+}
+
+std::vector<Tag> FullyConvolutionalLocalizer::localize(const cv::Mat & image, float threshold,
+                                                       int min_distance) {
+    return peaksToTags(heatMap(image), _stride, _offset, threshold, min_distance);
+}
+#endif
+}
@@ -0,0 +1,107 @@
+
+#include "Shards.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace io = boost::filesystem;
+
+std::vector<std::string> selectShard(const std::vector<std::string> & paths,
+                                     size_t shard, size_t nb_shards) {
+    ASSERT(shard < nb_shards, "Invalid shard " << shard << "/" << nb_shards);
+    std::vector<std::string> selected;
+    selected.reserve(paths.size() / nb_shards + 1);
+    for(const auto & path : paths) {
+        if (shardOf(path, nb_shards) == shard) {
+            selected.push_back(path);
+        }
+    }
+    return selected;
+}
+
+std::string shardPath(const std::string & path, size_t shard, size_t nb_shards) {
+    io::path p(path);
+    io::path ext = p.extension();
+    p.replace_extension();
+    p += ".shard-" + std::to_string(shard) + "-of-" + std::to_string(nb_shards);
+    p += ext;
+    return p.string();
+}
+
+io::path shardDir(const io::path & dir, size_t shard, size_t nb_shards) {
+    return dir / ("shard-" + std::to_string(shard) + "-of-" + std::to_string(nb_shards));
+}
+
+namespace {
+
+std::vector<std::string> readLines(const std::string & path) {
+    ASSERT(io::exists(path), "File " << path << " does not exists. Did the shard finish?");
+    std::ifstream is(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while(std::getline(is, line)) {
+        if (!line.empty()) {
+            lines.push_back(std::move(line));
+        }
+    }
+    return lines;
+}
+
+size_t writeMerged(const std::string & path, const std::vector<std::string> & shard_paths,
+                   const std::vector<std::string> & order) {
+    std::vector<std::string> lines;
+    for(const auto & shard_path : shard_paths) {
+        auto shard_lines = readLines(shard_path);
+        lines.insert(lines.end(), std::make_move_iterator(shard_lines.begin()),
+                     std::make_move_iterator(shard_lines.end()));
+    }
+    if (!order.empty()) {
+        std::unordered_map<std::string, size_t> position;
+        position.reserve(order.size());
+        for(size_t i = 0; i < order.size(); i++) {
+            position.emplace(order[i], i);
+        }
+        auto positionOf = [&](const std::string & line) {
+            auto it = position.find(line);
+            return it == position.end() ? std::numeric_limits<size_t>::max() : it->second;
+        };
+        std::stable_sort(lines.begin(), lines.end(), [&](const auto & a, const auto & b) {
+            return positionOf(a) < positionOf(b);
+        });
+    }
+    io::path tmp_path = io::unique_path(io::absolute(path).parent_path() / "%%%%%%%%%.txt");
+    {
+        std::ofstream os(tmp_path.string());
+        for(const auto & line : lines) {
+            os << line << '\n';
+        }
+        ASSERT(os.good(), "Could not write " << tmp_path);
+    }
+    io::rename(tmp_path, path);
+    return lines.size();
+}
+}
+
+size_t mergeShardFiles(const std::string & path, size_t nb_shards,
+                       const std::vector<std::string> & order) {
+    std::vector<std::string> shard_paths;
+    for(size_t i = 0; i < nb_shards; i++) {
+        shard_paths.push_back(shardPath(path, i, nb_shards));
+    }
+    return writeMerged(path, shard_paths, order);
+}
+
+size_t mergeShardDirs(const io::path & dir, const std::string & name, size_t nb_shards) {
+    std::vector<std::string> shard_paths;
+    for(size_t i = 0; i < nb_shards; i++) {
+        shard_paths.push_back((shardDir(dir, i, nb_shards) / name).string());
+    }
+    return writeMerged((dir / name).string(), shard_paths, {});
+}
+}
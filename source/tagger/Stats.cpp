@@ -0,0 +1,234 @@
+
+#include "Stats.h"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "utils.h"
+
+namespace deeplocalizer {
+namespace stats {
+
+namespace io = boost::filesystem;
+using json = nlohmann::json;
+using steady_clock = std::chrono::steady_clock;
+
+std::string metric_to_str(Metric metric) {
+    switch (metric) {
+        case Metric::Read:
+            return "read";
+        case Metric::Decode:
+            return "decode";
+        case Metric::Filter:
+            return "filter";
+        case Metric::Encode:
+            return "encode";
+        case Metric::Write:
+            return "write";
+        case Metric::JsonLoad:
+            return "json_load";
+        case Metric::JsonSave:
+            return "json_save";
+        case Metric::Samples:
+            return "samples";
+        case Metric::Forward:
+            return "forward";
+        default:
+            ASSERT(false, "unknown metric " << static_cast<int>(metric));
+            return "";
+    }
+}
+
+namespace {
+
+struct Slot {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+struct ThreadSlots {
+    std::array<Slot, NB_METRICS> slots;
+};
+
+struct Registry {
+    std::mutex mutex;
+    // the slots of exited threads are kept, so their samples stay counted
+    std::vector<std::shared_ptr<ThreadSlots>> threads;
+    steady_clock::time_point start = steady_clock::now();
+};
+
+Registry & registry() {
+    static Registry registry;
+    return registry;
+}
+
+ThreadSlots & localSlots() {
+    static thread_local std::shared_ptr<ThreadSlots> slots = []() {
+        auto slots = std::make_shared<ThreadSlots>();
+        Registry & reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.threads.push_back(slots);
+        return slots;
+    }();
+    return *slots;
+}
+
+// only the owning thread writes a slot, so a plain load and store suffice
+inline void add(std::atomic<uint64_t> & counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+}
+
+void record(Metric metric, uint64_t nanoseconds, uint64_t bytes) {
+    Slot & slot = localSlots().slots[static_cast<size_t>(metric)];
+    add(slot.count, 1);
+    add(slot.nanoseconds, nanoseconds);
+    add(slot.bytes, bytes);
+}
+
+Snapshot snapshot() {
+    Snapshot snapshot;
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for(const auto & thread : reg.threads) {
+        for(size_t i = 0; i < NB_METRICS; i++) {
+            const Slot & slot = thread->slots[i];
+            snapshot.values[i].count += slot.count.load(std::memory_order_relaxed);
+            snapshot.values[i].nanoseconds += slot.nanoseconds.load(std::memory_order_relaxed);
+            snapshot.values[i].bytes += slot.bytes.load(std::memory_order_relaxed);
+        }
+    }
+    snapshot.nb_threads = reg.threads.size();
+    snapshot.elapsed = std::chrono::duration<double>(steady_clock::now() - reg.start).count();
+    return snapshot;
+}
+
+void reset() {
+    Registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for(const auto & thread : reg.threads) {
+        for(auto & slot : thread->slots) {
+            slot.count.store(0, std::memory_order_relaxed);
+            slot.nanoseconds.store(0, std::memory_order_relaxed);
+            slot.bytes.store(0, std::memory_order_relaxed);
+        }
+    }
+    reg.start = steady_clock::now();
+}
+
+json Snapshot::to_json() const {
+    json j;
+    j["elapsed_seconds"] = elapsed;
+    j["threads"] = nb_threads;
+    json metrics = json::object();
+    for(size_t i = 0; i < NB_METRICS; i++) {
+        const Value & value = values[i];
+        if (value.count == 0) {
+            continue;
+        }
+        json metric;
+        metric["count"] = value.count;
+        metric["seconds"] = value.nanoseconds * 1e-9;
+        metric["mean_ms"] = value.nanoseconds * 1e-6 / value.count;
+        metric["bytes"] = value.bytes;
+        metrics[metric_to_str(static_cast<Metric>(i))] = metric;
+    }
+    j["metrics"] = metrics;
+    return j;
+}
+
+std::string Snapshot::to_prometheus() const {
+    std::stringstream ss;
+    auto family = [&](const std::string & name, const std::string & help, auto field) {
+        ss << "# HELP deeplocalizer_" << name << " " << help << "\n";
+        ss << "# TYPE deeplocalizer_" << name << " counter\n";
+        for(size_t i = 0; i < NB_METRICS; i++) {
+            ss << "deeplocalizer_" << name << "{stage=\""
+               << metric_to_str(static_cast<Metric>(i)) << "\"} " << field(values[i]) << "\n";
+        }
+    };
+    family("stage_calls_total", "Number of times a stage ran.",
+           [](const Value & v) { return v.count; });
+    family("stage_seconds_total", "Time spent in a stage, summed over all threads.",
+           [](const Value & v) { return v.nanoseconds * 1e-9; });
+    family("stage_bytes_total", "Bytes processed by a stage.",
+           [](const Value & v) { return v.bytes; });
+    ss << "# HELP deeplocalizer_elapsed_seconds Time since the counters started.\n";
+    ss << "# TYPE deeplocalizer_elapsed_seconds gauge\n";
+    ss << "deeplocalizer_elapsed_seconds " << elapsed << "\n";
+    ss << "# HELP deeplocalizer_threads Number of threads that recorded samples.\n";
+    ss << "# TYPE deeplocalizer_threads gauge\n";
+    ss << "deeplocalizer_threads " << nb_threads << "\n";
+    return ss.str();
+}
+
+void writeFile(const std::string & path) {
+    const Snapshot current = snapshot();
+    const io::path save_path(path);
+    const bool prometheus = save_path.extension() == ".prom";
+    io::path tmp_path = io::unique_path(io::absolute(save_path).parent_path() / "%%%%%%%%%.tmp");
+    {
+        std::ofstream os(tmp_path.string());
+        if (prometheus) {
+            os << current.to_prometheus();
+        } else {
+            os << current.to_json().dump(2) << '\n';
+        }
+        ASSERT(os.good(), "Could not write " << tmp_path);
+    }
+    io::rename(tmp_path, save_path);
+}
+
+PeriodicWriter::PeriodicWriter(std::string path, std::chrono::milliseconds interval) :
+    _path(std::move(path)),
+    _interval(interval),
+    _worker(&PeriodicWriter::workerLoop, this)
+{
+}
+
+PeriodicWriter::~PeriodicWriter() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    _worker.join();
+    try {
+        writeFile(_path);
+    } catch(const std::string & msg) {
+        std::cerr << "Could not write stats: " << msg << std::endl;
+    }
+}
+
+std::unique_ptr<PeriodicWriter> startPeriodicWriter(const std::string & path,
+                                                    double interval_seconds) {
+    auto interval = std::chrono::milliseconds(static_cast<int64_t>(1000 * interval_seconds));
+    return std::make_unique<PeriodicWriter>(path, interval);
+}
+
+void PeriodicWriter::workerLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(!_stop) {
+        if (_interval.count() <= 0) {
+            _wake.wait(lock, [this]() { return _stop; });
+            return;
+        }
+        if (!_wake.wait_for(lock, _interval, [this]() { return _stop; })) {
+            lock.unlock();
+            try {
+                writeFile(_path);
+            } catch(const std::string &) {
+                // the next interval may succeed, e.g. on a network filesystem
+            }
+            lock.lock();
+        }
+    }
+}
+}
+}
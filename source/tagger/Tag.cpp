@@ -72,6 +72,28 @@ cv::Mat Tag::getSubimage(const cv::Mat & orginal, unsigned int border) const {
     return ::deeplocalizer::getSubimage(orginal, _boundingBox, border);
 }
 
+namespace {
+std::vector<cv::Rect> boundingBoxes(const std::vector<Tag> & tags) {
+    std::vector<cv::Rect> boxes;
+    boxes.reserve(tags.size());
+    for(const auto & tag : tags) {
+        boxes.push_back(tag.getBoundingBox());
+    }
+    return boxes;
+}
+}
+
+std::vector<cv::Mat> getSubimageViews(const cv::Mat & orginal, const std::vector<Tag> & tags,
+                                      unsigned int border) {
+    return getSubimageViews(orginal, boundingBoxes(tags), border);
+}
+
+void packSubimages(const cv::Mat & orginal, const std::vector<Tag> & tags,
+                   cv::Mat & blob, cv::Size patch_size,
+                   unsigned int border, double scale) {
+    packSubimages(orginal, boundingBoxes(tags), blob, patch_size, border, scale);
+}
+
 void Tag::draw(QPainter & p, int lineWidth) const {
     auto bb = _boundingBox;
     auto set_pen = [&](double width) {
@@ -142,7 +164,7 @@ json Tag::to_json() const {
 
 Tag Tag::from_json(const json &j) {
     cv::Point2i center(j["x"], j["y"]);
-    cv::Rect boundingBox(center.x - TAG_WIDTH/2, center.y - TAG_WIDTH/2,
+    cv::Rect boundingBox(center.x - TAG_WIDTH/2, center.y - TAG_HEIGHT/2,
                            TAG_WIDTH, TAG_HEIGHT);
     Tag tag(boundingBox);
     tag.setType(tagtype_from_string(j["tagtype"]));
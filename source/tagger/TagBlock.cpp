@@ -0,0 +1,128 @@
+
+#include "TagBlock.h"
+
+#include "DescriptorStore.h"
+
+namespace deeplocalizer {
+
+Tag TagBlock::TagRef::toTag() const {
+    Tag tag(getBoundingBox());
+    tag.setId(id());
+    tag.setType(type());
+    return tag;
+}
+
+TagBlock::TagBlock(const std::vector<Tag> & tags) {
+    appendImage(tags);
+}
+
+TagBlock TagBlock::fromStore(const DescriptorStore & store) {
+    TagBlock block;
+    block.reserve(store.nbTags());
+    block._image_offsets.reserve(store.size() + 1);
+    for(size_t i = 0; i < store.size(); i++) {
+        for(auto tag = store.tagsBegin(i); tag != store.tagsEnd(i); tag++) {
+            block._xs.push_back(tag->x);
+            block._ys.push_back(tag->y);
+            block._types.push_back(tag->type);
+            block._ids.push_back(0);
+        }
+        block._image_offsets.push_back(block.size());
+    }
+    return block;
+}
+
+void TagBlock::reserve(size_t nb_tags) {
+    _xs.reserve(nb_tags);
+    _ys.reserve(nb_tags);
+    _types.reserve(nb_tags);
+    _ids.reserve(nb_tags);
+}
+
+void TagBlock::clear() {
+    _xs.clear();
+    _ys.clear();
+    _types.clear();
+    _ids.clear();
+    _image_offsets.assign(1, 0);
+}
+
+void TagBlock::push_back(const Tag & tag) {
+    const cv::Point2i c = tag.center();
+    _xs.push_back(c.x);
+    _ys.push_back(c.y);
+    _types.push_back(static_cast<uint8_t>(tag.type()));
+    _ids.push_back(tag.id());
+    if (nbImages() == 0) {
+        _image_offsets.push_back(0);
+    }
+    _image_offsets.back() = size();
+}
+
+void TagBlock::appendImage(const std::vector<Tag> & tags) {
+    _image_offsets.push_back(size());
+    for(const auto & tag : tags) {
+        push_back(tag);
+    }
+}
+
+std::vector<Tag> TagBlock::toTags() const {
+    std::vector<Tag> tags;
+    tags.reserve(size());
+    for(size_t i = 0; i < size(); i++) {
+        tags.push_back((*this)[i].toTag());
+    }
+    return tags;
+}
+
+std::array<size_t, TagBlock::NB_TYPES> TagBlock::countByType() const {
+    std::array<size_t, NB_TYPES> counts{};
+    const uint8_t * types = _types.data();
+    const size_t n = _types.size();
+    // one pass per type over the bytes vectorizes, a histogram does not
+    for(size_t t = 0; t < NB_TYPES; t++) {
+        size_t count = 0;
+        for(size_t i = 0; i < n; i++) {
+            count += types[i] == t;
+        }
+        counts[t] = count;
+    }
+    return counts;
+}
+
+std::vector<uint32_t> TagBlock::select(TagType type) const {
+    std::vector<uint32_t> indices;
+    const uint8_t t = static_cast<uint8_t>(type);
+    for(size_t i = 0; i < _types.size(); i++) {
+        if (_types[i] == t) {
+            indices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return indices;
+}
+
+std::vector<uint32_t> TagBlock::select(const cv::Rect & rect) const {
+    std::vector<uint32_t> indices;
+    const int32_t x0 = rect.x, x1 = rect.x + rect.width;
+    const int32_t y0 = rect.y, y1 = rect.y + rect.height;
+    for(size_t i = 0; i < _xs.size(); i++) {
+        if (_xs[i] >= x0 && _xs[i] < x1 && _ys[i] >= y0 && _ys[i] < y1) {
+            indices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return indices;
+}
+
+TagBlock TagBlock::gather(const std::vector<uint32_t> & indices) const {
+    TagBlock block;
+    block.reserve(indices.size());
+    for(uint32_t i : indices) {
+        block._xs.push_back(_xs[i]);
+        block._ys.push_back(_ys[i]);
+        block._types.push_back(_types[i]);
+        block._ids.push_back(_ids[i]);
+    }
+    block._image_offsets.push_back(block.size());
+    return block;
+}
+}
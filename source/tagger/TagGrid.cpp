@@ -0,0 +1,117 @@
+
+#include "TagGrid.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace deeplocalizer {
+
+TagGrid::TagGrid(int cell_size) : _cell_size(std::max(cell_size, 1)) {
+}
+
+void TagGrid::clear() {
+    _entries.clear();
+    _cells.clear();
+}
+
+int TagGrid::cellCoord(int x) const {
+    // rounds towards negative infinity for tags partly outside the image
+    return x >= 0 ? x / _cell_size : -((-x - 1) / _cell_size) - 1;
+}
+
+TagGrid::cell_key_t TagGrid::cellKey(int cell_x, int cell_y) {
+    return (static_cast<cell_key_t>(cell_x) << 32) ^ static_cast<uint32_t>(cell_y);
+}
+
+template<typename Fn>
+void TagGrid::forEachCell(const cv::Rect & rect, Fn fn) const {
+    if (rect.width <= 0 || rect.height <= 0) {
+        return;
+    }
+    const int last_x = cellCoord(rect.x + rect.width - 1);
+    const int last_y = cellCoord(rect.y + rect.height - 1);
+    for(int y = cellCoord(rect.y); y <= last_y; y++) {
+        for(int x = cellCoord(rect.x); x <= last_x; x++) {
+            fn(cellKey(x, y));
+        }
+    }
+}
+
+void TagGrid::insert(const Tag & tag) {
+    erase(tag.id());
+    _entries.emplace(tag.id(), Entry{tag, _next_seq++});
+    forEachCell(tag.getBoundingBox(), [&](cell_key_t key) {
+        _cells[key].push_back(tag.id());
+    });
+}
+
+bool TagGrid::erase(unsigned long id) {
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        return false;
+    }
+    forEachCell(it->second.tag.getBoundingBox(), [&](cell_key_t key) {
+        auto cell = _cells.find(key);
+        auto & ids = cell->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        if (ids.empty()) {
+            _cells.erase(cell);
+        }
+    });
+    _entries.erase(it);
+    return true;
+}
+
+boost::optional<Tag> TagGrid::at(int x, int y) const {
+    if (const Tag * tag = find(x, y)) {
+        return *tag;
+    }
+    return boost::optional<Tag>();
+}
+
+const Tag * TagGrid::find(int x, int y) const {
+    auto cell = _cells.find(cellKey(cellCoord(x), cellCoord(y)));
+    if (cell == _cells.end()) {
+        return nullptr;
+    }
+    const Entry * found = nullptr;
+    for(unsigned long id : cell->second) {
+        const Entry & entry = _entries.at(id);
+        if (entry.tag.getBoundingBox().contains(cv::Point(x, y)) &&
+                (!found || entry.seq < found->seq)) {
+            found = &entry;
+        }
+    }
+    if (!found) {
+        return nullptr;
+    }
+    return &found->tag;
+}
+
+std::vector<const Tag *> TagGrid::query(const cv::Rect & rect) const {
+    std::vector<const Entry *> found;
+    forEachCell(rect, [&](cell_key_t key) {
+        auto cell = _cells.find(key);
+        if (cell == _cells.end()) {
+            return;
+        }
+        for(unsigned long id : cell->second) {
+            const Entry & entry = _entries.at(id);
+            if ((entry.tag.getBoundingBox() & rect).area() > 0) {
+                found.push_back(&entry);
+            }
+        }
+    });
+    // a tag overlapping several cells is found once per cell
+    std::sort(found.begin(), found.end(), [](const Entry * a, const Entry * b) {
+        return a->seq < b->seq;
+    });
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    std::vector<const Tag *> tags;
+    tags.reserve(found.size());
+    for(const Entry * entry : found) {
+        tags.push_back(&entry->tag);
+    }
+    return tags;
+}
+}
@@ -0,0 +1,172 @@
+
+#include "ThumbnailCache.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <QDebug>
+
+#include "Image.h"
+#include "utils.h"
+
+namespace deeplocalizer {
+
+namespace io = boost::filesystem;
+
+ThumbnailCache::ThumbnailCache(const io::path & dir, int max_side) :
+    _dir(dir),
+    _max_side(max_side)
+{
+    ASSERT(max_side > 0, "The thumbnail size must be positive. But got: " << max_side);
+    io::create_directories(_dir);
+    _worker = std::thread(&ThumbnailCache::workerLoop, this);
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _requests.clear();
+        _background.clear();
+    }
+    _work.notify_all();
+    _worker.join();
+}
+
+void ThumbnailCache::setCallback(callback_t callback) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    // the callback itself may replace the callback
+    if (std::this_thread::get_id() != _worker.get_id()) {
+        _callback_done.wait(lock, [this]() { return !_in_callback; });
+    }
+    _callback = std::move(callback);
+}
+
+void ThumbnailCache::request(const std::string & filename) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_requested.insert(filename).second) {
+            return;
+        }
+        _requests.push_back(filename);
+    }
+    _work.notify_one();
+}
+
+void ThumbnailCache::generate(std::vector<std::string> filenames) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _background.assign(std::make_move_iterator(filenames.begin()),
+                           std::make_move_iterator(filenames.end()));
+    }
+    _work.notify_one();
+}
+
+cv::Mat ThumbnailCache::get(const std::string & filename) {
+    return load(filename, false);
+}
+
+io::path ThumbnailCache::path(const std::string & filename) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.jpeg",
+                  static_cast<unsigned long long>(stableHash(filename)));
+    return _dir / name;
+}
+
+size_t ThumbnailCache::pending() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requests.size() + _background.size();
+}
+
+cv::Mat ThumbnailCache::makeThumbnail(const cv::Mat & image, int max_side) {
+    const int side = std::max(image.cols, image.rows);
+    if (side <= max_side) {
+        return image.clone();
+    }
+    const double scale = static_cast<double>(max_side) / side;
+    cv::Mat thumbnail;
+    cv::resize(image, thumbnail, cv::Size(), scale, scale, cv::INTER_AREA);
+    return thumbnail;
+}
+
+cv::Mat ThumbnailCache::load(const std::string & filename, bool only_missing) {
+    const io::path thumbnail_path = path(filename);
+    if (io::exists(thumbnail_path)) {
+        if (only_missing) {
+            return cv::Mat();
+        }
+        cv::Mat thumbnail = cv::imread(thumbnail_path.string(), cv::IMREAD_GRAYSCALE);
+        if (!thumbnail.empty()) {
+            return thumbnail;
+        }
+    }
+    if (!io::exists(filename)) {
+        return cv::Mat();
+    }
+    // a thumbnail needs only a fraction of the pixels, so let the jpeg
+    // decoder skip most of them
+    const auto buffer = Image::readFile(filename);
+    DecodeOptions opt;
+    opt.reduction = 8;
+    cv::Mat image = Image::decode(buffer, opt);
+    if (!image.empty() && std::max(image.cols, image.rows) < _max_side) {
+        image = Image::decode(buffer);
+    }
+    if (image.empty()) {
+        return cv::Mat();
+    }
+    cv::Mat thumbnail = makeThumbnail(image, _max_side);
+    // other sessions may read the cache at the same time
+    io::path tmp_path = io::unique_path(_dir / "%%%%%%%%%.tmp.jpeg");
+    if (cv::imwrite(tmp_path.string(), thumbnail)) {
+        io::rename(tmp_path, thumbnail_path);
+    }
+    return thumbnail;
+}
+
+void ThumbnailCache::workerLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true) {
+        _work.wait(lock, [this]() {
+            return _stop || !_requests.empty() || !_background.empty();
+        });
+        if (_stop) {
+            return;
+        }
+        std::string filename;
+        bool requested = !_requests.empty();
+        if (requested) {
+            filename = std::move(_requests.back());
+            _requests.pop_back();
+        } else {
+            filename = std::move(_background.front());
+            _background.pop_front();
+        }
+        lock.unlock();
+        cv::Mat thumbnail;
+        try {
+            thumbnail = load(filename, !requested);
+        } catch(const std::exception & e) {
+            qWarning() << "[ThumbnailCache] " << e.what();
+        } catch(const std::string & msg) {
+            qWarning() << "[ThumbnailCache] " << QString::fromStdString(msg);
+        }
+        lock.lock();
+        if (requested) {
+            _requested.erase(filename);
+        }
+        if (requested && !thumbnail.empty() && _callback) {
+            auto callback = _callback;
+            _in_callback = true;
+            lock.unlock();
+            callback(filename, thumbnail);
+            lock.lock();
+            _in_callback = false;
+            _callback_done.notify_all();
+        }
+    }
+}
+}
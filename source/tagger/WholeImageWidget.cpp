@@ -8,6 +8,7 @@
 #include <QScrollBar>
 #include <QThread>
 #include <QMouseEvent>
+#include <QPaintEvent>
 #include <QtCore/qline.h>
 #include "qt_helper.h"
 
@@ -40,8 +41,8 @@ WholeImageWidget::WholeImageWidget(QScrollArea * parent,
 
 optional<Tag> WholeImageWidget::createTag(int x, int y) {
     if(x < TAG_WIDTH / 2 || y < TAG_HEIGHT / 2 ||
-        x > _pixmap.size().width() - TAG_WIDTH / 2 ||
-        y > _pixmap.size().height() - TAG_HEIGHT / 2
+        x > _mat.cols - TAG_WIDTH / 2 ||
+        y > _mat.rows - TAG_HEIGHT / 2
             ) {
         return optional<Tag>();
     }
@@ -58,20 +59,21 @@ void WholeImageWidget::tagProcessed(Tag tag) {
     }
     eraseTag(tag.id(), _newly_added_tags);
     _tags->push_back(tag);
+    _tag_grid.insert(tag);
     repaint();
 }
 
-void WholeImageWidget::paintEvent(QPaintEvent *) {
-    _pixmap = cvMatToQPixmap(_mat);
+void WholeImageWidget::paintEvent(QPaintEvent * event) {
     _painter.begin(this);
+    _tiles.draw(_painter, event->rect(), _scale);
 
     _painter.scale(_scale, _scale);
-    _painter.drawPixmap(0, 0, _pixmap);
-    for(auto & t: *_tags) {
-        t.draw(_painter);
-    }
-    for(auto & t: _newly_added_tags) {
-        t.draw(_painter);
+    // the exposed region in image coordinates plus the width of the pen
+    QRectF exposed(event->rect().topLeft() / _scale, event->rect().size() / _scale);
+    QRect visible = exposed.toAlignedRect().adjusted(-2, -2, 2, 2);
+    for(auto t: _tag_grid.query(cv::Rect(visible.x(), visible.y(),
+                                         visible.width(), visible.height()))) {
+        t->draw(_painter);
     }
     _painter.end();
 }
@@ -112,11 +114,11 @@ void WholeImageWidget::zoomInRelToMouse(QPoint mouse_pos) {
     double factor = 1.25;
     auto vert = _parent->verticalScrollBar();
     auto horz = _parent->horizontalScrollBar();
-    auto img_size = _pixmap.size();
+    QSize img_size(_mat.cols, _mat.rows);
     QSize viewport(_parent->viewport()->size());
     if (img_size.width() < viewport.width())  viewport.setWidth(img_size.width());
     if (img_size.height() < viewport.height()) viewport.setHeight(img_size.height());
-    QSize max_viewport(_pixmap.size() - viewport);
+    QSize max_viewport(img_size - viewport);
     QPointF scroll_ratio(horz->value() / double(horz->maximum() - horz->minimum()),
                          vert->value() / double(vert->maximum() - vert->minimum()));
     if (std::isnan(scroll_ratio.x()))  scroll_ratio.setX(0);
@@ -148,46 +150,51 @@ void WholeImageWidget::wheelEvent(QWheelEvent * event) {
 
 void WholeImageWidget::mousePressEvent(QMouseEvent * event) {
     auto pos = event->pos() / _scale;
-    boost::optional<Tag> opt_tag = getTag(pos.x(), pos.y());
-    if (opt_tag) {
-        eraseTag(opt_tag.get().id(), *_tags);
-        eraseTag(opt_tag.get().id(), _newly_added_tags);
+    if (const Tag * hit = getTag(pos.x(), pos.y())) {
+        // erasing invalidates `hit`
+        const unsigned long id = hit->id();
+        eraseTag(id, *_tags);
+        eraseTag(id, _newly_added_tags);
     } else {
         auto modifier = QGuiApplication::queryKeyboardModifiers();
-        opt_tag = createTag(pos.x(), pos.y());
+        boost::optional<Tag> opt_tag = createTag(pos.x(), pos.y());
         if(!opt_tag) return;
-        auto tag = opt_tag.get();
+        Tag & tag = opt_tag.get();
         if (modifier.testFlag(Qt::ControlModifier)) {
             tag.setType(TagType::Exclude);
         } else if (modifier.testFlag(Qt::AltModifier)) {
             tag.setType(TagType::BeeWithoutTag);
         }
-        _tags->push_back(tag);
+        _tag_grid.insert(tag);
+        _tags->push_back(std::move(tag));
     }
     emit changed();
     repaint();
 }
 
-boost::optional<Tag> WholeImageWidget::getTag(int x, int y) {
-    auto getTagIfContainsPoint = [x, y](auto & tags) {
-        cv::Point point(x, y);
-        for(auto & tag : tags) {
-            if(tag.getBoundingBox().contains(point)) {
-                return optional<Tag>(tag);
-            }
-        }
-        return optional<Tag>();
-    };
-    boost::optional<Tag> tag = getTagIfContainsPoint(*_tags);
-    if (tag) {
-        return tag;
-    }
-    return getTagIfContainsPoint(_newly_added_tags);
+const Tag * WholeImageWidget::getTag(int x, int y) const {
+    return _tag_grid.find(x, y);
+}
+
+QScrollBar * WholeImageWidget::horizontalScrollBar() const {
+    return _parent->horizontalScrollBar();
+}
+
+QScrollBar * WholeImageWidget::verticalScrollBar() const {
+    return _parent->verticalScrollBar();
 }
+
+void WholeImageWidget::reindexTags() {
+    _tag_grid.clear();
+    _tag_grid.insert(*_tags);
+    _tag_grid.insert(_newly_added_tags);
+}
+
 void WholeImageWidget::setTags(cv::Mat mat, std::vector<Tag> * tags) {
     _mat = mat;
-    _pixmap = cvMatToQPixmap(mat);
+    _tiles.setImage(mat);
     _tags = tags;
+    reindexTags();
     setFixedSize(sizeHint());
 }
 
@@ -1,7 +1,11 @@
 #include "deeplocalizer_tagger.h"
 
-cv::Mat deeplocalizer::getSubimage(const cv::Mat &orginal, cv::Rect box,
-                                        unsigned int additional_border) {
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "Patch.h"
+
+cv::Rect deeplocalizer::subimageBox(const cv::Mat &orginal, cv::Rect box,
+                                    unsigned int additional_border) {
     box.x -= additional_border;
     box.y -= additional_border;
     box.width += 2*additional_border;
@@ -10,5 +14,45 @@ cv::Mat deeplocalizer::getSubimage(const cv::Mat &orginal, cv::Rect box,
     if(box.y < 0) box.y = 0;
     if(box.width + box.x >= orginal.cols) box.x = orginal.cols - box.width - 1;
     if(box.height + box.y >= orginal.rows) box.y = orginal.rows - box.height - 1;
-    return orginal(box).clone();
+    return box;
+}
+
+cv::Mat deeplocalizer::getSubimage(const cv::Mat &orginal, cv::Rect box,
+                                        unsigned int additional_border) {
+    return orginal(subimageBox(orginal, box, additional_border)).clone();
+}
+
+std::vector<cv::Mat> deeplocalizer::getSubimageViews(const cv::Mat &orginal,
+                                                     const std::vector<cv::Rect> & boxes,
+                                                     unsigned int additional_border) {
+    std::vector<cv::Mat> views;
+    views.reserve(boxes.size());
+    for(const auto & box : boxes) {
+        views.push_back(orginal(subimageBox(orginal, box, additional_border)));
+    }
+    return views;
+}
+
+void deeplocalizer::packSubimages(const cv::Mat &orginal, const std::vector<cv::Rect> & boxes,
+                                  cv::Mat & blob, cv::Size patch_size,
+                                  unsigned int additional_border, double scale) {
+    const int sizes[4] = {static_cast<int>(boxes.size()), 1, patch_size.height, patch_size.width};
+    blob.create(4, sizes, CV_32F);
+    for(size_t i = 0; i < boxes.size(); i++) {
+        packSubimage(orginal, boxes[i], blob.ptr<float>(static_cast<int>(i)),
+                     patch_size, additional_border, scale);
+    }
+}
+
+void deeplocalizer::packSubimage(const cv::Mat &orginal, cv::Rect box, float * dst,
+                                 cv::Size patch_size, unsigned int additional_border,
+                                 double scale) {
+    CV_Assert(orginal.channels() == 1);
+    cv::Mat view = orginal(subimageBox(orginal, box, additional_border));
+    if (view.size() != patch_size) {
+        cv::Mat resized;
+        cv::resize(view, resized, patch_size, 0, 0, cv::INTER_AREA);
+        view = resized;
+    }
+    packPatch(view, dst, static_cast<float>(scale));
 }
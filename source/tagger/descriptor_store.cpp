@@ -0,0 +1,78 @@
+#include <boost/program_options.hpp>
+
+#include "DescriptorStore.h"
+#include "ManuallyTagger.h"
+#include "TagBlock.h"
+#include "utils.h"
+
+using namespace deeplocalizer;
+
+namespace po = boost::program_options;
+namespace io = boost::filesystem;
+
+po::options_description desc_option("Options");
+po::positional_options_description positional_opt;
+
+void setupOptions() {
+    desc_option.add_options()
+            ("help,h", "Print help messages")
+            ("to-binary",   po::value<std::string>(),
+                 "Pathfile of images. Writes their json descriptors to the binary store given by --store")
+            ("to-json",     po::value<bool>()->default_value(false),
+                 "Write a json descriptor next to every image of the binary store given by --store")
+            ("stats",       "Print the number of tags of every type in the store given by --store")
+            ("store,s",     po::value<std::string>(), "Path to the binary descriptor store")
+            ("extension,e", po::value<std::string>()->default_value(ManuallyTagger::IMAGE_DESC_EXT),
+                 "Extension of the json descriptors, e.g. `tagger.json` or `proposal.json`");
+}
+
+void printUsage() {
+    std::cout << "Usage: bb_descriptor_store --to-binary pathfile.txt --store images.store" << std::endl;
+    std::cout << "       bb_descriptor_store --to-json 1 --store images.store" << std::endl;
+    std::cout << "       bb_descriptor_store --stats --store images.store" << std::endl;
+    std::cout << desc_option << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    setupOptions();
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc_option)
+                      .positional(positional_opt).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        printUsage();
+        return 0;
+    }
+    if (!vm.count("store")) {
+        std::cout << "No descriptor store given." << std::endl;
+        printUsage();
+        return 1;
+    }
+    const std::string store_path = vm.at("store").as<std::string>();
+    const std::string extension = vm.at("extension").as<std::string>();
+    if (vm.count("to-binary")) {
+        DescriptorStore::fromPathFile(vm.at("to-binary").as<std::string>(), extension, store_path);
+        DescriptorStore store(store_path);
+        std::cout << "Saved " << store.size() << " images with " << store.nbTags()
+                  << " tags to " << store_path << std::endl;
+    } else if (vm.at("to-json").as<bool>()) {
+        DescriptorStore store(store_path);
+        store.exportJson(extension);
+        std::cout << "Saved json descriptors of " << store.size() << " images." << std::endl;
+    } else if (vm.count("stats")) {
+        DescriptorStore store(store_path);
+        TagBlock block = TagBlock::fromStore(store);
+        auto counts = block.countByType();
+        std::cout << store.size() << " images with " << block.size() << " tags" << std::endl;
+        for(size_t t = 0; t < TagBlock::NB_TYPES; t++) {
+            std::cout << "    " << tagtype_to_string(static_cast<TagType>(t)) << ": "
+                      << counts[t] << std::endl;
+        }
+    } else {
+        printUsage();
+        return 1;
+    }
+    return 0;
+}
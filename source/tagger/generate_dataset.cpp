@@ -0,0 +1,324 @@
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "Image.h"
+#include "BoundedQueue.h"
+#include "DatasetGenerator.h"
+#include "DatasetWriter.h"
+#include "Shards.h"
+#include "Stats.h"
+#include "utils.h"
+
+using namespace deeplocalizer;
+using namespace std::chrono;
+namespace po = boost::program_options;
+namespace io = boost::filesystem;
+
+po::options_description desc_option("Options");
+po::positional_options_description positional_opt;
+
+void setupOptions() {
+    desc_option.add_options()
+            ("help,h", "Print help messages")
+            ("pathfile",        po::value<std::vector<std::string>>(), "File with paths to tagged images")
+            ("format,f",        po::value<std::string>()->default_value("images"),
+                 "Output format. `images`, `lmdb` or `hdf5`")
+            ("output-dir,o",    po::value<std::string>(), "Write the dataset to this directory")
+            ("test-ratio",      po::value<double>()->default_value(DatasetGenerator::TEST_RATIO_DEFAULT),
+                 "Fraction of the images whose samples go to the test set")
+            ("sample-rate",     po::value<size_t>()->default_value(0),
+                 "Number of rotated and translated samples per tag. 0 uses every tag once as it is.")
+            ("ratio-true-to-false", po::value<double>()->default_value(RATIO_TRUE_TO_FALSE_SAMPLES_DEFAULT),
+                 "Ratio of positive to negative samples, if samples are augmented")
+            ("ratio-around-to-uniform", po::value<double>()->default_value(RATIO_AROUND_TO_UNIFORM_DEFAULT),
+                 "Fraction of the generated negative samples taken close to a tag, the others are uniformly distributed")
+            ("no-rotation",     "Only translate augmented samples")
+            ("seed",            po::value<uint64_t>()->default_value(0),
+                 "Seed of the augmentation. The same seed produces the same dataset.")
+            ("patch-size",      po::value<int>()->default_value(PATCH_SIZE_DEFAULT),
+                 "Width and height of the samples, centered on the tags. 64, 100 and 128 are the fastest.")
+            ("batch-size",      po::value<size_t>()->default_value(1024),
+                 "Number of samples written at once. Samples are shuffled within a batch.")
+            ("max-file-mb",     po::value<size_t>()->default_value(1024),
+                 "Start a new LMDB database or HDF5 file after this many megabytes")
+            ("compression,c",   po::value<int>()->default_value(4), "Deflate level of the HDF5 files")
+            ("threads,j",       po::value<size_t>()->default_value(0),
+                 "Number of threads that extract samples. Default is one per CPU core.")
+            ("io-threads",      po::value<size_t>()->default_value(2),
+                 "Number of threads that read and decode images.")
+            ("queue-depth",     po::value<size_t>()->default_value(8),
+                 "Maximum number of images waiting between two pipeline stages. Caps the memory usage.")
+            ("shard",           po::value<std::string>(),
+                 "Only use the images of shard i/N. The dataset is written to "
+                 "<output_dir>/shard-i-of-N")
+            ("merge",           po::value<size_t>(),
+                 "Combine the train.txt and test.txt of N finished shards in the output directory")
+            ("metrics",         po::value<std::string>(),
+                 "Write timings and counters of the stages to this file at the end. "
+                 "Files ending with .prom use the Prometheus text format, otherwise json.")
+            ("metrics-interval", po::value<double>()->default_value(0),
+                 "Also write the metrics file every this many seconds");
+    positional_opt.add("pathfile", 1);
+}
+
+struct Samples {
+    size_t idx;
+    Phase phase;
+    std::vector<TrainDatum> data;
+};
+
+struct DecodedImage {
+    size_t idx;
+    Image image;
+};
+
+template<typename Fn>
+std::vector<std::thread> startStage(size_t nb_threads, Fn fn) {
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < std::max<size_t>(nb_threads, 1); i++) {
+        threads.emplace_back(fn);
+    }
+    return threads;
+}
+
+void joinStage(std::vector<std::thread> & threads) {
+    for(auto & thread : threads) {
+        thread.join();
+    }
+}
+
+// decode -> extract samples -> write. Only one thread writes, so the
+// writers need no locking. The samples are batched in the order of the
+// images, not in the order the threads finish them, so the same seed gives
+// the same dataset. The readers stay at most `window` images ahead of the
+// writer, so at most that many images and one batch per phase are in
+// memory at once.
+// If a stage throws, all stages stop and the first exception is rethrown
+// after they joined.
+size_t generateDataset(const std::vector<ImageDesc> & image_descs,
+                       DatasetWriter & writer,
+                       const DatasetGenerator & generator,
+                       size_t nb_threads, size_t nb_io_threads,
+                       size_t queue_depth, size_t batch_size, uint64_t seed) {
+    auto start_time = system_clock::now();
+    printProgress(start_time, 0);
+    std::mutex cout_mutex;
+    std::atomic<size_t> next_idx(0);
+    BoundedQueue<DecodedImage> decoded(queue_depth);
+    BoundedQueue<Samples> extracted(queue_depth);
+
+    const size_t window = 2*queue_depth + std::max<size_t>(nb_threads, 1) +
+                          std::max<size_t>(nb_io_threads, 1);
+    std::mutex order_mutex;
+    std::condition_variable order_changed;
+    // number of images whose samples are batched
+    size_t nb_batched = 0;
+    std::atomic<bool> failed(false);
+    std::exception_ptr exception;
+    // must be called in a catch block
+    auto fail = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+            failed = true;
+        }
+        order_changed.notify_all();
+        decoded.close();
+        extracted.close();
+    };
+
+    auto readers = startStage(nb_io_threads, [&]() {
+        try {
+            for(size_t i = next_idx++; i < image_descs.size() && !failed; i = next_idx++) {
+                {
+                    std::unique_lock<std::mutex> lock(order_mutex);
+                    order_changed.wait(lock, [&]() { return failed || i < nb_batched + window; });
+                }
+                if (failed) {
+                    break;
+                }
+                DecodedImage item{i, Image()};
+                try {
+                    item.image = Image(image_descs.at(i), DecodeOptions());
+                } catch(const std::string & msg) {
+                    // e.g. a missing file
+                    std::lock_guard<std::mutex> lock(cout_mutex);
+                    std::cerr << msg << std::endl;
+                }
+                if (item.image.getCvMat().empty()) {
+                    std::lock_guard<std::mutex> lock(cout_mutex);
+                    std::cerr << "Fail to read image : " << image_descs.at(i).filename << std::endl;
+                }
+                // also without pixels, so the writer does not wait for it
+                decoded.push(std::move(item));
+            }
+        } catch(...) {
+            fail();
+        }
+    });
+    auto workers = startStage(nb_threads, [&]() {
+        try {
+            while(auto item = decoded.pop()) {
+                const auto & desc = image_descs.at(item->idx);
+                Samples samples{item->idx, generator.phase(desc.filename), {}};
+                if (!item->image.getCvMat().empty()) {
+                    samples.data = generator.samples(item->image.getCvMat(), desc);
+                }
+                extracted.push(std::move(samples));
+            }
+        } catch(...) {
+            fail();
+        }
+    });
+    size_t nb_samples = 0;
+    std::thread write_thread([&]() {
+        try {
+            std::mt19937_64 rng(seed);
+            std::vector<TrainDatum> batches[2];
+            auto flush = [&](Phase phase) {
+                auto & batch = batches[static_cast<int>(phase)];
+                std::shuffle(batch.begin(), batch.end(), rng);
+                stats::ScopedTimer timer(stats::Metric::Write);
+                writer.write(batch, phase);
+                nb_samples += batch.size();
+                batch.clear();
+            };
+            // samples of images that were done before an earlier image
+            std::map<size_t, Samples> pending;
+            size_t next = 0;
+            while(auto samples = extracted.pop()) {
+                pending.emplace(samples->idx, std::move(*samples));
+                while(!pending.empty() && pending.begin()->first == next) {
+                    Samples & in_order = pending.begin()->second;
+                    auto & batch = batches[static_cast<int>(in_order.phase)];
+                    for(auto & datum : in_order.data) {
+                        batch.push_back(std::move(datum));
+                        if (batch.size() >= batch_size) {
+                            flush(in_order.phase);
+                        }
+                    }
+                    pending.erase(pending.begin());
+                    next++;
+                    {
+                        std::lock_guard<std::mutex> lock(order_mutex);
+                        nb_batched = next;
+                    }
+                    order_changed.notify_all();
+                    std::lock_guard<std::mutex> lock(cout_mutex);
+                    printProgress(start_time, static_cast<double>(next) / image_descs.size());
+                }
+            }
+            if (!failed) {
+                for(Phase phase : {Phase::Train, Phase::Test}) {
+                    if (!batches[static_cast<int>(phase)].empty()) {
+                        flush(phase);
+                    }
+                }
+                writer.close();
+            }
+        } catch(...) {
+            fail();
+        }
+    });
+    joinStage(readers);
+    decoded.close();
+    joinStage(workers);
+    extracted.close();
+    write_thread.join();
+    std::cout << std::endl;
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+    return nb_samples;
+}
+
+void printUsage() {
+    std::cout << "Usage: generate_dataset [options] -o output_dir pathfile.txt "<< std::endl;
+    std::cout << "    where pathfile.txt contains paths to tagged images."<< std::endl;
+    std::cout << desc_option << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    setupOptions();
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc_option)
+                      .positional(positional_opt).run(), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        printUsage();
+        return 0;
+    }
+    if (vm.count("merge") && vm.count("output-dir")) {
+        io::path output_dir = vm.at("output-dir").as<std::string>();
+        const size_t nb_shards = vm.at("merge").as<size_t>();
+        for(Phase phase : {Phase::Train, Phase::Test}) {
+            const std::string list = phase_to_str(phase) + ".txt";
+            size_t nb_lines = mergeShardDirs(output_dir, list, nb_shards);
+            std::cout << "Merged " << nb_lines << " lines of " << nb_shards << " shards into "
+                      << (output_dir / list).string() << std::endl;
+        }
+        return 0;
+    }
+    if (!vm.count("pathfile") || !vm.count("output-dir")) {
+        std::cout << "No pathfile or output_dir are given" << std::endl;
+        printUsage();
+        return 1;
+    }
+    std::string pathfile = vm.at("pathfile").as<std::vector<std::string>>().at(0);
+    io::path output_dir = vm.at("output-dir").as<std::string>();
+    DatasetFormat format = str_to_dataset_format(vm.at("format").as<std::string>());
+
+    DatasetWriterOptions opt;
+    opt.max_file_bytes = vm.at("max-file-mb").as<size_t>() * 1024 * 1024;
+    opt.compression = vm.at("compression").as<int>();
+    size_t batch_size = std::max<size_t>(vm.at("batch-size").as<size_t>(), 1);
+    opt.chunk_size = std::min(opt.chunk_size, batch_size);
+    size_t nb_threads = vm.at("threads").as<size_t>();
+    if (nb_threads == 0) {
+        nb_threads = defaultNbThreads();
+    }
+
+    auto paths = ImageDesc::readPathFile(pathfile);
+    if (vm.count("shard")) {
+        // the writers number their files per directory, so every shard gets its own
+        auto shard = parseShard(vm.at("shard").as<std::string>());
+        paths = selectShard(paths, shard.first, shard.second);
+        output_dir = shardDir(output_dir, shard.first, shard.second);
+    }
+    auto image_descs = ImageDesc::fromPaths(paths, "tagger.json");
+    AugmentationOptions augmentation;
+    augmentation.sample_rate = vm.at("sample-rate").as<size_t>();
+    augmentation.ratio_true_to_false = vm.at("ratio-true-to-false").as<double>();
+    augmentation.ratio_around_to_uniform = vm.at("ratio-around-to-uniform").as<double>();
+    augmentation.rotate = vm.count("no-rotation") == 0;
+    augmentation.seed = vm.at("seed").as<uint64_t>();
+    augmentation.patch_size = vm.at("patch-size").as<int>();
+    DatasetGenerator generator(vm.at("test-ratio").as<double>(), augmentation);
+    auto writer = DatasetWriter::create(format, output_dir, opt);
+    std::unique_ptr<stats::PeriodicWriter> metrics;
+    if (vm.count("metrics")) {
+        metrics = stats::startPeriodicWriter(vm.at("metrics").as<std::string>(),
+                                             vm.at("metrics-interval").as<double>());
+    }
+    auto start = system_clock::now();
+    size_t nb_samples = generateDataset(image_descs, *writer, generator, nb_threads,
+                                        vm.at("io-threads").as<size_t>(),
+                                        vm.at("queue-depth").as<size_t>(), batch_size,
+                                        augmentation.seed);
+    duration<double> elapsed = system_clock::now() - start;
+    std::cout << "Wrote " << nb_samples << " samples to " << output_dir.string()
+              << " in " << elapsed.count() << "s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,327 @@
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Image.h"
+#include "BoundedQueue.h"
+#include "ProposalGenerator.h"
+#include "Stats.h"
+#include "utils.h"
+
+using namespace deeplocalizer;
+using namespace std::chrono;
+namespace po = boost::program_options;
+
+po::options_description desc_option("Options");
+po::positional_options_description positional_opt;
+
+void setupOptions() {
+    desc_option.add_options()
+            ("help,h", "Print help messages")
+            ("pathfile",        po::value<std::vector<std::string>>(), "File with paths to images")
+            ("deploy",          po::value<std::string>(), "Deploy prototxt of the net")
+            ("weights",         po::value<std::string>(), "Trained weights of the net, a .caffemodel")
+            ("batch-size",      po::value<size_t>()->default_value(0),
+                 "Number of windows per forward pass. Default is the input_dim of the deploy prototxt.")
+            ("stride",          po::value<int>()->default_value(TAG_WIDTH / 4),
+                 "Distance between two candidate windows")
+            ("threshold",       po::value<float>()->default_value(0.5),
+                 "Minimal tag probability of a proposal")
+            ("min-distance",    po::value<int>()->default_value(TAG_WIDTH / 2),
+                 "Minimal distance between two proposals")
+            ("fully-convolutional", "Convert the net to a fully convolutional one and score "
+                 "the whole image in one forward pass. The stride is given by the net.")
+            ("gpu",             "Run the net on the GPU")
+            ("io-threads",      po::value<size_t>()->default_value(2),
+                 "Number of threads that read and decode images.")
+            ("queue-depth",     po::value<size_t>()->default_value(4),
+                 "Maximum number of images and batches waiting between two pipeline stages.")
+            ("metrics",         po::value<std::string>(),
+                 "Write timings and counters of the stages to this file at the end. "
+                 "Files ending with .prom use the Prometheus text format, otherwise json.")
+            ("metrics-interval", po::value<double>()->default_value(0),
+                 "Also write the metrics file every this many seconds");
+    positional_opt.add("pathfile", 1);
+}
+
+void printUsage() {
+    std::cout << "Usage: generate_proposals [options] --deploy deploy.prototxt "
+              << "--weights net.caffemodel pathfile.txt "<< std::endl;
+    std::cout << "    where pathfile.txt contains paths to images."<< std::endl;
+    std::cout << desc_option << std::endl;
+}
+
+#ifdef HAVE_OPENCV_DNN
+
+struct ProposalOptions {
+    size_t batch_size;
+    int stride;
+    float threshold;
+    int min_distance;
+    size_t nb_io_threads;
+    size_t queue_depth;
+};
+
+struct DecodedImage {
+    size_t idx;
+    Image image;
+};
+
+// An empty image if the file does not exist. The constructor of Image would
+// throw, which terminates the reader thread. Reads the file before decoding
+// it, so the read and decode metrics are separate.
+Image readImage(const std::string & path) {
+    if (!boost::filesystem::exists(path)) {
+        return Image();
+    }
+    return Image(ImageDesc(path), DecodeOptions());
+}
+
+// The candidate windows of one image. Only the forward thread writes the
+// scores, after the packer has created the job.
+struct ImageJob {
+    size_t idx;
+    std::vector<ScoredWindow> windows;
+    size_t remaining;
+};
+using ImageJobPtr = std::shared_ptr<ImageJob>;
+
+struct Batch {
+    cv::Mat blob;
+    std::vector<std::pair<ImageJobPtr, size_t>> owners;
+};
+
+template<typename Fn>
+std::vector<std::thread> startStage(size_t nb_threads, Fn fn) {
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < std::max<size_t>(nb_threads, 1); i++) {
+        threads.emplace_back(fn);
+    }
+    return threads;
+}
+
+void joinStage(std::vector<std::thread> & threads) {
+    for(auto & thread : threads) {
+        thread.join();
+    }
+}
+
+// decode -> pack windows into batches -> forward -> suppress and write.
+// Batches are filled across images, so every forward pass but the last
+// one is full. The blobs are recycled, at most `queue_depth + 2` exist.
+void generateProposals(const std::vector<std::string> & paths,
+                       TagClassifier & classifier,
+                       const ProposalOptions & opt) {
+    auto start_time = system_clock::now();
+    printProgress(start_time, 0);
+    const NetInputShape & shape = classifier.inputShape();
+    const cv::Size patch_size(shape.width, shape.height);
+    const unsigned int border = borderForInput(shape);
+    ASSERT(shape.channels > 0, "The net expects " << shape.channels << " input channels.");
+    const int blob_sizes[4] = {static_cast<int>(opt.batch_size), shape.channels,
+                               shape.height, shape.width};
+    const size_t plane_size = patch_size.area();
+
+    std::mutex cout_mutex;
+    std::atomic<size_t> next_idx(0);
+    BoundedQueue<DecodedImage> decoded(opt.queue_depth);
+    BoundedQueue<Batch> batches(opt.queue_depth);
+    BoundedQueue<ImageJobPtr> finished(opt.queue_depth);
+    BoundedQueue<cv::Mat> free_blobs(opt.queue_depth + 2);
+    for(size_t i = 0; i < opt.queue_depth + 2; i++) {
+        free_blobs.push(cv::Mat(4, blob_sizes, CV_32F));
+    }
+
+    auto readers = startStage(opt.nb_io_threads, [&]() {
+        for(size_t i = next_idx++; i < paths.size(); i = next_idx++) {
+            DecodedImage item{i, readImage(paths.at(i))};
+            if (item.image.getCvMat().empty()) {
+                std::lock_guard<std::mutex> lock(cout_mutex);
+                std::cerr << "Fail to read image : " << paths.at(i) << std::endl;
+                continue;
+            }
+            decoded.push(std::move(item));
+        }
+    });
+    std::thread packer([&]() {
+        Batch batch;
+        auto push_batch = [&]() {
+            batches.push(std::move(batch));
+            batch = Batch();
+        };
+        while(auto item = decoded.pop()) {
+            const cv::Mat & mat = item->image.getCvMat();
+            auto job = std::make_shared<ImageJob>();
+            job->idx = item->idx;
+            for(const auto & box : candidateWindows(mat.size(), opt.stride)) {
+                job->windows.push_back(ScoredWindow{box, 0});
+            }
+            job->remaining = job->windows.size();
+            if (job->windows.empty()) {
+                finished.push(job);
+                continue;
+            }
+            for(size_t w = 0; w < job->windows.size(); w++) {
+                if (batch.blob.empty()) {
+                    batch.blob = free_blobs.pop().get();
+                }
+                const int n = static_cast<int>(batch.owners.size());
+                float * sample = batch.blob.ptr<float>(n);
+                packSubimage(mat, job->windows[w].box, sample,
+                             patch_size, border, NET_INPUT_SCALE);
+                // the images are gray, a net with more channels sees the
+                // same patch in every channel
+                for(int c = 1; c < shape.channels; c++) {
+                    std::copy(sample, sample + plane_size, sample + c*plane_size);
+                }
+                batch.owners.emplace_back(job, w);
+                if (batch.owners.size() == opt.batch_size) {
+                    push_batch();
+                }
+            }
+        }
+        if (!batch.owners.empty()) {
+            push_batch();
+        }
+        batches.close();
+    });
+    std::thread forward([&]() {
+        while(auto batch = batches.pop()) {
+            auto scores = classifier.classify(batch->blob, batch->owners.size());
+            for(size_t i = 0; i < scores.size(); i++) {
+                auto & owner = batch->owners[i];
+                owner.first->windows[owner.second].score = scores[i];
+                if (--owner.first->remaining == 0) {
+                    finished.push(owner.first);
+                }
+            }
+            free_blobs.push(std::move(batch->blob));
+        }
+        finished.close();
+    });
+    std::thread writer([&]() {
+        size_t nb_done = 0;
+        while(auto job = finished.pop()) {
+            const std::string & path = paths.at(job.get()->idx);
+            ImageDesc desc(path, nonMaximumSuppression(std::move(job.get()->windows),
+                                                       opt.threshold, opt.min_distance));
+            desc.setSavePathExtension("proposal.json");
+            desc.save();
+            std::lock_guard<std::mutex> lock(cout_mutex);
+            printProgress(start_time, static_cast<double>(++nb_done) / paths.size());
+        }
+    });
+    joinStage(readers);
+    decoded.close();
+    packer.join();
+    forward.join();
+    writer.join();
+    std::cout << std::endl;
+}
+
+// decode -> one forward pass per image -> write. The heat map replaces the
+// windows, so only the decoded images are queued.
+void generateProposalsFullyConvolutional(const std::vector<std::string> & paths,
+                                         FullyConvolutionalLocalizer & localizer,
+                                         const ProposalOptions & opt) {
+    auto start_time = system_clock::now();
+    printProgress(start_time, 0);
+    std::mutex cout_mutex;
+    std::atomic<size_t> next_idx(0);
+    BoundedQueue<DecodedImage> decoded(opt.queue_depth);
+    BoundedQueue<ImageDesc> localized(opt.queue_depth);
+
+    auto readers = startStage(opt.nb_io_threads, [&]() {
+        for(size_t i = next_idx++; i < paths.size(); i = next_idx++) {
+            DecodedImage item{i, readImage(paths.at(i))};
+            if (item.image.getCvMat().empty()) {
+                std::lock_guard<std::mutex> lock(cout_mutex);
+                std::cerr << "Fail to read image : " << paths.at(i) << std::endl;
+                continue;
+            }
+            decoded.push(std::move(item));
+        }
+    });
+    std::thread forward([&]() {
+        while(auto item = decoded.pop()) {
+            localized.push(ImageDesc(paths.at(item->idx), localizer.localize(
+                    item->image.getCvMat(), opt.threshold, opt.min_distance)));
+        }
+        localized.close();
+    });
+    std::thread writer([&]() {
+        size_t nb_done = 0;
+        while(auto desc = localized.pop()) {
+            desc->setSavePathExtension("proposal.json");
+            desc->save();
+            std::lock_guard<std::mutex> lock(cout_mutex);
+            printProgress(start_time, static_cast<double>(++nb_done) / paths.size());
+        }
+    });
+    joinStage(readers);
+    decoded.close();
+    forward.join();
+    writer.join();
+    std::cout << std::endl;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    setupOptions();
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc_option)
+                      .positional(positional_opt).run(), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        printUsage();
+        return 0;
+    }
+    if (!vm.count("pathfile") || !vm.count("deploy") || !vm.count("weights")) {
+        std::cout << "No pathfile, deploy prototxt or weights are given" << std::endl;
+        printUsage();
+        return 1;
+    }
+#ifdef HAVE_OPENCV_DNN
+    const std::string deploy = vm.at("deploy").as<std::string>();
+    const std::string weights = vm.at("weights").as<std::string>();
+    const bool use_gpu = vm.count("gpu") > 0;
+    ProposalOptions opt;
+    opt.batch_size = vm.at("batch-size").as<size_t>();
+    opt.stride = vm.at("stride").as<int>();
+    opt.threshold = vm.at("threshold").as<float>();
+    opt.min_distance = vm.at("min-distance").as<int>();
+    opt.nb_io_threads = vm.at("io-threads").as<size_t>();
+    opt.queue_depth = std::max<size_t>(vm.at("queue-depth").as<size_t>(), 1);
+    auto paths = ImageDesc::readPathFile(vm.at("pathfile").as<std::vector<std::string>>().at(0));
+    std::unique_ptr<stats::PeriodicWriter> metrics;
+    if (vm.count("metrics")) {
+        metrics = stats::startPeriodicWriter(vm.at("metrics").as<std::string>(),
+                                             vm.at("metrics-interval").as<double>());
+    }
+    auto start = system_clock::now();
+    if (vm.count("fully-convolutional")) {
+        FullyConvolutionalLocalizer localizer(deploy, weights, use_gpu);
+        std::cout << "Fully convolutional net with a stride of " << localizer.stride() << std::endl;
+        generateProposalsFullyConvolutional(paths, localizer, opt);
+    } else {
+        TagClassifier classifier(deploy, weights, use_gpu);
+        if (opt.batch_size == 0) {
+            opt.batch_size = static_cast<size_t>(classifier.inputShape().batch_size);
+        }
+        generateProposals(paths, classifier, opt);
+    }
+    duration<double> elapsed = system_clock::now() - start;
+    std::cout << "Generated proposals for " << paths.size() << " images in "
+              << elapsed.count() << "s" << std::endl;
+    return 0;
+#else
+    std::cerr << "generate_proposals needs OpenCV with the dnn module." << std::endl;
+    return 1;
+#endif
+}
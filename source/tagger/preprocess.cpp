@@ -4,7 +4,14 @@
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include "Image.h"
+#include "BoundedQueue.h"
+#include "Patch.h"
+#include "Preprocessor.h"
+#include "PreprocessManifest.h"
+#include "Shards.h"
+#include "Stats.h"
 #include "utils.h"
 
 using namespace deeplocalizer;
@@ -26,101 +33,49 @@ void setupOptions() {
                  "Write output_pathfile to this directory. Default is <output_dir>/images.txt")
             ("pathfile",        po::value<std::vector<std::string>>(), "File with paths")
             ("border",          po::value<bool>()->default_value(true), "Add a border around the image.")
+            ("patch-size",      po::value<int>()->default_value(PATCH_SIZE_DEFAULT),
+                 "Size of the patches extracted around the tags later. The border is half of it wide.")
             ("use-hist-eq",     po::value<bool>()->default_value(false), "Apply local histogram equalization (CLAHE) to samples")
             ("use-threshold",   po::value<bool>()->default_value(false), "Apply adaptive thresholding to samples")
             ("binary-image",    po::value<bool>()->default_value(false), "Save binary image from thresholding")
             ("format,f",        po::value<std::string>()->default_value("jpeg"), "image output format. `png` or `jpeg`")
             ("compression,c",   po::value<int>(), "compression ratio")
-            ("benchmark",       po::value<bool>()->default_value(false), "Try out different compression ratios and formats");
+            ("threads,j",       po::value<size_t>()->default_value(0),
+                 "Number of threads that apply the filters. Default is one per CPU core.")
+            ("io-threads",      po::value<size_t>()->default_value(2),
+                 "Number of threads that read and decode and of threads that encode and write images.")
+            ("queue-depth",     po::value<size_t>()->default_value(8),
+                 "Maximum number of images waiting between two pipeline stages. Caps the memory usage.")
+            ("variant",         po::value<std::vector<std::string>>()->composing(),
+                 "An additional output, written from the same decoded image, e.g. "
+                 "dir=out/clahe,clahe=1,format=png. Keys are dir, border, patch, clahe, threshold, binary, "
+                 "format and compression. Omitted keys are taken from the main output. "
+                 "Can be given several times.")
+            ("force",           po::value<bool>()->default_value(false),
+                 "Process all images, also those that the manifest of the output directory lists as up to date.")
+            ("shard",           po::value<std::string>(),
+                 "Only process the images of shard i/N. The shard writes its own output pathfile "
+                 "and manifest, e.g. images.shard-0-of-4.txt")
+            ("merge",           po::value<size_t>(),
+                 "Combine the outputs of N finished shards in the output directory into the output "
+                 "pathfile and manifest. If a pathfile is given, its order is kept.")
+            ("metrics",         po::value<std::string>(),
+                 "Write timings and counters of the stages to this file at the end. "
+                 "Files ending with .prom use the Prometheus text format, otherwise json.")
+            ("metrics-interval", po::value<double>()->default_value(0),
+                 "Also write the metrics file every this many seconds");
     positional_opt.add("pathfile", 1);
 }
 
-enum ImageFormat {
-    PNG,
-    JPEG
-
-};
-
-std::string format_to_str(ImageFormat format) {
-    if (format == ImageFormat::JPEG) {
-        return "jpeg";
-    } else if(format == ImageFormat::PNG) {
-        return "png";
-    } else {
-        return "wrong";
-    }
-}
-
-struct PreprocessOptions {
-    io::path output_dir;
-    bool use_hist_eq;
-    bool use_thresholding;
-    bool use_binary_image;
-    bool add_border;
-    ImageFormat format;
-    int compression;
-    bool benchmark;
-    std::pair<int, int> opencv_compression()const {
-        int f;
-        if (format == ImageFormat::JPEG) {
-            f = CV_IMWRITE_JPEG_QUALITY;
-        } else {
-            f = CV_IMWRITE_PNG_COMPRESSION;
-        }
-        return std::make_pair(f, compression);
-    };
-
-    std::string extension() const {
-        std::vector<std::string> parts;
-        if (use_hist_eq) {
-            parts.push_back("clahe");
-        }
-        if (use_thresholding) {
-            parts.push_back("t");
-        }
-        if (add_border) {
-            parts.push_back("b");
-        }
-        if (parts.empty()) {
-            return "";
-        } else {
-            std::stringstream ss;
-            for(const auto & part : parts) {
-                ss << "." << part;
-            }
-            return ss.str();
-        }
-    }
-
-    void print() {
-        std::cout << "output-dir:       " << output_dir << std::endl;
-        std::cout << "use-hist-eq:      " << use_hist_eq << std::endl;
-        std::cout << "use-thresholding: " << use_thresholding << std::endl;
-        std::cout << "add-border:       " << add_border << std::endl;
-    }
-};
-
-// opencv default values
-static const int DEFAULT_JPEG_COMPRESSION = 95;
-static const int DEFAULT_PNG_COMPRESSION = 3;
-
-io::path add_extension(const io::path & filename, const PreprocessOptions & opt) {
-    io::path output_path(filename);
-    output_path.replace_extension();
-    output_path += opt.extension() + std::string(".") + format_to_str(opt.format);
-    return output_path;
-}
-
-using pathss_t = std::vector<std::shared_ptr<std::vector<std::string>>>;
-
-void writeOutputPathfile(io::path pathfile, const pathss_t &output_pathss) {
+void writeOutputPathfile(io::path pathfile, const std::vector<std::string> &output_paths) {
     std::ofstream of(pathfile.string());
     size_t nb_images = 0;
-    for (const auto &paths : output_pathss) {
-        nb_images += paths->size();
-        for (const auto & path : *paths) {
-            of << path << '\n';
+    for (const auto & path : output_paths) {
+        if (path.empty()) {
+            continue;
         }
+        nb_images++;
+        of << path << '\n';
     }
     of << std::flush;
 
@@ -129,191 +84,219 @@ void writeOutputPathfile(io::path pathfile, const pathss_t &output_pathss) {
     std::cout << std::endl;
 }
 
-void adaptiveTresholding(cv::Mat & mat, bool use_binary_image) {
-    static double max_value = 255;
-    static size_t block_size = 51;
-    static double weight_original = 0.7;
-    static double weight_threshold = 0.3;
-
-    cv::Mat mat_threshold(mat.rows, mat.cols, CV_8UC1);
-    cv::adaptiveThreshold(mat, mat_threshold, max_value,
-                          cv::ADAPTIVE_THRESH_GAUSSIAN_C,
-                          cv::THRESH_BINARY, block_size, 0);
-    if (use_binary_image) {
-        mat = mat_threshold;
-    } else {
-        cv::addWeighted(mat, weight_original, mat_threshold, weight_threshold, 0 /*gamma*/, mat);
-    }
-}
-
-void localHistogramEq(cv::Mat & mat) {
-    std::cout << "CLAHE" << std::endl;
-    static const int clip_limit = 2;
-    thread_local int i = 0;
-    static const cv::Size tile_size(deeplocalizer::TAG_WIDTH / 2, deeplocalizer::TAG_HEIGHT / 2);
-    auto clahe = cv::createCLAHE(clip_limit, tile_size);
-    cv::Mat image_clahe;
-    clahe->apply(mat, image_clahe);
-    mat = image_clahe;
-    //clahe->apply(mat, mat);
-    //cv::imwrite("out_clahe.jpeg", image_clahe);
-    //cv::imwrite("out_mat.jpeg", mat);
-}
+struct PipelineItem {
+    size_t idx;
+    Image image;
+};
 
-void makeBorder(cv::Mat & mat) {
-    auto mat_with_border = cv::Mat(mat.rows + TAG_HEIGHT,
-                                   mat.cols + TAG_WIDTH, CV_8U);
-    cv::copyMakeBorder(mat, mat_with_border,
-                       TAG_HEIGHT / 2, TAG_HEIGHT / 2,
-                       TAG_WIDTH  / 2, TAG_WIDTH  / 2,
-                       cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
-    mat = mat_with_border;
-}
-void processImage(Image & img, const PreprocessOptions & opt) {
-    cv::Mat & mat = img.getCvMatRef();
+// One variant of one image, waiting to be encoded and written.
+struct WriteJob {
+    size_t idx;
+    size_t variant;
+    cv::Mat image;
+};
 
-    if (opt.add_border) {
-        makeBorder(mat);
-    }
-    if (opt.use_hist_eq) {
-        localHistogramEq(mat);
-    }
-    if (opt.use_thresholding) {
-        adaptiveTresholding(mat, opt.use_binary_image);
+template<typename Fn>
+std::vector<std::thread> startStage(size_t nb_threads, Fn fn) {
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < std::max<size_t>(nb_threads, 1); i++) {
+        threads.emplace_back(fn);
     }
+    return threads;
 }
-void threadWorkerFn(const std::vector<ImageDesc> & image_descs,
-                    const size_t start, const size_t end,
-                    std::shared_ptr<std::vector<std::string>>  output_paths,
-                    const PreprocessOptions & opt,
-                    size_t & nb_done,
-                    std::mutex & cout_mutex) {
-    for(size_t i = start; i < end; i++) {
-        const ImageDesc & desc = image_descs.at(i);
-        Image img(desc);
-        processImage(img, opt);
-        auto input_path =  io::path(desc.filename);
-        auto output = add_extension(opt.output_dir / input_path.filename(), opt);
-        if(not img.write(output, opt.opencv_compression())) {
-            std::lock_guard<std::mutex> look(cout_mutex);
-            std::cerr << "Fail to write image : " << output.string() << std::endl;
-            return;
-        }
-        output_paths->push_back(output.string());
-        {
-            std::lock_guard<std::mutex> look(cout_mutex);
-            nb_done++;
-            printProgress(start_time, static_cast<double>(nb_done)/image_descs.size());
-        }
+
+void joinStage(std::vector<std::thread> & threads) {
+    for(auto & thread : threads) {
+        thread.join();
     }
 }
 
-double preprocess(const std::vector<ImageDesc> image_descs,
+// The images run through three stages that are linked by bounded queues:
+// decode -> border/CLAHE/threshold -> encode and write.
+// So reading from disk, computing and writing overlap. At most
+// `2*queue_depth` images plus one per thread are in memory at once.
+// Every image is decoded once for all output variants. The variants share
+// their common steps and are encoded and written by the writer threads
+// in parallel.
+double preprocess(const std::vector<ImageDesc> & image_descs,
         const io::path &  output_pathfile,
+        const io::path &  manifest_path,
         const PreprocessOptions  & opt) {
     auto start = std::chrono::system_clock::now();
-    io::create_directories(opt.output_dir);
+    const auto variants = opt.variants();
+    for(const auto & variant : variants) {
+        io::create_directories(variant.output_dir);
+    }
     start_time = system_clock::now();
     printProgress(start_time, 0);
-    const size_t nb_cpus = std::max(2*std::thread::hardware_concurrency(), 1u);
-    std::vector<std::thread> threads;
-    size_t nb_done = 0;
+    size_t nb_threads = opt.nb_threads;
+    if (nb_threads == 0) {
+        nb_threads = defaultNbThreads();
+    }
+    std::mutex cout_mutex;
+    auto outputPath = [&](size_t i, size_t v) {
+        const auto & variant = variants.at(v);
+        return add_extension(variant.output_dir / io::path(image_descs.at(i).filename).filename(), variant);
+    };
+    // keeps the order of the input pathfile. Failed images stay empty.
+    std::vector<std::vector<std::string>> output_paths(
+            variants.size(), std::vector<std::string>(image_descs.size()));
 
-    pathss_t output_pathss;
-    size_t part = image_descs.size()/nb_cpus;
-    for(size_t i = 0; i < nb_cpus; i++) {
-        std::shared_ptr<std::vector<std::string>> out_paths = std::make_shared<std::vector<std::string>>();
-        out_paths->reserve(part);
-        output_pathss.push_back(out_paths);
+    PreprocessManifest manifest(manifest_path);
+    const std::string fingerprint = opt.fingerprint();
+    if (!opt.force) {
+        parallelFor(image_descs.size(), 4*opt.nb_io_threads, [&](size_t i) {
+            auto output = manifest.upToDate(image_descs.at(i).filename, fingerprint);
+            if (!output) {
+                return;
+            }
+            for(size_t v = 1; v < variants.size(); v++) {
+                if (!io::exists(outputPath(i, v))) {
+                    return;
+                }
+            }
+            output_paths.at(0).at(i) = output.get();
+            for(size_t v = 1; v < variants.size(); v++) {
+                output_paths.at(v).at(i) = outputPath(i, v).string();
+            }
+        }, 64);
     }
-    for(size_t i = 0; i < nb_cpus; i++) {
-        size_t start = i*part;
-        size_t end = (i+1)*part;
-        if (i + 1 == nb_cpus)  {
-            end = image_descs.size();
+    std::vector<size_t> pending;
+    for(size_t i = 0; i < image_descs.size(); i++) {
+        if (output_paths.at(0).at(i).empty()) {
+            pending.push_back(i);
         }
-        std::mutex cout_look;
-        threads.push_back(std::thread(&threadWorkerFn, std::cref(image_descs),
-                                      start, end,
-                                      output_pathss.at(i),
-                                      std::cref(opt), std::ref(nb_done), std::ref(cout_look)));
-    }
-    for(auto & thread : threads) {
-        thread.join();
     }
-    writeOutputPathfile(output_pathfile, output_pathss);
-    std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
-    return duration.count();
-}
-
-std::vector<std::pair<ImageFormat, int>> benchmark_formats() {
-    std::vector<std::pair<ImageFormat, int>> formats;
-    for(size_t c : std::vector<size_t>{75, 80, 85, 90}) {
-        formats.emplace_back(std::make_pair(ImageFormat::JPEG, c));
+    if (pending.size() != image_descs.size()) {
+        std::cout << "Skip " << image_descs.size() - pending.size()
+                  << " images that are up to date." << std::endl;
     }
-    for(size_t c : std::vector<size_t>{9, 6, 3, 0}) {
-        formats.emplace_back(std::make_pair(ImageFormat::PNG, c));
+    std::atomic<size_t> next_idx(0);
+    std::atomic<size_t> nb_done(image_descs.size() - pending.size());
+    // an image is done once all its variants are written
+    std::vector<std::atomic<size_t>> nb_written(image_descs.size());
+    for(auto & n : nb_written) {
+        n = 0;
     }
-    return formats;
-}
-
-std::string mean_file_size(io::path dir) {
-    io::directory_iterator end_itr;
-    size_t nb_files = 0;
-    size_t total_size = 0;
+    BoundedQueue<PipelineItem> decoded(opt.queue_depth);
+    BoundedQueue<WriteJob> processed(opt.queue_depth * variants.size());
 
-    for (io::directory_iterator itr(dir); itr != end_itr; ++itr)
+    auto readers = startStage(opt.nb_io_threads, [&]() {
+        for(size_t p = next_idx++; p < pending.size(); p = next_idx++) {
+            const size_t i = pending.at(p);
+            PipelineItem item{i, Image(image_descs.at(i), DecodeOptions())};
+            if (item.image.getCvMat().empty()) {
+                std::lock_guard<std::mutex> lock(cout_mutex);
+                std::cerr << "Fail to read image : " << image_descs.at(i).filename << std::endl;
+                continue;
+            }
+            decoded.push(std::move(item));
+        }
+    });
+    // the written images are recycled as output buffers of the filter stage
+    BoundedQueue<cv::Mat> free_buffers((2*opt.queue_depth + nb_threads + opt.nb_io_threads) * variants.size());
+    std::vector<bool> recycle(variants.size());
     {
-        const io::path & file = itr->path();
-        if (io::is_regular_file(file)) {
-            total_size += io::file_size(file);
-            nb_files++;
+        VariantPreprocessor preprocessor(variants);
+        for(size_t v = 0; v < variants.size(); v++) {
+            recycle[v] = !preprocessor.sharesOutput(v);
         }
     }
-    double mean_size = total_size / static_cast<double>(nb_files);
-    const static size_t one_mb = 1 << 20;
-    double size_in_mb = mean_size / one_mb;
-    std::stringstream ss;
-    ss << size_in_mb << "MB";
-    return ss.str();
-}
+    auto workers = startStage(nb_threads, [&]() {
+        VariantPreprocessor preprocessor(variants);
+        std::vector<cv::Mat> outputs;
+        while(auto item = decoded.pop()) {
+            outputs.assign(variants.size(), cv::Mat());
+            for(size_t v = 0; v < variants.size(); v++) {
+                if (!recycle[v]) {
+                    continue;
+                }
+                if (auto buffer = free_buffers.tryPop()) {
+                    outputs[v] = buffer.get();
+                }
+            }
+            preprocessor.process(item->image.getCvMat(), outputs);
+            for(size_t v = 0; v < variants.size(); v++) {
+                processed.push(WriteJob{item->idx, v, std::move(outputs[v])});
+            }
+        }
+    });
+    auto writers = startStage(opt.nb_io_threads, [&]() {
+        while(auto job = processed.pop()) {
+            const auto & input = image_descs.at(job->idx).filename;
+            const auto & variant = variants.at(job->variant);
+            auto output = outputPath(job->idx, job->variant);
+            if(not Image(output.string(), job->image).write(output, variant.opencv_compression())) {
+                std::lock_guard<std::mutex> lock(cout_mutex);
+                std::cerr << "Fail to write image : " << output.string() << std::endl;
+                continue;
+            }
+            // every index and variant is owned by exactly one writer, so no lock is needed here
+            output_paths.at(job->variant).at(job->idx) = output.string();
+            if (recycle[job->variant]) {
+                free_buffers.tryPush(std::move(job->image));
+            }
+            if (++nb_written.at(job->idx) < variants.size()) {
+                continue;
+            }
+            manifest.record(input, fingerprint, output_paths.at(0).at(job->idx));
+            size_t done = ++nb_done;
+            std::unique_lock<std::mutex> lock(cout_mutex, std::try_to_lock);
+            if (lock) {
+                printProgress(start_time, static_cast<double>(done)/image_descs.size());
+            }
+        }
+    });
+    joinStage(readers);
+    decoded.close();
+    joinStage(workers);
+    processed.close();
+    joinStage(writers);
+    manifest.compact();
 
-void benchmark(const std::vector<ImageDesc> image_descs,
-        const io::path &  output_pathfile,
-        const PreprocessOptions  & opt) {
-    auto formats = benchmark_formats();
-    std::vector<std::pair<PreprocessOptions, double>> results;
-    for(auto & format_compression : formats) {
-        PreprocessOptions bench_opt = opt;
-        bench_opt.format = std::get<ImageFormat>(format_compression);
-        bench_opt.compression = std::get<int>(format_compression);
-        std::stringstream ss;
-        ss << format_to_str(bench_opt.format) << "_c_" << bench_opt.compression;
-        bench_opt.output_dir = opt.output_dir / ss.str();
-        std::cout << "Benchmark: " << format_to_str(bench_opt.format) << ", Compression: " << bench_opt.compression << std::endl;
-        double duration = preprocess(image_descs, output_pathfile, bench_opt);
-        std::cout << "Done in: " << duration << "s" << std::endl;
-        results.push_back(std::make_pair(bench_opt, duration));
-    }
-    for(size_t i = 0; i < formats.size(); i++) {
-        PreprocessOptions bench_opt = std::get<PreprocessOptions>(results.at(i));
-        std::cout << "Format: " << format_to_str(bench_opt.format) << ", Compression: " << bench_opt.compression << std::endl;
-        std::cout << "file size: " << mean_file_size(bench_opt.output_dir) << std::endl;
-        std::cout << "duration: " << std::get<double>(results.at(i)) << "s" << std::endl;
-        std::cout << std::endl;
+    writeOutputPathfile(output_pathfile, output_paths.at(0));
+    for(size_t v = 1; v < variants.size(); v++) {
+        writeOutputPathfile(variants.at(v).output_dir / output_pathfile.filename(), output_paths.at(v));
     }
+    std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
+    return duration.count();
 }
 
-int run(const std::vector<ImageDesc> image_descs,
+int run(const std::vector<ImageDesc> & image_descs,
         const io::path &  output_pathfile,
+        const io::path &  manifest_path,
         const PreprocessOptions  & opt
         ) {
-    if (opt.benchmark) {
-        benchmark(image_descs, output_pathfile, opt);
-    } else {
-        double duration = preprocess(image_descs, output_pathfile, opt);
-        std::cout << "Done in: " << duration << "s" << std::endl;
+    double duration = preprocess(image_descs, output_pathfile, manifest_path, opt);
+    std::cout << "Done in: " << duration << "s" << std::endl;
+    return 0;
+}
+
+// Combines the manifests and output pathfiles of all shards. The images are
+// already in the output directory, since every shard writes there directly.
+int merge(const io::path & output_dir, const io::path & output_pathfile, size_t nb_shards,
+          const boost::optional<std::string> & pathfile) {
+    ASSERT(nb_shards > 0, "Expected at least one shard to merge.");
+    const io::path manifest_path = output_dir / PreprocessManifest::DEFAULT_FILENAME;
+    PreprocessManifest manifest(manifest_path);
+    for(size_t i = 0; i < nb_shards; i++) {
+        const io::path shard_manifest = shardPath(manifest_path.string(), i, nb_shards);
+        ASSERT(io::exists(shard_manifest), "Manifest " << shard_manifest
+               << " does not exists. Did shard " << i << "/" << nb_shards << " finish?");
+        manifest.merge(PreprocessManifest(shard_manifest));
+    }
+    manifest.compact();
+    std::vector<std::string> order;
+    if (pathfile) {
+        for(const auto & input : ImageDesc::readPathFile(pathfile.get())) {
+            if (auto output = manifest.output(input)) {
+                order.push_back(output.get());
+            }
+        }
     }
+    size_t nb_images = mergeShardFiles(output_pathfile.string(), nb_shards, order);
+    std::cout << "Merged " << nb_images << " images of " << nb_shards << " shards into "
+              << output_pathfile.string() << std::endl;
     return 0;
 }
 
@@ -330,20 +313,42 @@ int main(int argc, char* argv[])
         std::cout << desc_option << std::endl;
         return 0;
     }
+    if(vm.count("merge") && vm.count("output-dir")) {
+        auto output_dir = io::path(vm.at("output-dir").as<std::string>());
+        io::path output_pathfile = vm.at("output-pathfile").as<std::string>();
+        if (output_pathfile.is_relative()) {
+            output_pathfile = output_dir / output_pathfile;
+        }
+        boost::optional<std::string> pathfile;
+        if (vm.count("pathfile")) {
+            pathfile = vm.at("pathfile").as<std::vector<std::string>>().at(0);
+        }
+        return merge(output_dir, output_pathfile, vm.at("merge").as<size_t>(), pathfile);
+    }
     if(vm.count("pathfile") && vm.count("output-dir")) {
         std::string pathfile =
                 vm.at("pathfile").as<std::vector<std::string>>().at(0);
-        auto image_descs = ImageDesc::fromPathFile(pathfile);
+        auto paths = ImageDesc::readPathFile(pathfile);
         auto output_dir = io::path(vm.at("output-dir").as<std::string>());
 
         io::path output_pathfile = vm.at("output-pathfile").as<std::string>();
         if (output_pathfile.is_relative()) {
             output_pathfile = output_dir / output_pathfile;
         }
+        io::path manifest_path = output_dir / PreprocessManifest::DEFAULT_FILENAME;
+        if (vm.count("shard")) {
+            // the shards share the output directory, but not the files listing it
+            auto shard = parseShard(vm.at("shard").as<std::string>());
+            paths = selectShard(paths, shard.first, shard.second);
+            output_pathfile = shardPath(output_pathfile.string(), shard.first, shard.second);
+            manifest_path = shardPath(manifest_path.string(), shard.first, shard.second);
+            std::cout << "Shard " << shard.first << "/" << shard.second << " has "
+                      << paths.size() << " images." << std::endl;
+        }
+        auto image_descs = ImageDesc::fromPaths(paths);
         bool use_hist_eq = vm.at("use-hist-eq").as<bool>();
         bool use_threshold = vm.at("use-threshold").as<bool>();
         bool use_binary_image = vm.at("binary-image").as<bool>();
-        bool benchmark = vm.at("benchmark").as<bool>();
         ImageFormat format;
         std::string str_format = vm.at("format").as<std::string>();
         if (str_format.compare("png") == 0) {
@@ -364,6 +369,10 @@ int main(int argc, char* argv[])
             compression = DEFAULT_PNG_COMPRESSION;
         }
         bool add_border = vm.at("border").as<bool>();
+        size_t nb_threads = vm.at("threads").as<size_t>();
+        size_t nb_io_threads = vm.at("io-threads").as<size_t>();
+        size_t queue_depth = vm.at("queue-depth").as<size_t>();
+        bool force = vm.at("force").as<bool>();
         PreprocessOptions opt {
                 output_dir,
                 use_hist_eq,
@@ -372,10 +381,37 @@ int main(int argc, char* argv[])
                 add_border,
                 format,
                 compression,
-                benchmark
+                nb_threads,
+                nb_io_threads,
+                queue_depth,
+                force
         };
+        opt.patch_size = vm.at("patch-size").as<int>();
+        checkPatchSize(opt.patch_size);
+        if (vm.count("variant")) {
+            const auto specs = vm.at("variant").as<std::vector<std::string>>();
+            for(size_t k = 0; k < specs.size(); k++) {
+                OutputVariant base = opt.variant();
+                base.output_dir = output_dir / ("variant-" + std::to_string(k + 1));
+                opt.extra_variants.push_back(OutputVariant::parse(specs.at(k), base));
+            }
+            // every variant writes its own output pathfile
+            auto variants = opt.variants();
+            for(size_t a = 0; a < variants.size(); a++) {
+                for(size_t b = a + 1; b < variants.size(); b++) {
+                    ASSERT(io::absolute(variants[a].output_dir) != io::absolute(variants[b].output_dir),
+                           "Every variant needs its own output directory, but two use "
+                           << variants[a].output_dir);
+                }
+            }
+        }
         opt.print();
-        run(image_descs, output_pathfile, opt);
+        std::unique_ptr<stats::PeriodicWriter> metrics;
+        if (vm.count("metrics")) {
+            metrics = stats::startPeriodicWriter(vm.at("metrics").as<std::string>(),
+                                                 vm.at("metrics-interval").as<double>());
+        }
+        run(image_descs, output_pathfile, manifest_path, opt);
     } else {
         std::cout << "No pathfile or output_dir are given" << std::endl;
         std::cout << "Usage: add_border [options] pathfile.txt "<< std::endl;
@@ -4,6 +4,8 @@
 #include "qt_helper.h"
 #include <QApplication>
 #include "utils.h"
+#include "DescriptorStore.h"
+#include "Stats.h"
 #include <boost/program_options.hpp>
 
 using namespace deeplocalizer;
@@ -17,27 +19,81 @@ po::positional_options_description positional_opt;
 void setupOptions() {
     desc_option.add_options()
             ("help,h", "Print help messages")
-            ("pathfile", po::value<std::vector<std::string>>(), "File with the paths to the images");
+            ("pathfile", po::value<std::vector<std::string>>(), "File with the paths to the images")
+            ("prefetch", po::value<size_t>()->default_value(ManuallyTagger::DEFAULT_PREFETCH_DEPTH),
+                 "Number of next and previous images that are decoded in the background")
+            ("cache-mb", po::value<size_t>()->default_value(ImageCache::DEFAULT_MAX_BYTES / (1024*1024)),
+                 "Memory limit of the decoded images in MB")
+            ("opengl", "Draw the image with OpenGL")
+            ("thumbnails", po::value<std::string>(),
+                 "Show thumbnails in the image list. They are created in the background "
+                 "and cached in this directory")
+            ("progress", po::value<std::string>()->default_value(ManuallyTagger::DEFAULT_SAVE_PATH),
+                 "Progress file. Files ending with .bin use a compact binary format")
+            ("store", po::value<std::string>(),
+                 "Take the images and their tags from this descriptor store instead of the pathfile")
+            ("shard", po::value<std::string>(),
+                 "Only tag the images of shard i/N. Every shard has its own progress file, "
+                 "so several people can tag the same dataset at once")
+            ("metrics",         po::value<std::string>(),
+                 "Write timings and counters of the stages to this file at the end. "
+                 "Files ending with .prom use the Prometheus text format, otherwise json.")
+            ("metrics-interval", po::value<double>()->default_value(0),
+                 "Also write the metrics file every this many seconds");
 
     positional_opt.add("pathfile", 1);
 }
-int run(QApplication & qapp, std::string pathfile) {
-    std::unique_ptr<ManuallyTaggerWindow> window;
-    if (io::exists(ManuallyTagger::DEFAULT_SAVE_PATH)) {
-        auto tagger = ManuallyTagger::load(ManuallyTagger::DEFAULT_SAVE_PATH);
-        window = std::make_unique<ManuallyTaggerWindow>(std::move(tagger));
-    } else {
-        const auto filenames = parsePathfile(pathfile);
-        std::vector<ImageDescPtr> img_desc;
-        for(const auto & fname : filenames) {
-            auto proposal_name = fname + ".proposal.json";
-            if (io::exists(proposal_name)) {
-                img_desc.push_back(ImageDesc::load(proposal_name));
-            } else {
-                img_desc.push_back(std::make_shared<ImageDesc>(fname));
+std::vector<ImageDescPtr> loadDescriptions(const po::variables_map & vm,
+                                           boost::optional<std::pair<size_t, size_t>> shard) {
+    auto inShard = [&](const std::string & path) {
+        return !shard || shardOf(path, shard->second) == shard->first;
+    };
+    std::vector<ImageDescPtr> descs;
+    if (vm.count("store")) {
+        DescriptorStore store(vm.at("store").as<std::string>());
+        for(size_t i = 0; i < store.size(); i++) {
+            if (inShard(store.filename(i).to_string())) {
+                descs.push_back(std::make_shared<ImageDesc>(store.imageDesc(i)));
             }
         }
-        window = std::make_unique<ManuallyTaggerWindow>(std::move(img_desc));
+        return descs;
+    }
+    auto pathfile = vm.at("pathfile").as<std::vector<std::string>>().at(0);
+    std::vector<std::string> paths;
+    for(auto & path : ImageDesc::readPathFile(pathfile)) {
+        if (inShard(path)) {
+            paths.push_back(std::move(path));
+        }
+    }
+    return ImageDesc::fromPathsPtr(paths, "proposal.json");
+}
+
+int run(QApplication & qapp, const po::variables_map & vm) {
+    std::string progress_path = vm.at("progress").as<std::string>();
+    boost::optional<std::pair<size_t, size_t>> shard;
+    if (vm.count("shard")) {
+        shard = parseShard(vm.at("shard").as<std::string>());
+        progress_path = progress_file::shardPath(progress_path, shard->first, shard->second);
+    }
+    std::unique_ptr<ManuallyTagger> tagger;
+    if (io::exists(progress_path)) {
+        tagger = ManuallyTagger::load(progress_path);
+    } else {
+        tagger = std::make_unique<ManuallyTagger>(loadDescriptions(vm, shard), progress_path);
+        if (vm.count("store")) {
+            tagger->setDescriptorStore(vm.at("store").as<std::string>());
+        }
+    }
+    tagger->setPrefetchDepth(vm.at("prefetch").as<size_t>());
+    tagger->imageCache().setMaxBytes(vm.at("cache-mb").as<size_t>() * 1024 * 1024);
+    std::unique_ptr<stats::PeriodicWriter> metrics;
+    if (vm.count("metrics")) {
+        metrics = stats::startPeriodicWriter(vm.at("metrics").as<std::string>(),
+                                             vm.at("metrics-interval").as<double>());
+    }
+    auto window = std::make_unique<ManuallyTaggerWindow>(std::move(tagger), vm.count("opengl") > 0);
+    if (vm.count("thumbnails")) {
+        window->setThumbnailDir(vm.at("thumbnails").as<std::string>());
     }
     window->show();
     return qapp.exec();
@@ -62,11 +118,10 @@ int main(int argc, char* argv[])
         printUsage();
         return 0;
     }
-    if(vm.count("pathfile")) {
-        auto pathfile = vm.at("pathfile").as<std::vector<std::string>>().at(0);
-        return run(qapp, pathfile);
+    if(vm.count("pathfile") || vm.count("store")) {
+        return run(qapp, vm);
     } else {
-        std::cout << "No proposal file or output directory given." << std::endl;
+        std::cout << "No pathfile or descriptor store given." << std::endl;
         printUsage();
         return 1;
     }
@@ -0,0 +1,171 @@
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include <json.hpp>
+
+#include "DescriptorJson.h"
+#include "Image.h"
+#include "utils.h"
+
+using namespace deeplocalizer;
+namespace po = boost::program_options;
+namespace io = boost::filesystem;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// Counts the heap allocations of the descriptor APIs: building, assigning
+// and loading image descriptions. The old API that took its arguments by
+// const reference is gone, so the `*_copy_synthetic` rows are a synthetic
+// baseline: they copy the tags by hand before passing them to the current
+// API, which is the copy the old API made inside. All other rows run the
+// current API as it is.
+
+std::atomic<size_t> nb_allocations(0);
+
+void * operator new(size_t size) {
+    nb_allocations++;
+    if (void * ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+po::options_description desc_option("Options");
+
+void setupOptions() {
+    desc_option.add_options()
+            ("help,h", "Print help messages")
+            ("tags,t",    po::value<size_t>()->default_value(500), "Number of tags per image")
+            ("images,n",  po::value<size_t>()->default_value(200), "Number of descriptor files loaded")
+            ("repeat,r",  po::value<size_t>()->default_value(100), "How often every operation runs")
+            ("json",      po::value<std::string>(), "Write the results as JSON to this file");
+}
+
+struct Result {
+    double allocations;
+    double us;
+};
+
+template<typename Fn>
+Result measure(size_t repeat, Fn fn) {
+    size_t before = nb_allocations;
+    auto start = Clock::now();
+    for(size_t i = 0; i < repeat; i++) {
+        fn();
+    }
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return Result{static_cast<double>(nb_allocations - before) / repeat, elapsed.count() / repeat};
+}
+
+std::vector<Tag> someTags(size_t n) {
+    std::vector<Tag> tags;
+    tags.reserve(n);
+    for(size_t i = 0; i < n; i++) {
+        tags.emplace_back(cv::Rect(static_cast<int>(i % 100) * 40, static_cast<int>(i / 100) * 40,
+                                   TAG_WIDTH, TAG_HEIGHT));
+    }
+    return tags;
+}
+
+int main(int argc, char* argv[])
+{
+    setupOptions();
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc_option).run(), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        std::cout << "Usage: BenchImageDesc [options]" << std::endl;
+        std::cout << desc_option << std::endl;
+        return 0;
+    }
+    const size_t nb_tags = vm.at("tags").as<size_t>();
+    const size_t nb_images = vm.at("images").as<size_t>();
+    const size_t repeat = vm.at("repeat").as<size_t>();
+    const std::string filename = "/some/long/path/to/Cam_2_20150828143300_888543_wb.jpeg";
+    const std::vector<Tag> tags = someTags(nb_tags);
+    std::vector<std::pair<std::string, Result>> results;
+
+    results.emplace_back("construct_copy_synthetic", measure(repeat, [&]() {
+        std::vector<Tag> loaded = tags;
+        ImageDesc desc(filename, std::vector<Tag>(loaded));
+    }));
+    results.emplace_back("construct_move", measure(repeat, [&]() {
+        std::vector<Tag> loaded = tags;
+        ImageDesc desc(filename, std::move(loaded));
+    }));
+    ImageDesc desc(filename);
+    results.emplace_back("set_tags_copy_synthetic", measure(repeat, [&]() {
+        std::vector<Tag> loaded = tags;
+        desc.setTags(static_cast<const std::vector<Tag> &>(loaded));
+    }));
+    results.emplace_back("set_tags_move", measure(repeat, [&]() {
+        std::vector<Tag> loaded = tags;
+        desc.setTags(std::move(loaded));
+    }));
+    ImageDesc full(filename, tags);
+    const std::string dom_text = full.to_json().dump(2);
+    const std::string compact_text = descriptor_json::dump(full);
+    results.emplace_back("parse_dom", measure(repeat, [&]() {
+        ImageDesc::from_json(json::parse(dom_text));
+    }));
+    results.emplace_back("parse_stream", measure(repeat, [&]() {
+        descriptor_json::parse(compact_text);
+    }));
+    results.emplace_back("dump_dom", measure(repeat, [&]() {
+        full.to_json().dump(2);
+    }));
+    results.emplace_back("dump_stream", measure(repeat, [&]() {
+        descriptor_json::dump(full);
+    }));
+
+    io::path dir = io::unique_path(io::temp_directory_path() / "bench_image_desc_%%%%%%%%");
+    io::create_directories(dir);
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < nb_images; i++) {
+        io::path image = dir / ("image_" + std::to_string(i) + ".jpeg");
+        std::ofstream(image.string()) << "";
+        ImageDesc(image.string(), tags).save(image.string() + ".tagger.json");
+        paths.push_back(image.string());
+    }
+    results.emplace_back("from_paths_per_image", measure(1, [&]() {
+        ImageDesc::fromPaths(paths, "tagger.json");
+    }));
+    results.back().second.allocations /= nb_images;
+    results.back().second.us /= nb_images;
+    io::remove_all(dir);
+
+    std::cout << nb_tags << " tags per image" << std::endl;
+    std::cout << std::left << std::setw(28) << "operation"
+              << std::right << std::setw(16) << "allocations/op"
+              << std::setw(12) << "us/op" << std::endl;
+    json j;
+    for(const auto & pair : results) {
+        std::cout << std::left << std::setw(28) << pair.first << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(16) << pair.second.allocations
+                  << std::setw(12) << pair.second.us << std::endl;
+        j[pair.first]["allocations"] = pair.second.allocations;
+        j[pair.first]["us"] = pair.second.us;
+    }
+    if (vm.count("json")) {
+        std::ofstream os(vm.at("json").as<std::string>());
+        os << j.dump(2);
+    }
+    return 0;
+}
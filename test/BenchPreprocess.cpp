@@ -0,0 +1,275 @@
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include <json.hpp>
+
+#include "Preprocessor.h"
+#include "utils.h"
+
+using namespace deeplocalizer;
+namespace po = boost::program_options;
+namespace io = boost::filesystem;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// Times every stage of bb_preprocess separately on images that are held in
+// memory: decode, makeBorder, CLAHE, adaptive thresholding and encoding.
+// The encoded images are only written to disk if --write-dir is given.
+
+po::options_description desc_option("Options");
+po::positional_options_description positional_opt;
+
+void setupOptions() {
+    desc_option.add_options()
+            ("help,h", "Print help messages")
+            ("pathfile",      po::value<std::vector<std::string>>(), "File with paths to sample images")
+            ("limit,n",       po::value<size_t>()->default_value(16), "Number of images loaded into memory")
+            ("repeat,r",      po::value<size_t>()->default_value(3), "How often every image is processed")
+            ("threads,j",     po::value<size_t>()->default_value(1), "Number of threads that process images")
+            ("formats,f",     po::value<std::string>()->default_value("jpeg:75,jpeg:80,jpeg:85,jpeg:90,png:9,png:6,png:3,png:0"),
+                 "Comma separated list of format:compression pairs to encode")
+            ("write-dir,o",   po::value<std::string>(), "Also write the encoded images to this directory")
+            ("json",          po::value<std::string>(), "Write the results as JSON to this file");
+    positional_opt.add("pathfile", 1);
+}
+
+struct StageStats {
+    std::vector<double> latencies;
+    double megapixels = 0;
+    size_t bytes_out = 0;
+
+    void add(Clock::duration elapsed, const cv::Mat & mat, size_t bytes = 0) {
+        latencies.push_back(std::chrono::duration<double>(elapsed).count());
+        megapixels += mat.total() / 1e6;
+        bytes_out += bytes;
+    }
+    void merge(const StageStats & other) {
+        latencies.insert(latencies.end(), other.latencies.begin(), other.latencies.end());
+        megapixels += other.megapixels;
+        bytes_out += other.bytes_out;
+    }
+    double percentile(double p) const {
+        if (latencies.empty()) {
+            return 0;
+        }
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        size_t idx = std::min(sorted.size() - 1,
+                              static_cast<size_t>(p * (sorted.size() - 1) + 0.5));
+        return sorted.at(idx);
+    }
+    double total() const {
+        double sum = 0;
+        for(double l : latencies) {
+            sum += l;
+        }
+        return sum;
+    }
+    json to_json() const {
+        json j;
+        j["count"] = latencies.size();
+        j["total_s"] = total();
+        j["mp_per_s"] = total() > 0 ? megapixels / total() : 0.;
+        j["p50_ms"] = percentile(0.5) * 1000;
+        j["p99_ms"] = percentile(0.99) * 1000;
+        j["bytes_out"] = bytes_out;
+        return j;
+    }
+};
+
+using stats_t = std::map<std::string, StageStats>;
+
+template<typename Fn>
+void timed(StageStats & stats, Fn fn) {
+    auto start = Clock::now();
+    const cv::Mat & mat = fn();
+    stats.add(Clock::now() - start, mat);
+}
+
+std::vector<std::pair<ImageFormat, int>> parseFormats(const std::string & str) {
+    std::vector<std::pair<ImageFormat, int>> formats;
+    std::stringstream ss(str);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        auto colon = item.find(':');
+        std::string name = item.substr(0, colon);
+        ImageFormat format;
+        if (name == "jpeg") {
+            format = ImageFormat::JPEG;
+        } else if (name == "png") {
+            format = ImageFormat::PNG;
+        } else {
+            ASSERT(false, "Expected `png` or `jpeg` format. But got: " << name);
+        }
+        int compression = format == ImageFormat::JPEG ? DEFAULT_JPEG_COMPRESSION
+                                                      : DEFAULT_PNG_COMPRESSION;
+        if (colon != std::string::npos) {
+            compression = std::stoi(item.substr(colon + 1));
+        }
+        formats.emplace_back(format, compression);
+    }
+    return formats;
+}
+
+std::string formatName(const std::pair<ImageFormat, int> & format) {
+    return "encode_" + format_to_str(format.first) + "_" + std::to_string(format.second);
+}
+
+std::vector<uchar> readFile(const std::string & path) {
+    std::ifstream is(path, std::ios::binary);
+    return std::vector<uchar>(std::istreambuf_iterator<char>(is),
+                              std::istreambuf_iterator<char>());
+}
+
+stats_t benchmarkImage(const std::vector<uchar> & encoded, Preprocessor & preprocessor,
+                       const std::vector<std::pair<ImageFormat, int>> & formats,
+                       const boost::optional<io::path> & write_path) {
+    stats_t stats;
+    cv::Mat decoded, bordered, clahe, threshold;
+    timed(stats["decode"], [&]() -> const cv::Mat & {
+        decoded = cv::imdecode(encoded, cv::IMREAD_GRAYSCALE);
+        return decoded;
+    });
+    timed(stats["border"], [&]() -> const cv::Mat & {
+        preprocessor.makeBorder(decoded, bordered);
+        return bordered;
+    });
+    timed(stats["clahe"], [&]() -> const cv::Mat & {
+        preprocessor.localHistogramEq(bordered, clahe);
+        return clahe;
+    });
+    timed(stats["threshold"], [&]() -> const cv::Mat & {
+        preprocessor.adaptiveTresholding(clahe, threshold);
+        return threshold;
+    });
+    std::vector<uchar> buffer;
+    for(const auto & format : formats) {
+        PreprocessOptions opt{};
+        opt.format = format.first;
+        opt.compression = format.second;
+        auto compression = opt.opencv_compression();
+        auto start = Clock::now();
+        cv::imencode("." + format_to_str(format.first), threshold, buffer,
+                     {compression.first, compression.second});
+        stats[formatName(format)].add(Clock::now() - start, threshold, buffer.size());
+        if (write_path) {
+            io::path path = write_path.get();
+            path += "." + formatName(format) + "." + format_to_str(format.first);
+            auto write_start = Clock::now();
+            std::ofstream os(path.string(), std::ios::binary);
+            os.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+            os.close();
+            stats["write"].add(Clock::now() - write_start, threshold, buffer.size());
+        }
+    }
+    return stats;
+}
+
+void printStats(const stats_t & stats, double wall_time, double total_megapixels) {
+    std::cout << std::left << std::setw(22) << "stage"
+              << std::right << std::setw(8) << "count"
+              << std::setw(12) << "MP/s"
+              << std::setw(12) << "p50 ms"
+              << std::setw(12) << "p99 ms"
+              << std::setw(16) << "bytes out" << std::endl;
+    for(const auto & pair : stats) {
+        json j = pair.second.to_json();
+        std::cout << std::left << std::setw(22) << pair.first << std::right
+                  << std::setw(8) << j["count"].get<size_t>()
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(12) << j["mp_per_s"].get<double>()
+                  << std::setw(12) << j["p50_ms"].get<double>()
+                  << std::setw(12) << j["p99_ms"].get<double>()
+                  << std::setw(16) << j["bytes_out"].get<size_t>() << std::endl;
+    }
+    std::cout << std::endl << "wall time: " << wall_time << "s, "
+              << total_megapixels / wall_time << " MP/s over all threads" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    setupOptions();
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc_option)
+                      .positional(positional_opt).run(), vm);
+    po::notify(vm);
+    if (vm.count("help") || !vm.count("pathfile")) {
+        std::cout << "Usage: BenchPreprocess [options] pathfile.txt" << std::endl;
+        std::cout << desc_option << std::endl;
+        return vm.count("help") ? 0 : 1;
+    }
+    auto paths = parsePathfile(vm.at("pathfile").as<std::vector<std::string>>().at(0));
+    paths.resize(std::min(paths.size(), vm.at("limit").as<size_t>()));
+    const size_t repeat = vm.at("repeat").as<size_t>();
+    const size_t nb_threads = vm.at("threads").as<size_t>();
+    const auto formats = parseFormats(vm.at("formats").as<std::string>());
+    boost::optional<io::path> write_dir;
+    if (vm.count("write-dir")) {
+        write_dir = io::path(vm.at("write-dir").as<std::string>());
+        io::create_directories(write_dir.get());
+    }
+
+    stats_t stats;
+    std::vector<std::vector<uchar>> encoded_images;
+    for(const auto & path : paths) {
+        auto start = Clock::now();
+        encoded_images.emplace_back(readFile(path));
+        stats["read"].add(Clock::now() - start, cv::Mat(), encoded_images.back().size());
+    }
+
+    PreprocessOptions opt{};
+    opt.add_border = true;
+    opt.use_hist_eq = true;
+    opt.use_thresholding = true;
+    std::mutex stats_mutex;
+    double total_megapixels = 0;
+    auto start = Clock::now();
+    parallelFor(encoded_images.size() * repeat, nb_threads, [&](size_t i) {
+        thread_local std::unique_ptr<Preprocessor> preprocessor;
+        if (!preprocessor) {
+            preprocessor = std::make_unique<Preprocessor>(opt);
+        }
+        const size_t image_idx = i % encoded_images.size();
+        boost::optional<io::path> write_path;
+        if (write_dir) {
+            write_path = write_dir.get() / io::path(paths.at(image_idx)).stem();
+        }
+        auto image_stats = benchmarkImage(encoded_images.at(image_idx), *preprocessor,
+                                          formats, write_path);
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        total_megapixels += image_stats.at("decode").megapixels;
+        for(const auto & pair : image_stats) {
+            stats[pair.first].merge(pair.second);
+        }
+    });
+    double wall_time = std::chrono::duration<double>(Clock::now() - start).count();
+    printStats(stats, wall_time, total_megapixels);
+
+    if (vm.count("json")) {
+        json j;
+        j["threads"] = nb_threads;
+        j["images"] = encoded_images.size();
+        j["repeat"] = repeat;
+        j["wall_time_s"] = wall_time;
+        j["mp_per_s"] = total_megapixels / wall_time;
+        j["stages"] = json::object();
+        for(const auto & pair : stats) {
+            j["stages"][pair.first] = pair.second.to_json();
+        }
+        std::ofstream os(vm.at("json").as<std::string>());
+        os << j.dump(2);
+    }
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include <json.hpp>
+
+#include "ManuallyTagger.h"
+#include "TagGrid.h"
+#include "utils.h"
+
+using namespace deeplocalizer;
+namespace po = boost::program_options;
+namespace io = boost::filesystem;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// Scaling benchmark of the tagger on synthetic datasets: construction and
+// init() of a ManuallyTagger, saving and loading its progress, saving all
+// descriptions, ImageDesc::fromPaths and the hit-testing of the image view.
+// Every operation runs for every combination of --images and --tags, so a
+// regression from linear to superlinear shows up as a jump between the rows.
+// The images are empty files, no pixels are decoded.
+
+po::options_description desc_option("Options");
+
+void setupOptions() {
+    desc_option.add_options()
+            ("help,h", "Print help messages")
+            ("images,n",  po::value<std::string>()->default_value("1000,10000,100000"),
+                 "Comma separated list of dataset sizes")
+            ("tags,t",    po::value<std::string>()->default_value("100,1000"),
+                 "Comma separated list of tags per image")
+            ("max-tags",  po::value<size_t>()->default_value(20000000),
+                 "Skip combinations with more tags in total, they would not fit into memory")
+            ("repeat,r",  po::value<size_t>()->default_value(3),
+                 "How often every operation runs. The median is reported.")
+            ("hits",      po::value<size_t>()->default_value(100000),
+                 "Number of hit-tests per image")
+            ("dir",       po::value<std::string>(),
+                 "Create the synthetic images in this directory. Default is a temporary one.")
+            ("json",      po::value<std::string>(), "Write the results as JSON to this file");
+}
+
+std::vector<size_t> parseList(const std::string & str) {
+    std::vector<size_t> values;
+    std::stringstream ss(str);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(std::stoul(item));
+        }
+    }
+    return values;
+}
+
+// Median of `repeat` runs in seconds. `setup` runs before every run and is
+// not timed.
+template<typename Setup, typename Fn>
+double measure(size_t repeat, Setup setup, Fn fn) {
+    std::vector<double> seconds;
+    for(size_t i = 0; i < std::max<size_t>(repeat, 1); i++) {
+        setup();
+        auto start = Clock::now();
+        fn();
+        seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    return seconds.at(seconds.size() / 2);
+}
+
+template<typename Fn>
+double measure(size_t repeat, Fn fn) {
+    return measure(repeat, []() {}, fn);
+}
+
+std::vector<Tag> randomTags(size_t n, std::mt19937 & gen) {
+    std::uniform_int_distribution<int> coordinate(0, 3000);
+    std::vector<Tag> tags;
+    tags.reserve(n);
+    for(size_t i = 0; i < n; i++) {
+        tags.emplace_back(cv::Rect(coordinate(gen), coordinate(gen), TAG_WIDTH, TAG_HEIGHT));
+    }
+    return tags;
+}
+
+// Creates the image files that do not exist yet, so larger datasets reuse
+// the files of the smaller ones.
+std::vector<std::string> createImages(const io::path & dir, size_t n) {
+    std::vector<std::string> paths;
+    paths.reserve(n);
+    for(size_t i = 0; i < n; i++) {
+        io::path image = dir / ("image_" + std::to_string(i) + ".jpeg");
+        if (!io::exists(image)) {
+            std::ofstream(image.string()) << "";
+        }
+        paths.push_back(image.string());
+    }
+    return paths;
+}
+
+std::vector<ImageDescPtr> makeDescs(const std::vector<std::string> & paths,
+                                    const std::vector<Tag> & tags) {
+    std::vector<ImageDescPtr> descs;
+    descs.reserve(paths.size());
+    for(const auto & path : paths) {
+        descs.push_back(std::make_shared<ImageDesc>(path, tags));
+    }
+    return descs;
+}
+
+void removeSavedDescs(const std::vector<std::string> & paths) {
+    for(const auto & path : paths) {
+        io::remove(path + "." + ManuallyTagger::IMAGE_DESC_EXT);
+    }
+}
+
+struct Row {
+    size_t images;
+    size_t tags;
+    std::string operation;
+    double seconds;
+    // the time divided by the number of images, or hit-tests
+    double us_per_item;
+};
+
+int main(int argc, char* argv[])
+{
+    setupOptions();
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(desc_option).run(), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        std::cout << "Usage: BenchTagger [options]" << std::endl;
+        std::cout << desc_option << std::endl;
+        return 0;
+    }
+    const auto image_counts = parseList(vm.at("images").as<std::string>());
+    const auto tag_counts = parseList(vm.at("tags").as<std::string>());
+    const size_t max_tags = vm.at("max-tags").as<size_t>();
+    const size_t repeat = vm.at("repeat").as<size_t>();
+    const size_t nb_hits = vm.at("hits").as<size_t>();
+    const bool own_dir = vm.count("dir") == 0;
+    const io::path dir = own_dir ?
+            io::unique_path(io::temp_directory_path() / "bench_tagger_%%%%%%%%") :
+            io::path(vm.at("dir").as<std::string>());
+    io::create_directories(dir);
+
+    std::mt19937 gen(0);
+    std::vector<Row> rows;
+    auto report = [&](size_t images, size_t tags, const std::string & operation,
+                      double seconds, size_t items) {
+        rows.push_back(Row{images, tags, operation, seconds, seconds * 1e6 / std::max<size_t>(items, 1)});
+        std::cout << std::left << std::setw(10) << images << std::setw(8) << tags
+                  << std::setw(20) << operation << std::right << std::fixed
+                  << std::setprecision(4) << std::setw(12) << seconds
+                  << std::setprecision(3) << std::setw(12) << rows.back().us_per_item << std::endl;
+    };
+    std::cout << std::left << std::setw(10) << "images" << std::setw(8) << "tags"
+              << std::setw(20) << "operation" << std::right << std::setw(12) << "seconds"
+              << std::setw(12) << "us/item" << std::endl;
+
+    for(size_t nb_tags : tag_counts) {
+        const std::vector<Tag> tags = randomTags(nb_tags, gen);
+        // what WholeImageWidget does on setTags and on every click
+        TagGrid grid;
+        report(1, nb_tags, "hit_index", measure(repeat, [&]() { grid.clear(); }, [&]() {
+            grid.insert(tags);
+        }), 1);
+        std::uniform_int_distribution<int> coordinate(0, 3000 + TAG_WIDTH);
+        std::vector<std::pair<int, int>> points(nb_hits);
+        for(auto & point : points) {
+            point = std::make_pair(coordinate(gen), coordinate(gen));
+        }
+        size_t nb_found = 0;
+        report(1, nb_tags, "hit_test", measure(repeat, [&]() {
+            for(const auto & point : points) {
+                nb_found += grid.find(point.first, point.second) != nullptr;
+            }
+        }), nb_hits);
+
+        for(size_t nb_images : image_counts) {
+            if (nb_images * nb_tags > max_tags) {
+                std::cout << "skip " << nb_images << " images with " << nb_tags
+                          << " tags, more than --max-tags" << std::endl;
+                continue;
+            }
+            const auto paths = createImages(dir, nb_images);
+            const std::string save_path = (dir / ManuallyTagger::DEFAULT_SAVE_PATH).string();
+            removeSavedDescs(paths);
+            std::unique_ptr<ManuallyTagger> tagger;
+            std::vector<ImageDescPtr> descs;
+            report(nb_images, nb_tags, "construct", measure(repeat, [&]() {
+                tagger.reset();
+                descs = makeDescs(paths, tags);
+            }, [&]() {
+                tagger = std::make_unique<ManuallyTagger>(std::move(descs), save_path);
+            }), nb_images);
+            report(nb_images, nb_tags, "init", measure(repeat, [&]() {
+                tagger->init();
+            }), nb_images);
+            for(const std::string ext : {".json", ".bin"}) {
+                const std::string progress = (dir / ("progress" + ext)).string();
+                report(nb_images, nb_tags, "save_progress" + ext, measure(repeat, [&]() {
+                    tagger->save(progress);
+                }), nb_images);
+                report(nb_images, nb_tags, "load_progress" + ext, measure(repeat, [&]() {
+                    ManuallyTagger::load(progress);
+                }), nb_images);
+                io::remove(progress);
+                io::remove(progress + ".journal");
+            }
+            report(nb_images, nb_tags, "save_all", measure(repeat, [&]() {
+                tagger->save(true);
+                tagger->flush();
+            }), nb_images);
+            tagger.reset();
+            report(nb_images, nb_tags, "from_paths", measure(repeat, [&]() {
+                ImageDesc::fromPaths(paths, ManuallyTagger::IMAGE_DESC_EXT);
+            }), nb_images);
+            // all descriptions are saved now, so init() loads every one
+            report(nb_images, nb_tags, "construct_saved", measure(repeat, [&]() {
+                tagger.reset();
+                descs.clear();
+                for(const auto & path : paths) {
+                    descs.push_back(std::make_shared<ImageDesc>(path));
+                }
+            }, [&]() {
+                tagger = std::make_unique<ManuallyTagger>(std::move(descs), save_path);
+            }), nb_images);
+            tagger.reset();
+            removeSavedDescs(paths);
+            io::remove(save_path);
+            io::remove(save_path + ".journal");
+        }
+    }
+    if (own_dir) {
+        io::remove_all(dir);
+    }
+
+    if (vm.count("json")) {
+        json j;
+        j["repeat"] = repeat;
+        j["hits"] = nb_hits;
+        j["results"] = json::array();
+        for(const auto & row : rows) {
+            json r;
+            r["images"] = row.images;
+            r["tags"] = row.tags;
+            r["operation"] = row.operation;
+            r["seconds"] = row.seconds;
+            r["us_per_item"] = row.us_per_item;
+            j["results"].push_back(r);
+        }
+        std::ofstream os(vm.at("json").as<std::string>());
+        os << j.dump(2);
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "DatasetGenerator.h"
+#include "DatasetWriter.h"
+
+#ifdef DEEPLOCALIZER_USE_LMDB
+#include <lmdb.h>
+#endif
+
+#ifdef DEEPLOCALIZER_USE_HDF5
+#include <hdf5.h>
+#endif
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+namespace io = boost::filesystem;
+
+std::vector<TrainDatum> someSamples(size_t n) {
+    std::vector<TrainDatum> batch;
+    for(size_t i = 0; i < n; i++) {
+        batch.push_back(TrainDatum{cv::Mat(TAG_SIZE, CV_8U, cv::Scalar(i)), static_cast<int>(i % 2)});
+    }
+    return batch;
+}
+
+size_t countLines(const io::path & path) {
+    std::ifstream is(path.string());
+    std::string line;
+    size_t n = 0;
+    while(std::getline(is, line)) {
+        n++;
+    }
+    return n;
+}
+
+std::vector<std::string> readLines(const io::path & path) {
+    std::ifstream is(path.string());
+    std::vector<std::string> lines;
+    std::string line;
+    while(std::getline(is, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+#ifdef DEEPLOCALIZER_USE_LMDB
+// all values of the database, in the order of their keys
+std::vector<std::string> readLMDB(const std::string & path) {
+    MDB_env * env;
+    REQUIRE(mdb_env_create(&env) == MDB_SUCCESS);
+    REQUIRE(mdb_env_open(env, path.c_str(), MDB_RDONLY, 0664) == MDB_SUCCESS);
+    MDB_txn * txn;
+    REQUIRE(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn) == MDB_SUCCESS);
+    MDB_dbi dbi;
+    REQUIRE(mdb_dbi_open(txn, nullptr, 0, &dbi) == MDB_SUCCESS);
+    MDB_cursor * cursor;
+    REQUIRE(mdb_cursor_open(txn, dbi, &cursor) == MDB_SUCCESS);
+    std::vector<std::string> values;
+    MDB_val key, value;
+    while(mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == MDB_SUCCESS) {
+        values.emplace_back(static_cast<const char *>(value.mv_data), value.mv_size);
+    }
+    mdb_cursor_close(cursor);
+    mdb_txn_abort(txn);
+    mdb_env_close(env);
+    return values;
+}
+#endif
+
+#ifdef DEEPLOCALIZER_USE_HDF5
+// the values and the shape of a float dataset
+std::vector<float> readHDF5(const std::string & path, const char * name,
+                            std::vector<hsize_t> & shape) {
+    hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    REQUIRE(file >= 0);
+    hid_t dataset = H5Dopen2(file, name, H5P_DEFAULT);
+    REQUIRE(dataset >= 0);
+    hid_t space = H5Dget_space(dataset);
+    shape.resize(H5Sget_simple_extent_ndims(space));
+    H5Sget_simple_extent_dims(space, shape.data(), nullptr);
+    size_t n = 1;
+    for(hsize_t dim : shape) {
+        n *= dim;
+    }
+    std::vector<float> values(n);
+    REQUIRE(H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) >= 0);
+    H5Sclose(space);
+    H5Dclose(dataset);
+    H5Fclose(file);
+    return values;
+}
+#endif
+
+TEST_CASE( "DatasetWriter", "[DatasetWriter]" ) {
+    io::path output_dir = io::unique_path("/tmp/dataset_%%%%%%%%");
+    SECTION("images writer lists every sample") {
+        {
+            auto writer = DatasetWriter::create(DatasetFormat::Images, output_dir);
+            writer->write(someSamples(5), Phase::Train);
+            writer->write(someSamples(3), Phase::Train);
+            writer->write(someSamples(2), Phase::Test);
+        }
+        REQUIRE(countLines(output_dir / "train.txt") == 8);
+        REQUIRE(countLines(output_dir / "test.txt") == 2);
+        std::ifstream is((output_dir / "test.txt").string());
+        std::string path;
+        int label;
+        is >> path >> label;
+        REQUIRE(io::exists(path));
+        REQUIRE(label == 0);
+    }
+#ifdef DEEPLOCALIZER_USE_LMDB
+    SECTION("datum encoding") {
+        cv::Mat patch(2, 3, CV_8U, cv::Scalar(7));
+        std::string datum = LMDBDatasetWriter::encodeDatum(patch, 1);
+        const std::string expected{0x08, 1, 0x10, 2, 0x18, 3, 0x22, 6, 7, 7, 7, 7, 7, 7, 0x28, 1};
+        REQUIRE(datum == expected);
+    }
+    SECTION("lmdb writer round trip") {
+        {
+            auto writer = DatasetWriter::create(DatasetFormat::LMDB, output_dir);
+            writer->write(someSamples(5), Phase::Train);
+            writer->write(someSamples(2), Phase::Test);
+        }
+        const auto train = readLines(output_dir / "train.txt");
+        REQUIRE(train.size() == 1);
+        REQUIRE(readLines(output_dir / "test.txt").size() == 1);
+        const auto values = readLMDB(train.at(0));
+        const auto samples = someSamples(5);
+        REQUIRE(values.size() == samples.size());
+        for(size_t i = 0; i < samples.size(); i++) {
+            REQUIRE(values.at(i) == LMDBDatasetWriter::encodeDatum(samples.at(i).patch,
+                                                                    samples.at(i).label));
+        }
+    }
+    SECTION("lmdb writer starts a new database at the size limit") {
+        const size_t batch_bytes = 2*(10 + LMDBDatasetWriter::encodeDatum(
+                someSamples(1).at(0).patch, 0).size());
+        DatasetWriterOptions opt;
+        // two batches fit into one database, the third one does not
+        opt.max_file_bytes = 2*batch_bytes;
+        {
+            auto writer = DatasetWriter::create(DatasetFormat::LMDB, output_dir, opt);
+            for(int i = 0; i < 3; i++) {
+                writer->write(someSamples(2), Phase::Train);
+            }
+        }
+        const auto train = readLines(output_dir / "train.txt");
+        REQUIRE(train.size() == 2);
+        REQUIRE(readLMDB(train.at(0)).size() == 4);
+        REQUIRE(readLMDB(train.at(1)).size() == 2);
+    }
+#endif
+#ifdef DEEPLOCALIZER_USE_HDF5
+    SECTION("hdf5 writer round trip") {
+        DatasetWriterOptions opt;
+        opt.chunk_size = 2;
+        {
+            auto writer = DatasetWriter::create(DatasetFormat::HDF5, output_dir, opt);
+            writer->write(someSamples(3), Phase::Train);
+            writer->write(someSamples(2), Phase::Train);
+        }
+        const auto train = readLines(output_dir / "train.txt");
+        REQUIRE(train.size() == 1);
+        std::vector<hsize_t> shape;
+        const auto data = readHDF5(train.at(0), "data", shape);
+        REQUIRE(shape == std::vector<hsize_t>({5, 1, hsize_t(TAG_SIZE.height), hsize_t(TAG_SIZE.width)}));
+        const auto labels = readHDF5(train.at(0), "label", shape);
+        REQUIRE(shape == std::vector<hsize_t>({5, 1}));
+        const size_t patch_size = TAG_SIZE.area();
+        const std::vector<size_t> values{0, 1, 2, 0, 1};
+        for(size_t i = 0; i < values.size(); i++) {
+            REQUIRE(labels.at(i) == static_cast<float>(values.at(i) % 2));
+            const float expected = static_cast<float>(values.at(i) * NET_INPUT_SCALE);
+            REQUIRE(data.at(i*patch_size) == expected);
+            REQUIRE(data.at((i + 1)*patch_size - 1) == expected);
+        }
+    }
+    SECTION("hdf5 writer starts a new file at the size limit") {
+        const size_t batch_bytes = 2*(TAG_SIZE.area() + 1)*sizeof(float);
+        DatasetWriterOptions opt;
+        // two batches fit into one file, the third one does not
+        opt.max_file_bytes = 2*batch_bytes;
+        {
+            auto writer = DatasetWriter::create(DatasetFormat::HDF5, output_dir, opt);
+            for(int i = 0; i < 3; i++) {
+                writer->write(someSamples(2), Phase::Train);
+            }
+        }
+        const auto train = readLines(output_dir / "train.txt");
+        REQUIRE(train.size() == 2);
+        std::vector<hsize_t> shape;
+        readHDF5(train.at(0), "label", shape);
+        REQUIRE(shape.at(0) == 4);
+        readHDF5(train.at(1), "label", shape);
+        REQUIRE(shape.at(0) == 2);
+    }
+#endif
+    io::remove_all(output_dir);
+}
+
+TEST_CASE( "DatasetGenerator", "[DatasetWriter]" ) {
+    cv::Mat image(512, 512, CV_8U, cv::Scalar(0));
+    ImageDesc desc("image.jpeg");
+    Tag tag(cv::Rect(100, 100, TAG_WIDTH, TAG_HEIGHT));
+    Tag no_tag(cv::Rect(200, 100, TAG_WIDTH, TAG_HEIGHT));
+    no_tag.setType(TagType::NoTag);
+    Tag exclude(cv::Rect(300, 100, TAG_WIDTH, TAG_HEIGHT));
+    exclude.setType(TagType::Exclude);
+    desc.addTag(tag);
+    desc.addTag(no_tag);
+    desc.addTag(exclude);
+
+    DatasetGenerator generator;
+    auto samples = generator.samples(image, desc);
+    REQUIRE(samples.size() == 2);
+    REQUIRE(samples.at(0).label == 1);
+    REQUIRE(samples.at(1).label == 0);
+    REQUIRE(samples.at(0).patch.size() == TAG_SIZE);
+    // copies, which do not keep the image alive
+    REQUIRE(samples.at(0).patch.datastart != image.datastart);
+    REQUIRE(cv::countNonZero(samples.at(0).patch != image(tag.getBoundingBox())) == 0);
+    REQUIRE(generator.phase("a.jpeg") == generator.phase("a.jpeg"));
+    REQUIRE(DatasetGenerator(0).phase("a.jpeg") == Phase::Train);
+    REQUIRE(DatasetGenerator(1).phase("a.jpeg") == Phase::Test);
+}
+
+TEST_CASE( "Augmenter", "[DatasetWriter]" ) {
+    cv::Mat image(600, 800, CV_8U);
+    cv::randu(image, 0, 256);
+    ImageDesc desc("image.jpeg");
+    desc.addTag(Tag(cv::Rect(100, 100, TAG_WIDTH, TAG_HEIGHT)));
+    desc.addTag(Tag(cv::Rect(400, 300, TAG_WIDTH, TAG_HEIGHT)));
+    AugmentationOptions opt;
+    opt.sample_rate = 16;
+    opt.seed = 42;
+    Augmenter augmenter(opt);
+
+    auto samples = augmenter.samples(image, desc);
+    size_t nb_positives = std::count_if(samples.begin(), samples.end(),
+                                        [](const TrainDatum & d) { return d.label == 1; });
+    REQUIRE(nb_positives == 2*opt.sample_rate);
+    REQUIRE(samples.size() == 2*nb_positives);
+    for(const auto & datum : samples) {
+        REQUIRE(datum.patch.size() == TAG_SIZE);
+    }
+    SECTION("is deterministic") {
+        auto again = augmenter.samples(image, desc);
+        REQUIRE(again.size() == samples.size());
+        for(size_t i = 0; i < samples.size(); i++) {
+            REQUIRE(cv::countNonZero(again[i].patch != samples[i].patch) == 0);
+        }
+    }
+    SECTION("negatives around a tag lie in every direction, also without rotation") {
+        AugmentationOptions around = opt;
+        around.rotate = false;
+        around.ratio_around_to_uniform = 1;
+        ImageDesc one_tag("image.jpeg");
+        one_tag.addTag(Tag(cv::Rect(400, 300, TAG_WIDTH, TAG_HEIGHT)));
+        const cv::Point2d tag_center = one_tag.getTags().at(0).center();
+        const double half = PATCH_SIZE_DEFAULT / 2;
+        size_t nb_above = 0, nb_below = 0;
+        for(const auto & sample : Augmenter(around).plan(image.size(), one_tag)) {
+            if (sample.label != 0) {
+                continue;
+            }
+            const cv::Vec3d patch_center(half, half, 1);
+            const double dy = (sample.patch_to_image * patch_center)[1] - tag_center.y;
+            nb_above += dy < -MIN_AROUND_WRONG / 2;
+            nb_below += dy > MIN_AROUND_WRONG / 2;
+        }
+        REQUIRE(nb_above > 0);
+        REQUIRE(nb_below > 0);
+    }
+    SECTION("identity transformation") {
+        Augmenter::Sample sample{cv::Matx23d(1, 0, 100, 0, 1, 100), 1};
+        auto data = Augmenter::apply(image, {sample});
+        cv::Mat expected = image(cv::Rect(100, 100, TAG_WIDTH, TAG_HEIGHT));
+        REQUIRE(cv::countNonZero(data.at(0).patch != expected) == 0);
+    }
+}
@@ -0,0 +1,53 @@
+#include "DescriptorStore.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+namespace io = boost::filesystem;
+
+TEST_CASE( "DescriptorStore", "[DescriptorStore]" ) {
+    std::vector<ImageDesc> descs{
+        ImageDesc("first_image.jpeg", {
+            Tag(tagBoxForCenter(cv::Point2i(100, 200))),
+            Tag(tagBoxForCenter(cv::Point2i(300, 400)))
+        }),
+        ImageDesc("image_without_tags.jpeg"),
+        ImageDesc("last_image.jpeg", {
+            Tag(tagBoxForCenter(cv::Point2i(50, 60)))
+        })
+    };
+    descs.at(0).getTags().at(1).setType(TagType::Exclude);
+    descs.at(2).getTags().at(0).setType(TagType::BeeWithoutTag);
+    auto store_path = io::unique_path("/tmp/%%%%%%%%%%%.store");
+
+    SECTION("write and map") {
+        DescriptorStore::write(store_path.string(), descs);
+        DescriptorStore store(store_path.string());
+        THEN("it contains all images and tags") {
+            REQUIRE(store.size() == descs.size());
+            REQUIRE(store.nbTags() == 3);
+            REQUIRE(store.filename(1).to_string() == "image_without_tags.jpeg");
+            REQUIRE(store.nbTags(1) == 0);
+            REQUIRE(store.tagsBegin(0)->x == 100);
+            REQUIRE(store.tagsBegin(0)->y == 200);
+        }
+        THEN("it converts back to the same image descriptions") {
+            for(size_t i = 0; i < descs.size(); i++) {
+                REQUIRE(store.imageDesc(i) == descs.at(i));
+                REQUIRE(store.imageDesc(i).to_json() == descs.at(i).to_json());
+            }
+        }
+        io::remove(store_path);
+    }
+    SECTION("invalid files") {
+        THEN("opening a file that is not a store throws") {
+            {
+                std::ofstream os(store_path.string());
+                os << std::string(128, 'x');
+            }
+            REQUIRE_THROWS(DescriptorStore(store_path.string()));
+            io::remove(store_path);
+        }
+    }
+}
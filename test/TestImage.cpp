@@ -1,6 +1,7 @@
 
 
 #include "Image.h"
+#include "LazyImageDescs.h"
 
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
@@ -45,3 +46,99 @@ TEST_CASE( "ImageDesc", "[ImageDesc]" ) {
         io::remove(uniquePath);
     }
 }
+
+TEST_CASE( "Loading image descriptions", "[ImageDesc]" ) {
+    std::vector<std::string> paths{
+            "testdata/with_5_tags.jpeg",
+            "testdata/with_one_tag.jpeg",
+            "testdata/Cam_2_20150828143300_888543_wb.jpeg"
+    };
+    SECTION("in parallel") {
+        THEN("the descriptions keep the order of the paths") {
+            auto descs = ImageDesc::fromPathsPtr(paths, "tagger.json");
+            REQUIRE(descs.size() == paths.size());
+            for(size_t i = 0; i < paths.size(); i++) {
+                REQUIRE(descs.at(i)->filename == paths.at(i));
+            }
+            REQUIRE(descs.at(2)->getTags().size() > 0);
+        }
+        THEN("not existing images throw an exception") {
+            REQUIRE_THROWS(ImageDesc::fromPathsPtr({"noexistend.png"}, "tagger.json"));
+        }
+    }
+    SECTION("lazy") {
+        THEN("it loads the same descriptions on access") {
+            LazyImageDescs lazy(paths, "tagger.json");
+            auto descs = ImageDesc::fromPathsPtr(paths, "tagger.json");
+            REQUIRE(lazy.size() == paths.size());
+            REQUIRE(*lazy.at(2) == *descs.at(2));
+            REQUIRE(lazy.at(2) == lazy.at(2));
+            auto all = lazy.loadAll();
+            for(size_t i = 0; i < paths.size(); i++) {
+                REQUIRE(*all.at(i) == *descs.at(i));
+            }
+        }
+    }
+}
+
+TEST_CASE( "Batched subimages", "[Tag]" ) {
+    cv::Mat image(400, 500, CV_8U);
+    cv::randu(image, 0, 256);
+    std::vector<Tag> tags{
+        Tag(cv::Rect(10, 20, TAG_WIDTH, TAG_HEIGHT)),
+        Tag(cv::Rect(-10, 380, TAG_WIDTH, TAG_HEIGHT)),
+        Tag(cv::Rect(300, 200, TAG_WIDTH, TAG_HEIGHT)),
+    };
+    SECTION("views match the copies") {
+        auto views = getSubimageViews(image, tags, 8);
+        REQUIRE(views.size() == tags.size());
+        for(size_t i = 0; i < tags.size(); i++) {
+            cv::Mat copy = tags[i].getSubimage(image, 8);
+            REQUIRE(views[i].data >= image.data);
+            REQUIRE(views[i].data < image.dataend);
+            REQUIRE(cv::countNonZero(views[i] != copy) == 0);
+        }
+    }
+    SECTION("pack into a NCHW blob") {
+        cv::Mat blob;
+        packSubimages(image, tags, blob, TAG_SIZE);
+        REQUIRE(blob.dims == 4);
+        REQUIRE(blob.size[0] == 3);
+        REQUIRE(blob.size[1] == 1);
+        REQUIRE(blob.isContinuous());
+        const uchar * data = blob.data;
+        for(size_t i = 0; i < tags.size(); i++) {
+            cv::Mat expected;
+            tags[i].getSubimage(image).convertTo(expected, CV_32F, NET_INPUT_SCALE);
+            cv::Mat plane(TAG_SIZE, CV_32F, blob.ptr<float>(static_cast<int>(i)));
+            REQUIRE(cv::norm(plane, expected, cv::NORM_INF) < 1e-6);
+        }
+        packSubimages(image, tags, blob, TAG_SIZE);
+        REQUIRE(blob.data == data);
+    }
+}
+
+TEST_CASE( "Decoding images", "[Image]" ) {
+    const std::string path = "testdata/with_one_tag.jpeg";
+    cv::Mat full = cv::imread(path, cv::IMREAD_GRAYSCALE);
+    auto buffer = Image::readFile(path);
+    REQUIRE(!buffer.empty());
+    SECTION("from a buffer") {
+        cv::Mat mat = Image::decode(buffer);
+        REQUIRE(mat.size() == full.size());
+        REQUIRE(mat.type() == CV_8U);
+    }
+    SECTION("at a reduced resolution") {
+        for(int reduction : {2, 4, 8}) {
+            DecodeOptions opt;
+            opt.reduction = reduction;
+            cv::Mat mat = Image::decode(buffer, opt);
+            REQUIRE(std::abs(mat.cols - full.cols / reduction) <= 1);
+            REQUIRE(std::abs(mat.rows - full.rows / reduction) <= 1);
+        }
+    }
+    SECTION("invalid data") {
+        std::vector<uchar> garbage(64, 7);
+        REQUIRE(Image::decode(garbage).empty());
+    }
+}
@@ -0,0 +1,50 @@
+#include "ImageTileCache.h"
+#include "Image.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+TEST_CASE( "ImageTileCache", "[ImageTileCache]" ) {
+    Image img(ImageDesc("testdata/with_5_tags.jpeg"));
+    const cv::Mat mat = img.getCvMat();
+    REQUIRE(!mat.empty());
+    ImageTileCache tiles;
+    tiles.setImage(mat);
+    const int T = ImageTileCache::TILE_SIZE;
+
+    SECTION("mipmap pyramid") {
+        THEN("every level is half the size of the previous one") {
+            REQUIRE(tiles.nbLevels() > 1);
+            for(size_t i = 1; i < tiles.nbLevels(); i++) {
+                REQUIRE(tiles.level(i).cols == (tiles.level(i - 1).cols + 1) / 2);
+                REQUIRE(tiles.level(i).rows == (tiles.level(i - 1).rows + 1) / 2);
+            }
+        }
+        THEN("the level used for a zoom factor is never smaller than the output") {
+            REQUIRE(tiles.levelForScale(2) == 0);
+            REQUIRE(tiles.levelForScale(1) == 0);
+            REQUIRE(tiles.levelForScale(0.8) == 0);
+            REQUIRE(tiles.levelForScale(0.5) == 1);
+            REQUIRE(tiles.levelForScale(0.3) == 1);
+        }
+    }
+    SECTION("rendering tiles") {
+        THEN("tiles at zoom factor 1 are copies of the image") {
+            cv::Mat tile = tiles.renderTile(1, 1, 0);
+            REQUIRE(tile.cols == std::min(T, mat.cols - T));
+            REQUIRE(cv::countNonZero(tile != mat(cv::Rect(T, 0, tile.cols, tile.rows))) == 0);
+        }
+        THEN("the border tiles are cropped to the zoomed image") {
+            const double scale = 1.5;
+            const QSize size = tiles.scaledSize(scale);
+            const int last_x = (size.width() - 1) / T;
+            const int last_y = (size.height() - 1) / T;
+            cv::Mat tile = tiles.renderTile(scale, last_x, last_y);
+            REQUIRE(tile.cols == size.width() - last_x*T);
+            REQUIRE(tile.rows == size.height() - last_y*T);
+            REQUIRE(tiles.renderTile(scale, last_x + 1, 0).empty());
+        }
+    }
+}
@@ -4,10 +4,14 @@
 #include <QCoreApplication>
 #include <boost/format.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <algorithm>
 #include <chrono>
+#include <fstream>
 
 #include "catch.hpp"
+#include "DescriptorStore.h"
 #include "ManuallyTagger.h"
+#include "ProgressJournal.h"
 
 using namespace deeplocalizer;
 namespace io = boost::filesystem;
@@ -122,6 +126,84 @@ TEST_CASE( "ManuallyTagger ", "[ManuallyTagger]" ) {
             }
         }
     }
+    SECTION("image cache") {
+        const std::string filename = "testdata/with_5_tags.jpeg";
+        GIVEN("an image that was prefetched") {
+            ImageCache cache;
+            cache.prefetch({filename});
+            THEN("get returns the decoded image without decoding it again") {
+                auto image = cache.get(filename);
+                REQUIRE(*image == Image(ImageDesc(filename)));
+                REQUIRE(cache.get(filename) == image);
+                REQUIRE(cache.size() == 1);
+            }
+        }
+        GIVEN("a prefetched image that cannot be read") {
+            ImageCache cache;
+            const std::string missing = "testdata/does_not_exist.jpeg";
+            cache.prefetch({missing});
+            THEN("get reports the error and the cache keeps working") {
+                REQUIRE_THROWS(cache.get(missing));
+                REQUIRE(cache.get(filename) != nullptr);
+            }
+        }
+        GIVEN("a memory limit smaller than the image") {
+            ImageCache cache(1);
+            THEN("only the most recently used image is kept") {
+                auto image = cache.get(filename);
+                REQUIRE(cache.size() == 1);
+                cache.setMaxBytes(0);
+                REQUIRE(cache.tryGet(filename) == image);
+                cache.clear();
+                REQUIRE(cache.tryGet(filename) == nullptr);
+                REQUIRE(cache.bytes() == 0);
+            }
+        }
+    }
+    SECTION("background writing") {
+        GIVEN("a background writer") {
+            THEN("waiting jobs with the same key are replaced") {
+                std::vector<int> written;
+                std::mutex block;
+                std::unique_lock<std::mutex> lock(block);
+                {
+                    BackgroundWriter writer;
+                    // keeps the writer busy until all jobs are scheduled
+                    writer.schedule("block", [&]() { std::lock_guard<std::mutex> l(block); });
+                    for(int i = 0; i < 10; i++) {
+                        writer.schedule("progress", [&written, i]() { written.push_back(i); });
+                    }
+                    writer.schedule("other", [&written]() { written.push_back(-1); });
+                    lock.unlock();
+                    writer.flush();
+                    REQUIRE(writer.pending() == 0);
+                }
+                REQUIRE(written == std::vector<int>({9, -1}));
+            }
+        }
+        GIVEN("a progress journal") {
+            auto path = io::unique_path("/tmp/%%%%%%%%%%%.journal").string();
+            for(uint64_t seq = 1; seq <= 5; seq++) {
+                journal::append(path, journal::Entry{seq, "image_" + std::to_string(seq), "image_0"});
+            }
+            {
+                std::ofstream os(path, std::ios::app);
+                os << "{\"seq\": 6, \"do";
+            }
+            THEN("it reads all complete entries") {
+                auto entries = journal::read(path);
+                REQUIRE(entries.size() == 5);
+                REQUIRE(entries.back().done == "image_5");
+            }
+            THEN("compacting drops the entries that are in the progress file") {
+                journal::compact(path, 3);
+                auto entries = journal::read(path);
+                REQUIRE(entries.size() == 2);
+                REQUIRE(entries.front().seq == 4);
+            }
+            io::remove(path);
+        }
+    }
     SECTION("serialization") {
         GIVEN("many image descriptions") {
             using namespace std::chrono;
@@ -141,6 +223,88 @@ TEST_CASE( "ManuallyTagger ", "[ManuallyTagger]" ) {
                     << "ns" << std::endl;
             }
         }
+        GIVEN("a session on a descriptor store") {
+            io::path dir = io::unique_path("/tmp/test_tagger_store_%%%%%%%%");
+            io::create_directories(dir);
+            std::vector<ImageDesc> descs;
+            for(int i = 0; i < 3; i++) {
+                const std::string filename = (dir / ("image_" + std::to_string(i) + ".jpeg")).string();
+                std::ofstream(filename) << "";
+                descs.emplace_back(filename, std::vector<Tag>{
+                        Tag(tagBoxForCenter(cv::Point2i(100 + i, 200))),
+                        Tag(tagBoxForCenter(cv::Point2i(300, 400 + i)))});
+            }
+            const std::string store_path = (dir / "images.store").string();
+            DescriptorStore::write(store_path, descs);
+            const std::string progress_path = (dir / "progress.bin").string();
+            {
+                std::vector<ImageDescPtr> store_descs;
+                DescriptorStore store(store_path);
+                for(size_t i = 0; i < store.size(); i++) {
+                    store_descs.push_back(std::make_shared<ImageDesc>(store.imageDesc(i)));
+                }
+                ManuallyTagger tagger(std::move(store_descs), progress_path);
+                tagger.setDescriptorStore(store_path);
+                tagger.save(progress_path);
+            }
+            THEN("a resumed session keeps the tags of the store") {
+                auto tagger = ManuallyTagger::load(progress_path);
+                REQUIRE(tagger->getImageDescs().size() == descs.size());
+                for(const auto & desc : tagger->getImageDescs()) {
+                    auto expected = std::find_if(descs.begin(), descs.end(), [&](const ImageDesc & d) {
+                        return d.filename == desc->filename;
+                    });
+                    REQUIRE(expected != descs.end());
+                    REQUIRE(desc->getTags().size() == 2);
+                    REQUIRE(desc->to_json() == expected->to_json());
+                }
+            }
+            io::remove_all(dir);
+        }
+        GIVEN("an image that another session tagged") {
+            io::path dir = io::unique_path("/tmp/test_tagger_refresh_%%%%%%%%");
+            io::create_directories(dir);
+            std::vector<ImageDesc> descs;
+            for(int i = 0; i < 2; i++) {
+                const std::string filename = (dir / ("image_" + std::to_string(i) + ".jpeg")).string();
+                std::ofstream(filename) << "";
+                descs.emplace_back(filename);
+            }
+            ManuallyTagger tagger(descs, (dir / "progress.json").string());
+            REQUIRE_FALSE(tagger.isDone(1));
+            std::ofstream(tagger.getImageDescs().at(1)->savePath()) << "";
+            THEN("it is only done after a refresh") {
+                REQUIRE_FALSE(tagger.isDone(1));
+                tagger.refreshDoneState();
+                REQUIRE(tagger.isDone(1));
+                REQUIRE_FALSE(tagger.isDone(0));
+            }
+            io::remove_all(dir);
+        }
+        GIVEN("a journal that marks a later image as done") {
+            io::path dir = io::unique_path("/tmp/test_tagger_journal_%%%%%%%%");
+            io::create_directories(dir);
+            std::vector<ImageDesc> descs;
+            for(int i = 0; i < 3; i++) {
+                const std::string filename = (dir / ("image_" + std::to_string(i) + ".jpeg")).string();
+                std::ofstream(filename) << "";
+                descs.emplace_back(filename);
+            }
+            const std::string progress_path = (dir / "progress.json").string();
+            {
+                ManuallyTagger tagger(descs, progress_path);
+                tagger.save();
+                // only journaled, the progress file is not written again
+                tagger.doneTagging(2);
+                tagger.flush();
+            }
+            THEN("the resumed session shows the same image, although the done image moved to the front") {
+                auto tagger = ManuallyTagger::load(progress_path);
+                REQUIRE(tagger->getImageDescs().at(0)->filename == descs.at(2).filename);
+                REQUIRE(tagger->getImageDescs().at(tagger->getIdx())->filename == descs.at(0).filename);
+            }
+            io::remove_all(dir);
+        }
     }
     io::remove("testdata/with_5_tags.jpeg.proposal.desc");
 }
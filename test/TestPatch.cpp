@@ -0,0 +1,76 @@
+#include <vector>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "Augmenter.h"
+#include "Patch.h"
+#include "Tag.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+TEST_CASE( "Patch kernels", "[Patch]" ) {
+    cv::Mat image(300, 400, CV_8U);
+    cv::randu(image, 0, 256);
+    // the specialized sizes and two that use the generic kernel
+    for(int size : {64, 100, 128, 30, 72}) {
+        INFO("patch size " << size);
+        const cv::Point top_left(17, 41);
+        const cv::Mat expected = image(cv::Rect(top_left, cv::Size(size, size)));
+        SECTION("copy " + std::to_string(size)) {
+            // a view into a larger buffer, like the patches of Augmenter::apply
+            cv::Mat buffer(3*size, size, CV_8U, cv::Scalar(0));
+            cv::Mat patch = buffer.rowRange(size, 2*size);
+            copyPatch(image, top_left, patch);
+            REQUIRE(cv::countNonZero(patch != expected) == 0);
+            REQUIRE(cv::countNonZero(buffer.rowRange(0, size)) == 0);
+            REQUIRE(cv::countNonZero(buffer.rowRange(2*size, 3*size)) == 0);
+        }
+        SECTION("pack " + std::to_string(size)) {
+            std::vector<float> packed(size*size);
+            packPatch(expected, packed.data(), 1.f/256);
+            cv::Mat converted;
+            expected.convertTo(converted, CV_32F, 1./256);
+            REQUIRE(cv::countNonZero(cv::Mat(size, size, CV_32F, packed.data()) != converted) == 0);
+        }
+    }
+    REQUIRE(isSpecializedPatchSize(100));
+    REQUIRE_FALSE(isSpecializedPatchSize(72));
+    REQUIRE_THROWS(checkPatchSize(0));
+    REQUIRE_THROWS(checkPatchSize(99));
+}
+
+TEST_CASE( "Patch sizes", "[Patch]" ) {
+    SECTION("boxes are centered on the tag") {
+        const cv::Point2i center(200, 300);
+        REQUIRE(tagBoxForCenter(center) == cv::Rect(200 - TAG_WIDTH/2, 300 - TAG_HEIGHT/2,
+                                                    TAG_WIDTH, TAG_HEIGHT));
+        REQUIRE(patchBoxForCenter(center, 100) == cv::Rect(150, 250, 100, 100));
+        Tag tag(tagBoxForCenter(center));
+        REQUIRE(Tag::from_json(tag.to_json()).getBoundingBox() == tag.getBoundingBox());
+    }
+    SECTION("augmented samples") {
+        cv::Mat image(600, 800, CV_8U);
+        cv::randu(image, 0, 256);
+        ImageDesc desc("image.jpeg");
+        desc.addTag(Tag(cv::Rect(200, 200, TAG_WIDTH, TAG_HEIGHT)));
+        AugmentationOptions opt;
+        opt.sample_rate = 8;
+        opt.patch_size = 100;
+        for(bool rotate : {true, false}) {
+            opt.rotate = rotate;
+            for(const auto & datum : Augmenter(opt).samples(image, desc)) {
+                REQUIRE(datum.patch.size() == cv::Size(100, 100));
+            }
+        }
+        // copied instead of warped, but the same pixels
+        Augmenter::Sample sample{cv::Matx23d(1, 0, 150, 0, 1, 180), 1};
+        auto data = Augmenter::apply(image, {sample}, 100);
+        cv::Mat warped;
+        cv::warpAffine(image, warped, cv::Mat(sample.patch_to_image), cv::Size(100, 100),
+                       cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REFLECT_101);
+        REQUIRE(cv::countNonZero(data.at(0).patch != warped) == 0);
+    }
+}
@@ -0,0 +1,153 @@
+#include "Preprocessor.h"
+#include "Image.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+PreprocessOptions testOptions(bool border, bool hist_eq, bool threshold) {
+    PreprocessOptions opt{};
+    opt.add_border = border;
+    opt.use_hist_eq = hist_eq;
+    opt.use_thresholding = threshold;
+    opt.use_binary_image = false;
+    opt.format = ImageFormat::JPEG;
+    opt.compression = DEFAULT_JPEG_COMPRESSION;
+    return opt;
+}
+
+bool equal(const cv::Mat & a, const cv::Mat & b) {
+    return a.size() == b.size() && a.type() == b.type() &&
+           cv::countNonZero(a != b) == 0;
+}
+
+TEST_CASE( "Preprocessor", "[Preprocessor]" ) {
+    Image img(ImageDesc("testdata/with_5_tags.jpeg"));
+    const cv::Mat mat = img.getCvMat();
+    REQUIRE(!mat.empty());
+
+    SECTION("makeBorder") {
+        THEN("it adds half a tag on every side") {
+            Preprocessor preprocessor(testOptions(true, false, false));
+            cv::Mat out;
+            preprocessor.process(mat, out);
+            REQUIRE(out.rows == mat.rows + TAG_HEIGHT);
+            REQUIRE(out.cols == mat.cols + TAG_WIDTH);
+            cv::Rect inner(TAG_WIDTH / 2, TAG_HEIGHT / 2, mat.cols, mat.rows);
+            REQUIRE(equal(out(inner), mat));
+        }
+    }
+    SECTION("adaptive thresholding") {
+        THEN("the fused threshold and blend is bit-identical to OpenCV") {
+            Preprocessor preprocessor(testOptions(false, false, true));
+            // odd sizes, so rows end with pixels the vector kernel does not
+            // handle and the last strip is partial, and a frame with fewer
+            // rows than the strip and the blur radius
+            for(const cv::Mat & input : {mat, cv::Mat(mat(cv::Rect(3, 5, 333, 211))),
+                                         cv::Mat(mat(cv::Rect(10, 20, 100, 7)))}) {
+                cv::Mat threshold, expected;
+                cv::adaptiveThreshold(input, threshold, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                                      cv::THRESH_BINARY, Preprocessor::THRESHOLD_BLOCK_SIZE, 0);
+                cv::addWeighted(input, 0.7, threshold, 0.3, 0, expected);
+                cv::Mat out;
+                preprocessor.adaptiveTresholding(input, out);
+                REQUIRE(equal(out, expected));
+            }
+        }
+    }
+    SECTION("all steps") {
+        GIVEN("a preprocessor with border, CLAHE and thresholding") {
+            Preprocessor preprocessor(testOptions(true, true, true));
+            THEN("it returns the same result as the separate OpenCV calls") {
+                cv::Mat expected;
+                cv::copyMakeBorder(mat, expected,
+                                   TAG_HEIGHT / 2, TAG_HEIGHT / 2,
+                                   TAG_WIDTH  / 2, TAG_WIDTH  / 2,
+                                   cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+                cv::createCLAHE(Preprocessor::CLAHE_CLIP_LIMIT,
+                                cv::Size(TAG_WIDTH / 2, TAG_HEIGHT / 2))->apply(expected, expected);
+                cv::Mat threshold;
+                cv::adaptiveThreshold(expected, threshold, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                                      cv::THRESH_BINARY, Preprocessor::THRESHOLD_BLOCK_SIZE, 0);
+                cv::addWeighted(expected, 0.7, threshold, 0.3, 0, expected);
+
+                cv::Mat out;
+                preprocessor.process(mat, out);
+                REQUIRE(equal(out, expected));
+            }
+            THEN("it reuses the output buffer for frames of the same size") {
+                cv::Mat out;
+                preprocessor.process(mat, out);
+                const uchar * data = out.data;
+                preprocessor.process(mat, out);
+                REQUIRE(out.data == data);
+            }
+            THEN("the in-place version reuses its buffer once the result is dropped") {
+                cv::Mat frame = mat.clone();
+                preprocessor.process(frame);
+                const cv::Mat kept = frame;
+                frame = mat.clone();
+                preprocessor.process(frame);
+                // the first result is still referenced
+                REQUIRE(frame.data != kept.data);
+                const uchar * data = frame.data;
+                frame = mat.clone();
+                preprocessor.process(frame);
+                REQUIRE(frame.data == data);
+            }
+        }
+    }
+}
+
+TEST_CASE( "Output variants", "[Preprocessor]" ) {
+    Image img(ImageDesc("testdata/with_5_tags.jpeg"));
+    const cv::Mat mat = img.getCvMat();
+    REQUIRE(!mat.empty());
+    OutputVariant base = testOptions(true, false, false).variant();
+
+    SECTION("parsing") {
+        auto variant = OutputVariant::parse("dir=out/png,clahe=1,format=png", base);
+        REQUIRE(variant.output_dir == "out/png");
+        REQUIRE(variant.use_hist_eq);
+        REQUIRE(variant.add_border);
+        REQUIRE(variant.format == ImageFormat::PNG);
+        REQUIRE(variant.compression == DEFAULT_PNG_COMPRESSION);
+        REQUIRE(OutputVariant::parse("compression=80", base).compression == 80);
+        REQUIRE_THROWS(OutputVariant::parse("colour=1", base));
+        REQUIRE_THROWS(OutputVariant::parse("clahe=maybe", base));
+    }
+    SECTION("the fingerprint of a single output does not change") {
+        PreprocessOptions opt = testOptions(true, true, false);
+        REQUIRE(opt.fingerprint() == opt.variant().fingerprint());
+        opt.extra_variants.push_back(base);
+        REQUIRE(opt.fingerprint() != opt.variant().fingerprint());
+    }
+    SECTION("variants share their common steps") {
+        std::vector<OutputVariant> variants{
+            base,
+            OutputVariant::parse("clahe=1", base),
+            OutputVariant::parse("clahe=1,threshold=1", base),
+            OutputVariant::parse("format=png", base),
+            OutputVariant::parse("border=0", base),
+        };
+        VariantPreprocessor preprocessor(variants);
+        // border, CLAHE and thresholding, the png variant reuses the border
+        REQUIRE(preprocessor.nbSteps() == 3);
+        std::vector<cv::Mat> outputs;
+        preprocessor.process(mat, outputs);
+        REQUIRE(outputs.size() == variants.size());
+        for(size_t v = 0; v < variants.size(); v++) {
+            Preprocessor single(variants[v]);
+            cv::Mat expected;
+            single.process(mat, expected);
+            REQUIRE(equal(outputs[v], expected));
+        }
+        REQUIRE(outputs[3].data == outputs[0].data);
+        REQUIRE(outputs[4].data == mat.data);
+        REQUIRE(preprocessor.sharesOutput(0));
+        REQUIRE(!preprocessor.sharesOutput(1));
+        REQUIRE(!preprocessor.sharesOutput(2));
+        REQUIRE(preprocessor.sharesOutput(4));
+    }
+}
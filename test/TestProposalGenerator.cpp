@@ -0,0 +1,80 @@
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "ProposalGenerator.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+namespace io = boost::filesystem;
+
+TEST_CASE( "Proposal generation", "[ProposalGenerator]" ) {
+    SECTION("parse the input shape of a deploy prototxt") {
+        io::path path = io::unique_path("/tmp/deploy_%%%%%%%%.prototxt");
+        {
+            std::ofstream os(path.string());
+            os << "name: \"Deeplocalizer\"\ninput: \"data\"\n"
+               << "input_dim: 256\ninput_dim: 1\ninput_dim: 100\ninput_dim: 100\n"
+               << "layer {\n  name: \"conv1\"\n  convolution_param {\n    num_output: 12\n  }\n}\n";
+        }
+        NetInputShape shape = parseInputShape(path.string());
+        io::remove(path);
+        REQUIRE(shape.batch_size == 256);
+        REQUIRE(shape.channels == 1);
+        REQUIRE(shape.height == 100);
+        REQUIRE(shape.width == 100);
+        REQUIRE(borderForInput(shape) == 18);
+    }
+    SECTION("candidate windows lie inside the image") {
+        auto windows = candidateWindows(cv::Size(256, 128), TAG_WIDTH / 2);
+        REQUIRE(windows.size() == 7 * 3);
+        for(const auto & w : windows) {
+            REQUIRE((w & cv::Rect(0, 0, 256, 128)) == w);
+        }
+    }
+    SECTION("non maximum suppression") {
+        std::vector<ScoredWindow> windows{
+            {tagBoxForCenter({100, 100}), 0.7f},
+            {tagBoxForCenter({108, 100}), 0.9f},
+            {tagBoxForCenter({300, 100}), 0.6f},
+            {tagBoxForCenter({500, 100}), 0.2f},
+        };
+        auto tags = nonMaximumSuppression(windows, 0.5f, TAG_WIDTH / 2);
+        REQUIRE(tags.size() == 2);
+        REQUIRE(tags.at(0).center() == cv::Point2i(108, 100));
+        REQUIRE(tags.at(1).center() == cv::Point2i(300, 100));
+    }
+}
+
+TEST_CASE( "Fully convolutional conversion", "[ProposalGenerator]" ) {
+    SECTION("InnerProduct layers become convolutions") {
+        const std::string deploy =
+            "input: \"data\"\n"
+            "layer {\n  name: \"conv1\"\n  type: \"Convolution\"\n"
+            "  convolution_param {\n    num_output: 12\n    kernel_size: 5\n  }\n}\n"
+            "layer {\n  name: \"fc3\"\n  type: \"InnerProduct\"\n"
+            "  inner_product_param {\n    num_output: 1024\n  }\n}\n"
+            "layer {\n  name: \"fc4\"\n  type: \"InnerProduct\"\n"
+            "  inner_product_param {\n    num_output: 2\n  }\n}\n";
+        std::string fcn = fullyConvolutionalPrototxt(deploy, {{"fc3", cv::Size(11, 11)},
+                                                              {"fc4", cv::Size(1, 1)}});
+        REQUIRE(fcn.find("InnerProduct") == std::string::npos);
+        REQUIRE(fcn.find("inner_product_param") == std::string::npos);
+        REQUIRE(fcn.find("kernel_h: 11\n    kernel_w: 11\n    num_output: 1024") != std::string::npos);
+        REQUIRE(fcn.find("kernel_h: 1\n    kernel_w: 1\n    num_output: 2") != std::string::npos);
+        REQUIRE(fcn.find("kernel_size: 5") != std::string::npos);
+    }
+    SECTION("peaks of the heat map") {
+        cv::Mat heat_map(20, 30, CV_32F, cv::Scalar(0.1));
+        heat_map.at<float>(5, 5) = 0.9f;
+        heat_map.at<float>(5, 6) = 0.8f;
+        heat_map.at<float>(15, 20) = 0.7f;
+        const int stride = 8;
+        auto tags = peaksToTags(heat_map, stride, TAG_CENTER, 0.5f, TAG_WIDTH / 2);
+        REQUIRE(tags.size() == 2);
+        REQUIRE(tags.at(0).center() == TAG_CENTER + cv::Point2i(5*stride, 5*stride));
+        REQUIRE(tags.at(1).center() == TAG_CENTER + cv::Point2i(20*stride, 15*stride));
+    }
+}
@@ -10,6 +10,8 @@
 #include "Image.h"
 #include "utils.h"
 #include "qt_helper.h"
+#include "ProgressFile.h"
+#include "DescriptorJson.h"
 
 namespace io = boost::filesystem;
 using boost::optional;
@@ -39,6 +41,89 @@ TEST_CASE( "JSON serialization", "[serialize]" ) {
     }
 }
 
+TEST_CASE( "Progress file", "[serialize]" ) {
+    Progress progress;
+    for(int i = 0; i < 130; i++) {
+        progress.image_paths.push_back("images/image_" + std::to_string(i) + ".jpeg");
+        progress.done_tagging.push_back(i % 3 == 0);
+    }
+    progress.image_idx = 42;
+    progress.journal_seq = 7;
+    auto requireEqual = [](const Progress & a, const Progress & b) {
+        REQUIRE(a.image_paths == b.image_paths);
+        REQUIRE(a.done_tagging == b.done_tagging);
+        REQUIRE(a.image_idx == b.image_idx);
+        REQUIRE(a.journal_seq == b.journal_seq);
+    };
+    SECTION("binary format") {
+        auto path = io::unique_path("/tmp/%%%%%%%%%%%.bin").string();
+        progress_file::write(path, progress);
+        REQUIRE(progress_file::isBinaryFile(path));
+        THEN("it can be read again") {
+            requireEqual(progress_file::read(path), progress);
+        }
+        THEN("it is much smaller than the json format") {
+            REQUIRE(io::file_size(path) < progress.to_json().dump().size());
+        }
+        io::remove(path);
+    }
+    SECTION("json format") {
+        auto path = io::unique_path("/tmp/%%%%%%%%%%%.json").string();
+        progress_file::write(path, progress);
+        REQUIRE_FALSE(progress_file::isBinaryFile(path));
+        requireEqual(progress_file::read(path), progress);
+        io::remove(path);
+    }
+    SECTION("shards") {
+        REQUIRE(progress_file::shardPath("dir/progress.bin", 1, 4) == "dir/progress.shard-1-of-4.bin");
+        REQUIRE(parseShard("1/4") == std::make_pair<size_t, size_t>(1, 4));
+        REQUIRE_THROWS(parseShard("4/4"));
+        std::vector<size_t> counts(4, 0);
+        for(const auto & path : progress.image_paths) {
+            counts.at(shardOf(path, 4))++;
+        }
+        for(size_t count : counts) {
+            REQUIRE(count > 0);
+        }
+    }
+}
+
+TEST_CASE( "Streaming descriptor json", "[serialize]" ) {
+    ImageDesc img("dir/image \"1\"\\.jpeg");
+    Tag tag(cv::Rect(30, 40, TAG_WIDTH, TAG_HEIGHT));
+    Tag no_tag(cv::Rect(300, 400, TAG_WIDTH, TAG_HEIGHT));
+    no_tag.setType(TagType::NoTag);
+    Tag bee(cv::Rect(100, 200, TAG_WIDTH, TAG_HEIGHT));
+    bee.setType(TagType::BeeWithoutTag);
+    Tag exclude(cv::Rect(10, 20, TAG_WIDTH, TAG_HEIGHT));
+    exclude.setType(TagType::Exclude);
+    img.addTag(tag);
+    img.addTag(no_tag);
+    img.addTag(bee);
+    img.addTag(exclude);
+    SECTION("same document as to_json") {
+        std::string text = descriptor_json::dump(img);
+        REQUIRE(json::parse(text) == img.to_json());
+        REQUIRE(text.find('\n') == std::string::npos);
+    }
+    SECTION("reads the pretty printed files of to_json") {
+        REQUIRE(descriptor_json::parse(img.to_json().dump(2)) == img);
+        REQUIRE(descriptor_json::parse(descriptor_json::dump(img)) == img);
+    }
+    SECTION("skips unknown keys") {
+        std::string text = "{\"version\": [1, {\"a\": null}], \"filename\": \"a.jpeg\", "
+                "\"tags\": [{\"tagtype\": \"istag\", \"score\": 0.5, \"x\": 62, \"y\": 72}]}";
+        ImageDesc desc = descriptor_json::parse(text);
+        REQUIRE(desc.filename == "a.jpeg");
+        REQUIRE(desc.getTags().size() == 1);
+        REQUIRE(desc.getTags().at(0) == tag);
+    }
+    SECTION("rejects broken files") {
+        REQUIRE_THROWS(descriptor_json::parse("{\"filename\": \"a.jpeg\", \"tags\": [{\"x\": 1}]}"));
+        REQUIRE_THROWS(descriptor_json::parse("{\"filename\": \"a.jpeg\""));
+    }
+}
+
 int main( int argc, char** const argv )
 {
     QCoreApplication * qapp = new QCoreApplication(argc, argv);
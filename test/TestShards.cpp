@@ -0,0 +1,110 @@
+#include "Shards.h"
+#include "PreprocessManifest.h"
+
+#include <algorithm>
+#include <fstream>
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+namespace io = boost::filesystem;
+
+std::vector<std::string> someImages(size_t n) {
+    std::vector<std::string> paths;
+    for(size_t i = 0; i < n; i++) {
+        paths.push_back("/archive/Cam_" + std::to_string(i % 4) + "_" + std::to_string(i) + ".jpeg");
+    }
+    return paths;
+}
+
+void writeLines(const std::string & path, const std::vector<std::string> & lines) {
+    std::ofstream os(path);
+    for(const auto & line : lines) {
+        os << line << '\n';
+    }
+}
+
+std::vector<std::string> readLines(const std::string & path) {
+    std::ifstream is(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while(std::getline(is, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+TEST_CASE( "Shards", "[Shards]" ) {
+    const auto paths = someImages(200);
+    const size_t N = 3;
+    SECTION("every image is in exactly one shard") {
+        size_t nb_selected = 0;
+        for(size_t i = 0; i < N; i++) {
+            auto shard = selectShard(paths, i, N);
+            REQUIRE(shard.size() > 0);
+            nb_selected += shard.size();
+        }
+        REQUIRE(nb_selected == paths.size());
+    }
+    SECTION("adding images does not move the others") {
+        auto more = someImages(300);
+        for(size_t i = 0; i < N; i++) {
+            auto shard = selectShard(paths, i, N);
+            auto shard_of_more = selectShard(more, i, N);
+            REQUIRE(std::equal(shard.begin(), shard.end(), shard_of_more.begin()));
+        }
+    }
+    SECTION("shard paths") {
+        REQUIRE(shardPath("out/images.txt", 1, 4) == "out/images.shard-1-of-4.txt");
+        REQUIRE(shardDir("out", 2, 4) == io::path("out") / "shard-2-of-4");
+    }
+    SECTION("merging") {
+        const io::path dir = io::unique_path("/tmp/shards_%%%%%%%%");
+        io::create_directories(dir);
+        const std::string merged = (dir / "images.txt").string();
+        for(size_t i = 0; i < N; i++) {
+            writeLines(shardPath(merged, i, N), selectShard(paths, i, N));
+        }
+        THEN("the lines of all shards are combined") {
+            REQUIRE(mergeShardFiles(merged, N) == paths.size());
+            auto lines = readLines(merged);
+            std::sort(lines.begin(), lines.end());
+            auto expected = paths;
+            std::sort(expected.begin(), expected.end());
+            REQUIRE(lines == expected);
+        }
+        THEN("the given order is restored") {
+            REQUIRE(mergeShardFiles(merged, N, paths) == paths.size());
+            REQUIRE(readLines(merged) == paths);
+        }
+        THEN("a missing shard is an error") {
+            io::remove(shardPath(merged, 1, N));
+            REQUIRE_THROWS(mergeShardFiles(merged, N));
+        }
+        io::remove_all(dir);
+    }
+}
+
+TEST_CASE( "Merging preprocess manifests", "[Shards]" ) {
+    const io::path dir = io::unique_path("/tmp/manifests_%%%%%%%%");
+    io::create_directories(dir);
+    const io::path input = dir / "input.jpeg";
+    const io::path output = dir / "output.jpeg";
+    writeLines(input.string(), {"not an image"});
+    writeLines(output.string(), {"not an image"});
+    const io::path path = dir / PreprocessManifest::DEFAULT_FILENAME;
+    {
+        PreprocessManifest shard(shardPath(path.string(), 0, 2));
+        shard.record(input.string(), "fingerprint", output.string());
+    }
+    PreprocessManifest manifest(path);
+    REQUIRE(!manifest.upToDate(input.string(), "fingerprint"));
+    manifest.merge(PreprocessManifest(shardPath(path.string(), 0, 2)));
+    REQUIRE(manifest.upToDate(input.string(), "fingerprint").get() == output.string());
+    REQUIRE(manifest.output(input.string()).get() == output.string());
+    manifest.compact();
+    REQUIRE(PreprocessManifest(path).size() == 1);
+    io::remove_all(dir);
+}
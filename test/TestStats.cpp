@@ -0,0 +1,66 @@
+#include "Stats.h"
+
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+namespace io = boost::filesystem;
+
+TEST_CASE( "Stats", "[Stats]" ) {
+    stats::reset();
+    SECTION("the samples of all threads are summed") {
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; t++) {
+            threads.emplace_back([]() {
+                for(int i = 0; i < 1000; i++) {
+                    stats::record(stats::Metric::Decode, 10, 2);
+                }
+            });
+        }
+        for(auto & thread : threads) {
+            thread.join();
+        }
+        stats::record(stats::Metric::Write, 5);
+        auto snapshot = stats::snapshot();
+        REQUIRE(snapshot[stats::Metric::Decode].count == 4000);
+        REQUIRE(snapshot[stats::Metric::Decode].nanoseconds == 40000);
+        REQUIRE(snapshot[stats::Metric::Decode].bytes == 8000);
+        REQUIRE(snapshot[stats::Metric::Write].count == 1);
+        REQUIRE(snapshot[stats::Metric::Filter].count == 0);
+    }
+    SECTION("scoped timers record one sample") {
+        {
+            stats::ScopedTimer timer(stats::Metric::Filter);
+            timer.setBytes(42);
+        }
+        auto snapshot = stats::snapshot();
+        REQUIRE(snapshot[stats::Metric::Filter].count == 1);
+        REQUIRE(snapshot[stats::Metric::Filter].bytes == 42);
+    }
+    SECTION("export") {
+        stats::record(stats::Metric::JsonLoad, 2000000, 100);
+        auto snapshot = stats::snapshot();
+        auto j = snapshot.to_json();
+        REQUIRE(j["metrics"]["json_load"]["count"] == 1);
+        REQUIRE(j["metrics"]["json_load"]["bytes"] == 100);
+        REQUIRE(j["metrics"].count("decode") == 0);
+        const std::string text = snapshot.to_prometheus();
+        REQUIRE(text.find("# TYPE deeplocalizer_stage_seconds_total counter") != std::string::npos);
+        REQUIRE(text.find("deeplocalizer_stage_calls_total{stage=\"json_load\"} 1\n") != std::string::npos);
+
+        io::path path = io::unique_path("/tmp/stats_%%%%%%%%.prom");
+        stats::writeFile(path.string());
+        std::ifstream is(path.string());
+        std::string written((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        REQUIRE(written.find("deeplocalizer_stage_bytes_total{stage=\"json_load\"} 100\n") != std::string::npos);
+        io::remove(path);
+    }
+}
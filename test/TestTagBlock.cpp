@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <random>
+
+#include "TagBlock.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+TEST_CASE( "TagBlock", "[TagBlock]" ) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> coordinate(0, 3000);
+    std::uniform_int_distribution<int> type(0, 3);
+    std::vector<Tag> first, second;
+    for(int i = 0; i < 300; i++) {
+        Tag tag(tagBoxForCenter(cv::Point2i(coordinate(gen), coordinate(gen))));
+        tag.setType(static_cast<TagType>(type(gen)));
+        (i < 100 ? first : second).push_back(tag);
+    }
+    TagBlock block;
+    block.appendImage(first);
+    block.appendImage(second);
+    REQUIRE(block.size() == 300);
+    REQUIRE(block.nbImages() == 2);
+    REQUIRE(block.imageBegin(1) == 100);
+    REQUIRE(block.imageEnd(1) == 300);
+
+    SECTION("views look like the tags") {
+        size_t i = 0;
+        for(auto ref : block) {
+            const Tag & tag = i < 100 ? first.at(i) : second.at(i - 100);
+            REQUIRE(ref.id() == tag.id());
+            REQUIRE(ref.center() == tag.center());
+            REQUIRE(ref.getBoundingBox() == tag.getBoundingBox());
+            REQUIRE(ref.toTag() == tag);
+            i++;
+        }
+    }
+    SECTION("count and select by type") {
+        auto counts = block.countByType();
+        size_t total = 0;
+        for(size_t t = 0; t < TagBlock::NB_TYPES; t++) {
+            auto selected = block.select(static_cast<TagType>(t));
+            REQUIRE(selected.size() == counts[t]);
+            for(uint32_t idx : selected) {
+                REQUIRE(block[idx].type() == static_cast<TagType>(t));
+            }
+            total += counts[t];
+        }
+        REQUIRE(total == block.size());
+    }
+    SECTION("select by rectangle and gather") {
+        cv::Rect rect(500, 500, 1000, 1000);
+        auto selected = block.select(rect);
+        TagBlock inside = block.gather(selected);
+        REQUIRE(inside.size() == selected.size());
+        REQUIRE(inside.nbImages() == 1);
+        for(auto ref : inside) {
+            REQUIRE(rect.contains(ref.center()));
+        }
+    }
+    SECTION("sample without replacement") {
+        auto tags = block.select(IsTag);
+        auto sampled = TagBlock::sample(tags, 10, gen);
+        REQUIRE(sampled.size() == std::min<size_t>(10, tags.size()));
+        std::sort(sampled.begin(), sampled.end());
+        REQUIRE(std::unique(sampled.begin(), sampled.end()) == sampled.end());
+    }
+}
@@ -0,0 +1,81 @@
+#include <random>
+
+#include "TagGrid.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+TEST_CASE( "TagGrid", "[TagGrid]" ) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> coordinate(-TAG_WIDTH, 3000);
+    std::vector<Tag> tags;
+    for(int i = 0; i < 300; i++) {
+        tags.emplace_back(cv::Rect(coordinate(gen), coordinate(gen), TAG_WIDTH, TAG_HEIGHT));
+    }
+    TagGrid grid;
+    grid.insert(tags);
+    REQUIRE(grid.size() == tags.size());
+
+    auto linearAt = [&](int x, int y) {
+        for(const auto & tag : tags) {
+            if (tag.getBoundingBox().contains(cv::Point(x, y))) {
+                return boost::optional<Tag>(tag);
+            }
+        }
+        return boost::optional<Tag>();
+    };
+
+    SECTION("hit-testing") {
+        THEN("it finds the same tag as a linear scan") {
+            for(int i = 0; i < 2000; i++) {
+                int x = coordinate(gen);
+                int y = coordinate(gen);
+                auto expected = linearAt(x, y);
+                auto found = grid.at(x, y);
+                const Tag * pointer = grid.find(x, y);
+                REQUIRE(bool(found) == bool(expected));
+                REQUIRE(bool(pointer) == bool(expected));
+                if (expected) {
+                    REQUIRE(found->id() == expected->id());
+                    REQUIRE(pointer->id() == expected->id());
+                }
+            }
+        }
+    }
+    SECTION("rectangle queries") {
+        THEN("it returns every tag that intersects the rectangle once") {
+            cv::Rect rect(500, 700, 800, 600);
+            size_t expected = std::count_if(tags.begin(), tags.end(), [&](const Tag & tag) {
+                return (tag.getBoundingBox() & rect).area() > 0;
+            });
+            auto found = grid.query(rect);
+            REQUIRE(found.size() == expected);
+            for(const Tag * tag : found) {
+                REQUIRE((tag->getBoundingBox() & rect).area() > 0);
+            }
+        }
+    }
+    SECTION("erasing and replacing tags") {
+        const Tag & tag = tags.at(0);
+        auto center = tag.center();
+        THEN("erased tags are not found anymore") {
+            REQUIRE(grid.erase(tag.id()));
+            REQUIRE_FALSE(grid.erase(tag.id()));
+            REQUIRE(grid.size() == tags.size() - 1);
+            auto found = grid.at(center.x, center.y);
+            REQUIRE((!found || found->id() != tag.id()));
+        }
+        THEN("inserting a tag with the same id replaces it") {
+            Tag moved = tag;
+            moved.setBoundingBox(cv::Rect(5000, 5000, TAG_WIDTH, TAG_HEIGHT));
+            moved.setType(TagType::Exclude);
+            grid.insert(moved);
+            REQUIRE(grid.size() == tags.size());
+            auto found = grid.at(5000 + TAG_WIDTH / 2, 5000 + TAG_HEIGHT / 2);
+            REQUIRE(found);
+            REQUIRE(found->isExclude());
+        }
+    }
+}
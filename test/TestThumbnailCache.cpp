@@ -0,0 +1,70 @@
+#include "ThumbnailCache.h"
+#include "Image.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+using namespace deeplocalizer;
+
+namespace io = boost::filesystem;
+
+TEST_CASE( "ThumbnailCache", "[ThumbnailCache]" ) {
+    const std::string filename = "testdata/with_5_tags.jpeg";
+    const io::path dir = io::unique_path("/tmp/thumbnails_%%%%%%%%");
+    {
+        ThumbnailCache cache(dir, 64);
+        SECTION("thumbnails fit into the maximal size") {
+            cv::Mat thumbnail = cache.get(filename);
+            REQUIRE(!thumbnail.empty());
+            REQUIRE(std::max(thumbnail.cols, thumbnail.rows) == 64);
+            REQUIRE(io::exists(cache.path(filename)));
+            THEN("they are loaded from the cache directory") {
+                ThumbnailCache other(dir, 64);
+                cv::Mat loaded = other.get(filename);
+                REQUIRE(loaded.size() == thumbnail.size());
+            }
+        }
+        SECTION("the thumbnail file depends only on the filename") {
+            ThumbnailCache other(dir, 64);
+            REQUIRE(cache.path(filename) == other.path(filename));
+            REQUIRE(cache.path(filename) != cache.path("testdata/with_one_tag.jpeg"));
+        }
+        SECTION("requests are served by the worker") {
+            std::mutex mutex;
+            std::condition_variable done;
+            std::vector<std::string> loaded;
+            cache.setCallback([&](const std::string & name, const cv::Mat & thumbnail) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!thumbnail.empty()) {
+                    loaded.push_back(name);
+                }
+                done.notify_all();
+            });
+            cache.request(filename);
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&]() { return !loaded.empty(); });
+            REQUIRE(loaded.at(0) == filename);
+        }
+        SECTION("generated thumbnails are only written to the directory") {
+            std::atomic<int> nb_called(0);
+            cache.setCallback([&](const std::string &, const cv::Mat &) { nb_called++; });
+            cache.generate({filename});
+            while(!io::exists(cache.path(filename))) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            cache.setCallback(nullptr);
+            REQUIRE(nb_called == 0);
+        }
+        SECTION("missing images have no thumbnail") {
+            REQUIRE(cache.get("testdata/does_not_exist.jpeg").empty());
+        }
+        cache.setCallback(nullptr);
+    }
+    io::remove_all(dir);
+}
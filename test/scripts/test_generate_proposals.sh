@@ -3,6 +3,17 @@
 set -e
 set -o xtrace
 
+# exit code that ctest reports as skipped, see CMakeLists.txt
+SKIP=77
+SOURCE_DIR=${1:-`pwd`/../../..}
+DEPLOY="${SOURCE_DIR}/models/conv12_conv48_fc1024_fc_2/deploy.prototxt"
+# the trained weights are not part of the repository
+WEIGHTS=${DEEPLOCALIZER_TEST_WEIGHTS:-$(find "${SOURCE_DIR}/models" -name '*.caffemodel' | head -n 1)}
+if [ -z "$WEIGHTS" ] || [ ! -e "$WEIGHTS" ] || [ ! -e "$DEPLOY" ]; then
+    echo "No trained weights found. Set DEEPLOCALIZER_TEST_WEIGHTS to a .caffemodel to run this test."
+    exit $SKIP
+fi
+
 TEST_PATHFILE="test_pathfile.txt"
 TEST_IMG=$(find `pwd`/../testdata -name with_one_tag.jpeg | xargs realpath)
 TEST_IMG_DESC="${TEST_IMG}.proposal.json"
@@ -14,7 +25,7 @@ cd ../../source/tagger
 echo `pwd`
 echo $TEST_IMG > $TEST_PATHFILE
 echo "Given a file of image path"
-./generate_proposals $TEST_PATHFILE
+./generate_proposals --deploy "$DEPLOY" --weights "$WEIGHTS" $TEST_PATHFILE
 echo "Then ./generate_proposals will generate .json files for every image"
 test -e ${TEST_IMG_DESC}
-rm -f $TEST_IMG_DESC
\ No newline at end of file
+rm -f $TEST_IMG_DESC